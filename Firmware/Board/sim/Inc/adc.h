@@ -0,0 +1,18 @@
+#ifndef __adc_H
+#define __adc_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern ADC_HandleTypeDef hadc1;
+extern ADC_HandleTypeDef hadc2;
+extern ADC_HandleTypeDef hadc3;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __adc_H
@@ -0,0 +1,27 @@
+/*
+* @brief Minimal stand-in for the CMSIS-DSP header.
+*
+* The firmware only uses the float type and the fast sine/cosine table
+* (see MotorControl/arm_sin_f32.c), so that's all there is.
+*/
+
+#ifndef _ARM_MATH_H
+#define _ARM_MATH_H
+
+#include <stdint.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef float float32_t;
+
+#define FAST_MATH_TABLE_SIZE 512
+#define PI 3.14159265358979f
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ARM_MATH_H
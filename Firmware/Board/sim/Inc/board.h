@@ -0,0 +1,118 @@
+/*
+* @brief Contains board specific configuration for the simulated ODrive
+*
+* The simulated board runs the unmodified firmware as a Linux process. It
+* mimics an ODrive v3.6-56V: two axes, the same timers, ADC channels and
+* current measurement timing. Instead of real gate drivers and motors, each
+* axis is connected to a simulated PMSM and inverter (see sim_plant.hpp).
+*/
+
+#ifndef __BOARD_CONFIG_H
+#define __BOARD_CONFIG_H
+
+#include <stdbool.h>
+
+// STM specific includes (these are host replacements, see Board/sim/Inc)
+#include <stm32f4xx_hal.h>
+#include <gpio.h>
+#include <spi.h>
+#include <tim.h>
+#include <can.h>
+#include <i2c.h>
+#include <usb_device.h>
+#include <main.h>
+#include "cmsis_os.h"
+
+#include <arm_math.h>
+
+#include <Drivers/STM32/stm32_system.h>
+
+#define SHUNT_RESISTANCE (500e-6f)
+
+#define AXIS_COUNT (2)
+
+// Total count of GPIOs, including encoder pins, CAN pins and a dummy GPIO0.
+#define GPIO_COUNT  (17)
+
+#define DEFAULT_BRAKE_RESISTANCE (2.0f) // [ohm]
+
+#define DEFAULT_GPIO_MODES \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_UART0, \
+    ODriveIntf::GPIO_MODE_UART0, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_ENC0, \
+    ODriveIntf::GPIO_MODE_ENC0, \
+    ODriveIntf::GPIO_MODE_DIGITAL_PULL_DOWN, \
+    ODriveIntf::GPIO_MODE_ENC1, \
+    ODriveIntf::GPIO_MODE_ENC1, \
+    ODriveIntf::GPIO_MODE_DIGITAL_PULL_DOWN, \
+    ODriveIntf::GPIO_MODE_CAN0, \
+    ODriveIntf::GPIO_MODE_CAN0,
+
+#define TIM_TIME_BASE TIM14
+
+// PWM and control timing. TIM_1_8_PERIOD_CLOCKS, TIM_1_8_DEADTIME_CLOCKS
+// and TIM_1_8_RCR are only the defaults, the values in use are set from the
+// config at boot (see apply_pwm_config()).
+extern uint32_t pwm_period_clocks; // half of the PWM period [timer clocks]
+extern uint32_t pwm_deadtime_clocks; // [timer clocks]
+extern uint32_t pwm_rcr; // repetition counter, the control loop runs every pwm_rcr + 1 PWM periods
+
+// Period in [s]
+extern float current_meas_period;
+
+// Frequency in [Hz]
+extern float current_meas_hz;
+
+#ifdef __cplusplus
+#include <Drivers/STM32/stm32_gpio.hpp>
+#include <Drivers/STM32/stm32_spi_arbiter.hpp>
+#include <MotorControl/pwm_input.hpp>
+#include <MotorControl/thermistor.hpp>
+#include <sim_gate_driver.hpp>
+
+using TGateDriver = SimGateDriver;
+using TOpAmp = SimGateDriver;
+
+#include <MotorControl/motor.hpp>
+#include <MotorControl/encoder.hpp>
+
+extern std::array<Axis, AXIS_COUNT> axes;
+extern Motor motors[AXIS_COUNT];
+extern OnboardThermistorCurrentLimiter fet_thermistors[AXIS_COUNT];
+extern Encoder encoders[AXIS_COUNT];
+extern Stm32Gpio gpios[GPIO_COUNT];
+
+struct GpioFunction { int mode = 0; uint8_t alternate_function = 0xff; };
+extern std::array<GpioFunction, 3> alternate_functions[GPIO_COUNT];
+
+extern PCD_HandleTypeDef& usb_pcd_handle;
+extern USBD_HandleTypeDef& usb_dev_handle;
+
+extern Stm32SpiArbiter& ext_spi_arbiter;
+
+extern UART_HandleTypeDef* uart0;
+extern UART_HandleTypeDef* uart1;
+extern UART_HandleTypeDef* uart2;
+
+extern PwmInput pwm0_input;
+#endif
+
+#define VBUS_S_DIVIDER_RATIO 19.0f
+
+// This board has no board-specific user configurations
+static inline bool board_read_config() { return true; }
+static inline bool board_write_config() { return true; }
+static inline void board_clear_config() { }
+static inline bool board_apply_config() { return true; }
+
+void system_init();
+bool board_init();
+
+#endif // __BOARD_CONFIG_H
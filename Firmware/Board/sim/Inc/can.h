@@ -0,0 +1,16 @@
+#ifndef __can_H
+#define __can_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern CAN_HandleTypeDef hcan1;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __can_H
@@ -0,0 +1,116 @@
+/*
+* @brief CMSIS-RTOS API for the simulated board.
+*
+* The firmware threads run as host threads but only one of them executes at
+* any given time, like on a single core. Time is virtual: it only advances when
+* the simulation engine has dispatched all interrupts of a PWM period and every
+* thread is blocked. This keeps the control loops in lockstep with the plant
+* no matter how fast the host is.
+*
+* Only the subset of CMSIS-RTOS (and FreeRTOS) that the firmware uses is provided.
+* The implementation lives in Board/sim/cmsis_os_sim.cpp.
+*/
+
+#ifndef __CMSIS_OS_H
+#define __CMSIS_OS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define configTICK_RATE_HZ ((uint32_t)1000)
+#define configTOTAL_HEAP_SIZE ((size_t)65536)
+
+#define osWaitForever 0xFFFFFFFF
+#define osKernelSysTickFrequency (configTICK_RATE_HZ)
+
+typedef size_t StackType_t;
+#define portCHAR char
+
+typedef enum {
+    osPriorityIdle = -3,
+    osPriorityLow = -2,
+    osPriorityBelowNormal = -1,
+    osPriorityNormal = 0,
+    osPriorityAboveNormal = +1,
+    osPriorityHigh = +2,
+    osPriorityRealtime = +3,
+    osPriorityError = 0x84
+} osPriority;
+
+typedef enum {
+    osOK = 0,
+    osEventSignal = 0x08,
+    osEventMessage = 0x10,
+    osEventTimeout = 0x40,
+    osErrorParameter = 0x80,
+    osErrorResource = 0x81,
+    osErrorTimeoutResource = 0xC1,
+    osErrorOS = 0xFF,
+} osStatus;
+
+typedef struct SimThread* osThreadId;
+typedef struct SimSemaphore* osSemaphoreId;
+typedef osThreadId xTaskHandle;
+typedef void (*os_pthread)(void* argument);
+
+typedef struct os_thread_def {
+    const char* name;
+    os_pthread pthread;
+    osPriority tpriority;
+    uint32_t instances;
+    uint32_t stacksize;
+} osThreadDef_t;
+
+typedef struct os_semaphore_def {
+    uint32_t dummy;
+} osSemaphoreDef_t;
+
+typedef struct {
+    osStatus status;
+    union {
+        uint32_t v;
+        void* p;
+        int32_t signals;
+    } value;
+} osEvent;
+
+#define osThreadDef(name, thread, priority, instances, stacksz) \
+const osThreadDef_t os_thread_def_##name = \
+{ #name, (thread), (priority), (instances), (uint32_t)(stacksz) }
+#define osThread(name) &os_thread_def_##name
+
+#define osSemaphoreDef(name) const osSemaphoreDef_t os_semaphore_def_##name = { 0 }
+#define osSemaphore(name) &os_semaphore_def_##name
+
+osStatus osKernelStart(void);
+uint32_t osKernelSysTick(void);
+
+osThreadId osThreadCreate(const osThreadDef_t* thread_def, void* argument);
+osThreadId osThreadGetId(void);
+osStatus osThreadSuspend(osThreadId thread_id);
+osStatus osThreadResume(osThreadId thread_id);
+osStatus osDelay(uint32_t millisec);
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals);
+osEvent osSignalWait(int32_t signals, uint32_t millisec);
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t* semaphore_def, int32_t count);
+osStatus osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec);
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id);
+
+uint32_t xTaskGetTickCount(void);
+void vTaskDelete(xTaskHandle xTaskToDelete);
+uint32_t uxTaskGetStackHighWaterMark(xTaskHandle xTask);
+size_t xPortGetMinimumEverFreeHeapSize(void);
+void* pvPortMalloc(size_t xSize);
+void vPortFree(void* pv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __CMSIS_OS_H
@@ -0,0 +1,16 @@
+#ifndef __gpio_H
+#define __gpio_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void MX_GPIO_Init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __gpio_H
@@ -0,0 +1,16 @@
+#ifndef __i2c_H
+#define __i2c_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern I2C_HandleTypeDef hi2c1;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __i2c_H
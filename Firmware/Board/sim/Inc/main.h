@@ -0,0 +1,46 @@
+/*
+* @brief Timer and pin definitions of the simulated board.
+*
+* These mirror Board/v3/Inc/main.h of ODrive v3.5/v3.6 so that all timing
+* derived values (control loop rate, dead time, brake resistor PWM) match the
+* real hardware.
+*/
+
+#ifndef __MAIN_H__
+#define __MAIN_H__
+
+#include "stm32f4xx_hal.h"
+
+#define TIM_1_8_CLOCK_HZ 168000000
+#define TIM_1_8_PERIOD_CLOCKS 3500
+#define TIM_1_8_DEADTIME_CLOCKS 20
+#define TIM_APB1_CLOCK_HZ 84000000
+#define TIM_APB1_PERIOD_CLOCKS 4096
+#define TIM_APB1_DEADTIME_CLOCKS 40
+#define TIM_1_8_RCR 2
+
+#define M0_ENC_A_Pin GPIO_PIN_4
+#define M0_ENC_A_GPIO_Port GPIOB
+#define M0_ENC_B_Pin GPIO_PIN_5
+#define M0_ENC_B_GPIO_Port GPIOB
+#define M0_ENC_Z_Pin GPIO_PIN_9
+#define M0_ENC_Z_GPIO_Port GPIOC
+#define M1_ENC_A_Pin GPIO_PIN_6
+#define M1_ENC_A_GPIO_Port GPIOB
+#define M1_ENC_B_Pin GPIO_PIN_7
+#define M1_ENC_B_GPIO_Port GPIOB
+#define M1_ENC_Z_Pin GPIO_PIN_15
+#define M1_ENC_Z_GPIO_Port GPIOC
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void _Error_Handler(const char* file, int line);
+#define Error_Handler() _Error_Handler(__FILE__, __LINE__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __MAIN_H__
@@ -0,0 +1,51 @@
+/*
+* @brief Interfaces between the parts of the simulated board.
+*/
+
+#ifndef __SIM_HPP
+#define __SIM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Implemented in cmsis_os_sim.cpp
+
+// @brief Returns the virtual time since startup in [ns]
+uint64_t sim_get_time_ns();
+
+// @brief Blocks the caller until every RTOS thread is blocked (i.e. the
+// simulated CPU would be idle).
+void sim_wait_until_idle();
+
+// @brief Moves the virtual time forward and wakes all threads whose timeout
+// expired. Must only be called while all RTOS threads are blocked.
+void sim_advance_time(uint64_t delta_ns);
+
+// Implemented in stm32_sim.cpp
+
+// Destination of the general purpose ADC DMA transfers
+extern uint16_t* sim_adc1_dma_buffer;
+extern size_t sim_adc1_dma_length;
+
+// @brief Sets the virtual time in [timer clocks] that the cycle counter
+// (DWT->CYCCNT) reports
+void sim_set_cycle_count(uint64_t clocks);
+
+// Implemented in sim_tcp.cpp
+
+// @brief Starts serving the native protocol on the specified TCP port
+void start_tcp_server(unsigned int port);
+
+// @brief Passes data received on the TCP socket on to the TCP server thread.
+// Called by the simulation engine while the RTOS threads are idle.
+void sim_tcp_poll();
+
+// Implemented in sim_engine.cpp
+
+// @brief Runs the simulation of the board. Called from osKernelStart(). Never returns.
+void sim_run();
+
+// @brief Reboots the simulated board by re-executing the current process.
+void sim_reset();
+
+#endif // __SIM_HPP
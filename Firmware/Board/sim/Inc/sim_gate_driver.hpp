@@ -0,0 +1,60 @@
+#ifndef __SIM_GATE_DRIVER_HPP
+#define __SIM_GATE_DRIVER_HPP
+
+#include <Drivers/gate_driver.hpp>
+
+#include <algorithm>
+#include <array>
+
+/**
+ * @brief Stand-in for the DRV8301 of the simulated board.
+ *
+ * Behaves like the DRV8301 as seen by the motor: the shunt amplifier gain snaps
+ * down to 10, 20, 40 or 80V/V and the output is centered at 1.65V. The
+ * simulation reads back the gain and the enable state to generate the ADC
+ * values and to decide whether the inverter is switching.
+ */
+class SimGateDriver : public GateDriverBase, public OpAmpBase {
+public:
+    bool init() {
+        initialized_ = true;
+        return true;
+    }
+
+    bool set_enabled(bool enabled) final {
+        enabled_ = enabled;
+        return true;
+    }
+
+    bool check_fault() final {
+        return !fault_;
+    }
+
+    bool set_gain(float requested_gain, float* actual_gain) final {
+        // Snap down to have equal or larger range as requested or largest possible range otherwise
+        static const std::array<float, 4> gain_choices = {10.0f, 20.0f, 40.0f, 80.0f};
+        auto gain_snap_down = std::lower_bound(gain_choices.crbegin(), gain_choices.crend(), requested_gain,
+                [](float gain, float val) { return gain > val; });
+        if (gain_snap_down == gain_choices.crend())
+            --gain_snap_down;
+        gain_ = *gain_snap_down;
+        if (actual_gain)
+            *actual_gain = gain_;
+        return true;
+    }
+
+    float get_midpoint() final {
+        return 0.5f; // [V]
+    }
+
+    float get_max_output_swing() final {
+        return 1.35f / 1.65f; // +-1.35V, normalized from a scale of +-1.65V to +-0.5
+    }
+
+    bool initialized_ = false;
+    bool enabled_ = true;
+    bool fault_ = false; // can be set by the simulation to inject a gate driver fault
+    float gain_ = 10.0f; // [V/V]
+};
+
+#endif // __SIM_GATE_DRIVER_HPP
@@ -0,0 +1,66 @@
+#ifndef __SIM_PLANT_HPP
+#define __SIM_PLANT_HPP
+
+#include <stdint.h>
+
+/**
+ * @brief Permanent magnet synchronous motor with a rigid load.
+ *
+ * This is a C++ port of the model in analysis/Simulation/MotorSim.py:
+ * a dq-frame PMSM (with optional saliency and d-axis saturation) driving an
+ * inertia with coulomb and viscous friction. A sinusoidal cogging torque can be added on top. The state is integrated with a fixed-step RK4 method.
+ *
+ * Phase voltages are referenced to the DC bus minus rail. Only their
+ * differential part drives current since the star point is floating.
+ */
+class SimPmsm {
+public:
+    struct Config_t {
+        // Defaults match the D5065 example in MotorSim.py
+        float phase_resistance = 0.039f;     // [Ohm]
+        float phase_inductance_d = 1.57e-5f; // [H]
+        float phase_inductance_q = 1.57e-5f; // [H]
+        float d_axis_saturation = 0.0f;      // [1/A] relative drop of the incremental d-axis inductance per A of i_d
+        float kv = 270.0f;                   // [rpm/V]
+        int32_t pole_pairs = 7;
+        float inertia = 1e-4f;               // [kg m^2]
+        float coulomb_friction = 0.001f;     // [Nm]
+        float viscous_friction = 1e-4f;      // [Nm/(rad/s)]
+        float load_torque = 0.0f;            // [Nm]
+        float phase_offset = 0.0f;           // [rad electrical] rotor angle at pos = 0
+        float cogging_torque = 0.0f;         // [Nm] amplitude
+        int32_t cogging_order = 84;          // [cycles/turn] lcm(slots, poles) of a 12N14P motor
+    };
+
+    explicit SimPmsm(Config_t config) : config_(config) {}
+
+    /**
+     * @brief Advances the model by dt seconds.
+     * @param v_phase: Phase terminal voltages [V]
+     * @param floating: If true, all switches are off. The phase currents
+     *        collapse to zero (freewheeling through the body diodes is not
+     *        modelled).
+     */
+    void step(float dt, const float v_phase[3], bool floating);
+
+    // Amplitude-invariant phase currents, positive into the motor [A]
+    void get_phase_currents(float i_phase[3]) const;
+
+    float get_torque() const;
+
+    Config_t config_;
+
+    // state
+    double pos_ = 0.0;   // [rad] mechanical, unwrapped
+    double vel_ = 0.0;   // [rad/s] mechanical
+    double i_d_ = 0.0;   // [A]
+    double i_q_ = 0.0;   // [A]
+
+private:
+    struct State { double pos, vel, i_d, i_q; };
+    State derivative(const State& x, double v_alpha, double v_beta) const;
+    double flux_linkage() const;
+    double elec_angle(double pos) const;
+};
+
+#endif // __SIM_PLANT_HPP
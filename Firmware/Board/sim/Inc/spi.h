@@ -0,0 +1,16 @@
+#ifndef __spi_H
+#define __spi_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SPI_HandleTypeDef hspi3;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __spi_H
@@ -0,0 +1,269 @@
+/*
+* @brief Host replacement for the CMSIS STM32F405xx device header.
+*
+* Only the peripherals and register fields that the firmware actually touches
+* are modelled. Each peripheral instance is a plain struct in RAM so the
+* simulation can read back what the firmware wrote (e.g. PWM compare values)
+* and inject what the hardware would produce (e.g. encoder counts).
+*/
+
+#ifndef __STM32F405xx_H
+#define __STM32F405xx_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+#define __I volatile const
+#define __O volatile
+
+typedef enum {
+    NonMaskableInt_IRQn = -14,
+    HardFault_IRQn = -13,
+    SysTick_IRQn = -1,
+    EXTI0_IRQn = 6,
+    EXTI1_IRQn = 7,
+    EXTI2_IRQn = 8,
+    EXTI3_IRQn = 9,
+    EXTI4_IRQn = 10,
+    ADC_IRQn = 18,
+    EXTI9_5_IRQn = 23,
+    TIM1_UP_TIM10_IRQn = 25,
+    TIM2_IRQn = 28,
+    TIM3_IRQn = 29,
+    TIM4_IRQn = 30,
+    I2C1_EV_IRQn = 31,
+    I2C1_ER_IRQn = 32,
+    EXTI15_10_IRQn = 40,
+    TIM8_UP_TIM13_IRQn = 44,
+    TIM5_IRQn = 50,
+    UART4_IRQn = 52,
+    OTG_FS_IRQn = 67,
+    OTG_HS_IRQn = 77,
+} IRQn_Type;
+
+typedef struct {
+    __IO uint32_t MODER;
+    __IO uint32_t OTYPER;
+    __IO uint32_t OSPEEDR;
+    __IO uint32_t PUPDR;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t LCKR;
+    __IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR;
+} TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t SR;
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMPR1;
+    __IO uint32_t SMPR2;
+    __IO uint32_t JOFR1;
+    __IO uint32_t JOFR2;
+    __IO uint32_t JOFR3;
+    __IO uint32_t JOFR4;
+    __IO uint32_t HTR;
+    __IO uint32_t LTR;
+    __IO uint32_t SQR1;
+    __IO uint32_t SQR2;
+    __IO uint32_t SQR3;
+    __IO uint32_t JSQR;
+    __IO uint32_t JDR1;
+    __IO uint32_t JDR2;
+    __IO uint32_t JDR3;
+    __IO uint32_t JDR4;
+    __IO uint32_t DR;
+} ADC_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t NDTR;
+    __IO uint32_t PAR;
+    __IO uint32_t M0AR;
+    __IO uint32_t M1AR;
+    __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t IMR;
+    __IO uint32_t EMR;
+    __IO uint32_t RTSR;
+    __IO uint32_t FTSR;
+    __IO uint32_t SWIER;
+    __IO uint32_t PR;
+} EXTI_TypeDef;
+
+typedef struct {
+    __IO uint32_t MEMRMP;
+    __IO uint32_t PMC;
+    __IO uint32_t EXTICR[4];
+    __IO uint32_t CMPCR;
+} SYSCFG_TypeDef;
+
+typedef struct {
+    __IO uint32_t ISER[8];
+    __IO uint32_t ICER[8];
+    __IO uint32_t ISPR[8];
+    __IO uint32_t ICPR[8];
+    __IO uint32_t IABR[8];
+    __IO uint8_t IP[240];
+} NVIC_Type;
+
+typedef struct { __IO uint32_t CR1; __IO uint32_t SR; __IO uint32_t DR; } SPI_TypeDef;
+typedef struct { __IO uint32_t SR; __IO uint32_t DR; __IO uint32_t BRR; __IO uint32_t CR1; } USART_TypeDef;
+typedef struct { __IO uint32_t MCR; __IO uint32_t MSR; __IO uint32_t TSR; __IO uint32_t RF0R; } CAN_TypeDef;
+typedef struct { __IO uint32_t CR1; __IO uint32_t SR1; __IO uint32_t DR; } I2C_TypeDef;
+typedef struct { __IO uint32_t GOTGCTL; } USB_OTG_GlobalTypeDef;
+typedef struct { __IO uint32_t CTRL; __IO uint32_t CYCCNT; } DWT_Type;
+typedef struct { __IO uint32_t DHCSR; __IO uint32_t DCRSR; __IO uint32_t DCRDR; __IO uint32_t DEMCR; } CoreDebug_Type;
+
+// Peripheral instances, defined in Board/sim/stm32_sim.cpp
+extern GPIO_TypeDef sim_gpioa, sim_gpiob, sim_gpioc, sim_gpiod;
+extern TIM_TypeDef sim_tim1, sim_tim2, sim_tim3, sim_tim4, sim_tim5, sim_tim8, sim_tim13, sim_tim14;
+extern ADC_TypeDef sim_adc1, sim_adc2, sim_adc3;
+extern DMA_Stream_TypeDef sim_dma_streams[16];
+extern EXTI_TypeDef sim_exti;
+extern SYSCFG_TypeDef sim_syscfg;
+extern NVIC_Type sim_nvic;
+extern SPI_TypeDef sim_spi3;
+extern USART_TypeDef sim_uart4;
+extern CAN_TypeDef sim_can1;
+extern I2C_TypeDef sim_i2c1;
+extern USB_OTG_GlobalTypeDef sim_usb_otg_fs;
+extern uint32_t sim_uid[3];
+extern uint8_t sim_otp[528];
+extern CoreDebug_Type sim_core_debug;
+
+// Updates CYCCNT with the virtual time plus the CPU time that the calling
+// thread consumed since the virtual time last changed (converted to 168MHz
+// cycles) and returns the DWT instance.
+DWT_Type* sim_dwt(void);
+
+#define GPIOA (&sim_gpioa)
+#define GPIOB (&sim_gpiob)
+#define GPIOC (&sim_gpioc)
+#define GPIOD (&sim_gpiod)
+#define TIM1 (&sim_tim1)
+#define TIM2 (&sim_tim2)
+#define TIM3 (&sim_tim3)
+#define TIM4 (&sim_tim4)
+#define TIM5 (&sim_tim5)
+#define TIM8 (&sim_tim8)
+#define TIM13 (&sim_tim13)
+#define TIM14 (&sim_tim14)
+#define ADC1 (&sim_adc1)
+#define ADC2 (&sim_adc2)
+#define ADC3 (&sim_adc3)
+#define DMA1_Stream0 (&sim_dma_streams[0])
+#define DMA1_Stream1 (&sim_dma_streams[1])
+#define DMA1_Stream2 (&sim_dma_streams[2])
+#define DMA1_Stream3 (&sim_dma_streams[3])
+#define DMA1_Stream4 (&sim_dma_streams[4])
+#define DMA1_Stream5 (&sim_dma_streams[5])
+#define DMA1_Stream6 (&sim_dma_streams[6])
+#define DMA1_Stream7 (&sim_dma_streams[7])
+#define DMA2_Stream0 (&sim_dma_streams[8])
+#define DMA2_Stream1 (&sim_dma_streams[9])
+#define DMA2_Stream2 (&sim_dma_streams[10])
+#define DMA2_Stream3 (&sim_dma_streams[11])
+#define DMA2_Stream4 (&sim_dma_streams[12])
+#define DMA2_Stream5 (&sim_dma_streams[13])
+#define DMA2_Stream6 (&sim_dma_streams[14])
+#define DMA2_Stream7 (&sim_dma_streams[15])
+#define EXTI (&sim_exti)
+#define SYSCFG (&sim_syscfg)
+#define NVIC (&sim_nvic)
+#define SPI3 (&sim_spi3)
+#define UART4 (&sim_uart4)
+#define CAN1 (&sim_can1)
+#define I2C1 (&sim_i2c1)
+#define USB_OTG_FS (&sim_usb_otg_fs)
+#define UID_BASE ((uintptr_t)sim_uid)
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+
+#define TIM_CR1_CEN (1U << 0)
+#define TIM_CR1_DIR (1U << 4)
+#define TIM_EGR_UG (1U << 0)
+#define TIM_BDTR_MOE (1U << 15)
+#define TIM_SR_UIF (1U << 0)
+#define TIM_DIER_UIE (1U << 0)
+
+#define ADC_SR_EOC (1U << 1)
+#define ADC_SR_JEOC (1U << 2)
+#define ADC_SR_JSTRT (1U << 3)
+#define ADC_SR_STRT (1U << 4)
+#define ADC_SR_OVR (1U << 5)
+#define ADC_CR1_EOCIE (1U << 5)
+#define ADC_CR1_JEOCIE (1U << 7)
+#define ADC_CR1_AWDCH_Pos (0U)
+#define ADC_CR2_ADON (1U << 0)
+
+#define DMA_SxCR_CHSEL_Pos (25U)
+#define DMA_SxCR_CHSEL_Msk (0x7U << DMA_SxCR_CHSEL_Pos)
+#define DMA_SxCR_PL_Pos (16U)
+#define DMA_SxCR_PL_Msk (0x3U << DMA_SxCR_PL_Pos)
+
+#define DWT_CTRL_CYCCNTENA_Msk (1U << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+
+#define GPIO_MODER_MODER0 (0x3U)
+#define GPIO_OSPEEDER_OSPEEDR0 (0x3U)
+#define GPIO_OTYPER_OT_0 (0x1U)
+#define GPIO_PUPDR_PUPDR0 (0x3U)
+
+#define FLASH_OTP_BASE ((uintptr_t)sim_otp)
+
+/* Core functions --------------------------------------------------------------*/
+
+// Interrupts are only dispatched while all threads are blocked, so critical
+// sections are implicit. The mask is only tracked to support save/restore.
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+void __set_MSP(uint32_t topOfMainStack);
+#define __ASM __asm
+
+static inline void __NOP(void) {}
+static inline void __DSB(void) {}
+static inline void __ISB(void) {}
+
+void NVIC_SystemReset(void);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __STM32F405xx_H
@@ -0,0 +1,16 @@
+#ifndef __usart_H
+#define __usart_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern UART_HandleTypeDef huart4;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __usart_H
@@ -0,0 +1,22 @@
+#ifndef __usb_device_H
+#define __usb_device_H
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t id;
+} USBD_HandleTypeDef;
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+void MX_USB_DEVICE_Init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __usb_device_H
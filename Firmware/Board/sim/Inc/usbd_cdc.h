@@ -0,0 +1,23 @@
+#ifndef __USB_CDC_H
+#define __USB_CDC_H
+
+#include "usb_device.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CDC_IN_EP 0x81
+#define CDC_OUT_EP 0x01
+#define ODRIVE_IN_EP 0x83
+#define ODRIVE_OUT_EP 0x03
+
+#define USBD_OK 0
+
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef* pdev, uint8_t endpoint_pair);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __USB_CDC_H
@@ -0,0 +1,18 @@
+#ifndef __USBD_CDC_IF_H
+#define __USBD_CDC_IF_H
+
+#include "usbd_cdc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define USB_TX_DATA_SIZE 64
+
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len, uint8_t endpoint_pair);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __USBD_CDC_IF_H
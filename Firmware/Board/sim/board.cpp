@@ -0,0 +1,288 @@
+/*
+* @brief Contains board specific variables and initialization functions
+*/
+
+#include <board.h>
+
+#include <odrive_main.h>
+#include <low_level.h>
+
+#include <adc.h>
+#include <tim.h>
+#include <usart.h>
+#include <freertos_vars.h>
+
+#include "sim.hpp"
+
+#include <stdlib.h>
+
+Stm32SpiArbiter spi3_arbiter{&hspi3};
+Stm32SpiArbiter& ext_spi_arbiter = spi3_arbiter;
+
+UART_HandleTypeDef* uart0 = &huart4;
+UART_HandleTypeDef* uart1 = nullptr;
+UART_HandleTypeDef* uart2 = nullptr;
+
+SimGateDriver m0_gate_driver;
+SimGateDriver m1_gate_driver;
+
+const float fet_thermistor_poly_coeffs[] =
+    {363.93910201f, -462.15369634f, 307.55129571f, -27.72569531f};
+const size_t fet_thermistor_num_coeffs = sizeof(fet_thermistor_poly_coeffs)/sizeof(fet_thermistor_poly_coeffs[1]);
+
+OnboardThermistorCurrentLimiter fet_thermistors[AXIS_COUNT] = {
+    {
+        15, // adc_channel
+        &fet_thermistor_poly_coeffs[0], // coefficients
+        fet_thermistor_num_coeffs // num_coeffs
+    }, {
+        4, // adc_channel
+        &fet_thermistor_poly_coeffs[0], // coefficients
+        fet_thermistor_num_coeffs // num_coeffs
+    }
+};
+
+Motor motors[AXIS_COUNT] = {
+    {
+        &htim1, // timer
+        TIM_1_8_PERIOD_CLOCKS, // control_deadline
+        1.0f / SHUNT_RESISTANCE, // shunt_conductance [S]
+        m0_gate_driver, // gate_driver
+        m0_gate_driver // opamp
+    },
+    {
+        &htim8, // timer
+        (3 * TIM_1_8_PERIOD_CLOCKS) / 2, // control_deadline
+        1.0f / SHUNT_RESISTANCE, // shunt_conductance [S]
+        m1_gate_driver, // gate_driver
+        m1_gate_driver // opamp
+    }
+};
+
+Encoder encoders[AXIS_COUNT] = {
+    {
+        &htim3, // timer
+        {M0_ENC_Z_GPIO_Port, M0_ENC_Z_Pin}, // index_gpio
+        {M0_ENC_A_GPIO_Port, M0_ENC_A_Pin}, // hallA_gpio
+        {M0_ENC_B_GPIO_Port, M0_ENC_B_Pin}, // hallB_gpio
+        {M0_ENC_Z_GPIO_Port, M0_ENC_Z_Pin}, // hallC_gpio
+        &spi3_arbiter // spi_arbiter
+    },
+    {
+        &htim4, // timer
+        {M1_ENC_Z_GPIO_Port, M1_ENC_Z_Pin}, // index_gpio
+        {M1_ENC_A_GPIO_Port, M1_ENC_A_Pin}, // hallA_gpio
+        {M1_ENC_B_GPIO_Port, M1_ENC_B_Pin}, // hallB_gpio
+        {M1_ENC_Z_GPIO_Port, M1_ENC_Z_Pin}, // hallC_gpio
+        &spi3_arbiter // spi_arbiter
+    }
+};
+
+// TODO: this has no hardware dependency and should be allocated depending on config
+Endstop endstops[2 * AXIS_COUNT];
+MechanicalBrake mechanical_brakes[AXIS_COUNT];
+
+SensorlessEstimator sensorless_estimators[AXIS_COUNT];
+Controller controllers[AXIS_COUNT];
+TrapezoidalTrajectory trap[AXIS_COUNT];
+OffboardThermistorCurrentLimiter motor_thermistors[AXIS_COUNT];
+
+std::array<Axis, AXIS_COUNT> axes{{
+    {
+        0, // axis_num
+        1, // step_gpio_pin
+        2, // dir_gpio_pin
+        (osPriority)(osPriorityHigh + (osPriority)1), // thread_priority
+        encoders[0], // encoder
+        sensorless_estimators[0], // sensorless_estimator
+        controllers[0], // controller
+        fet_thermistors[0], // fet_thermistor
+        motor_thermistors[0], // motor_thermistor
+        motors[0], // motor
+        trap[0], // trap
+        endstops[0], endstops[1], // min_endstop, max_endstop
+        mechanical_brakes[0], // mechanical brake
+    },
+    {
+        1, // axis_num
+        7, // step_gpio_pin
+        8, // dir_gpio_pin
+        osPriorityHigh, // thread_priority
+        encoders[1], // encoder
+        sensorless_estimators[1], // sensorless_estimator
+        controllers[1], // controller
+        fet_thermistors[1], // fet_thermistor
+        motor_thermistors[1], // motor_thermistor
+        motors[1], // motor
+        trap[1], // trap
+        endstops[2], endstops[3], // min_endstop, max_endstop
+        mechanical_brakes[1], // mechanical brake
+    },
+}};
+
+// Same pinout as ODrive v3.5 and v3.6
+Stm32Gpio gpios[GPIO_COUNT] = {
+    {nullptr, 0}, // dummy GPIO0 so that PCB labels and software numbers match
+
+    {GPIOA, GPIO_PIN_0}, // GPIO1
+    {GPIOA, GPIO_PIN_1}, // GPIO2
+    {GPIOA, GPIO_PIN_2}, // GPIO3
+    {GPIOA, GPIO_PIN_3}, // GPIO4
+    {GPIOC, GPIO_PIN_4}, // GPIO5
+    {GPIOB, GPIO_PIN_2}, // GPIO6
+    {GPIOA, GPIO_PIN_15}, // GPIO7
+    {GPIOB, GPIO_PIN_3}, // GPIO8
+
+    {GPIOB, GPIO_PIN_4}, // ENC0_A
+    {GPIOB, GPIO_PIN_5}, // ENC0_B
+    {GPIOC, GPIO_PIN_9}, // ENC0_Z
+    {GPIOB, GPIO_PIN_6}, // ENC1_A
+    {GPIOB, GPIO_PIN_7}, // ENC1_B
+    {GPIOC, GPIO_PIN_15}, // ENC1_Z
+    {GPIOB, GPIO_PIN_8}, // CAN_R
+    {GPIOB, GPIO_PIN_9}, // CAN_D
+};
+
+std::array<GpioFunction, 3> alternate_functions[GPIO_COUNT] = {
+    /* GPIO0 (inexistent): */ {{}},
+    /* GPIO1: */ {{{ODrive::GPIO_MODE_UART0, GPIO_AF8_UART4}, {ODrive::GPIO_MODE_PWM0, GPIO_AF2_TIM5}}},
+    /* GPIO2: */ {{{ODrive::GPIO_MODE_UART0, GPIO_AF8_UART4}, {ODrive::GPIO_MODE_PWM0, GPIO_AF2_TIM5}}},
+    /* GPIO3: */ {{{ODrive::GPIO_MODE_PWM0, GPIO_AF2_TIM5}}},
+    /* GPIO4: */ {{{ODrive::GPIO_MODE_PWM0, GPIO_AF2_TIM5}}},
+    /* GPIO5: */ {{}},
+    /* GPIO6: */ {{}},
+    /* GPIO7: */ {{}},
+    /* GPIO8: */ {{}},
+    /* ENC0_A: */ {{{ODrive::GPIO_MODE_ENC0, GPIO_AF2_TIM3}}},
+    /* ENC0_B: */ {{{ODrive::GPIO_MODE_ENC0, GPIO_AF2_TIM3}}},
+    /* ENC0_Z: */ {{}},
+    /* ENC1_A: */ {{{ODrive::GPIO_MODE_I2C0, GPIO_AF4_I2C1}, {ODrive::GPIO_MODE_ENC1, GPIO_AF2_TIM4}}},
+    /* ENC1_B: */ {{{ODrive::GPIO_MODE_I2C0, GPIO_AF4_I2C1}, {ODrive::GPIO_MODE_ENC1, GPIO_AF2_TIM4}}},
+    /* ENC1_Z: */ {{}},
+    /* CAN_R: */ {{{ODrive::GPIO_MODE_CAN0, GPIO_AF9_CAN1}, {ODrive::GPIO_MODE_I2C0, GPIO_AF4_I2C1}}},
+    /* CAN_D: */ {{{ODrive::GPIO_MODE_CAN0, GPIO_AF9_CAN1}, {ODrive::GPIO_MODE_I2C0, GPIO_AF4_I2C1}}},
+};
+
+PwmInput pwm0_input{&htim5, {1, 2, 3, 4}};
+
+extern PCD_HandleTypeDef hpcd_USB_OTG_FS; // defined in stm32_sim.cpp
+PCD_HandleTypeDef& usb_pcd_handle = hpcd_USB_OTG_FS;
+USBD_HandleTypeDef& usb_dev_handle = hUsbDeviceFS;
+
+osThreadId defaultTaskHandle;
+const uint32_t stack_size_default_task = 2048; // Bytes
+
+// TCP port on which the fibre protocol is served (instead of USB)
+static const unsigned int default_tcp_port = 9910;
+
+void system_init() {
+    // Reset values of the timers that the firmware reads or relies on
+    for (TIM_HandleTypeDef* htim : {&htim1, &htim8}) {
+        htim->Init.Period = TIM_1_8_PERIOD_CLOCKS;
+        htim->Init.RepetitionCounter = TIM_1_8_RCR;
+        htim->Instance->ARR = TIM_1_8_PERIOD_CLOCKS;
+        htim->Instance->RCR = TIM_1_8_RCR;
+    }
+    for (TIM_HandleTypeDef* htim : {&htim3, &htim4}) {
+        htim->Init.Period = 0xFFFF;
+        htim->Instance->ARR = 0xFFFF;
+    }
+    htim2.Init.Period = TIM_APB1_PERIOD_CLOCKS;
+    htim2.Instance->ARR = TIM_APB1_PERIOD_CLOCKS;
+    TIM_TIME_BASE->ARR = 999; // 1MHz tick, reloads every millisecond
+}
+
+bool board_init() {
+    HAL_UART_DeInit(uart0);
+    uart0->Init.BaudRate = odrv.config_.uart0_baudrate;
+    HAL_UART_Init(uart0);
+
+    if (odrv.config_.enable_can0) {
+        if (odrv.config_.gpio_modes[15] != ODriveIntf::GPIO_MODE_CAN0 || odrv.config_.gpio_modes[16] != ODriveIntf::GPIO_MODE_CAN0) {
+            odrv.misconfigured_ = true;
+        }
+    }
+
+    for (TIM_HandleTypeDef* htim : {&htim1, &htim8}) {
+        htim->Init.Period = pwm_period_clocks;
+        htim->Init.RepetitionCounter = pwm_rcr;
+        htim->Instance->ARR = pwm_period_clocks;
+        htim->Instance->RCR = pwm_rcr;
+    }
+    for (TIM_HandleTypeDef* htim : {&htim1, &htim8, &htim13}) {
+        htim->Instance->CR1 |= TIM_CR1_CEN;
+    }
+
+    // Serve the native protocol over TCP. This takes the place of USB.
+    const char* port_str = getenv("ODRIVE_SIM_PORT");
+    unsigned int port = port_str ? (unsigned int)strtoul(port_str, nullptr, 10) : default_tcp_port;
+    start_tcp_server(port);
+    printf("serving native protocol on TCP port %u\n", port);
+
+    return true;
+}
+
+
+extern "C" {
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
+    HAL_SPI_TxRxCpltCallback(hspi);
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi) {
+    HAL_SPI_TxRxCpltCallback(hspi);
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi) {
+    if (hspi == &hspi3) {
+        spi3_arbiter.on_complete();
+    }
+}
+
+void TIM1_UP_TIM10_IRQHandler(void) {
+    COUNT_IRQ(TIM1_UP_TIM10_IRQn);
+    __HAL_TIM_CLEAR_IT(&htim1, TIM_IT_UPDATE);
+    motors[0].tim_update_cb();
+}
+
+void TIM8_UP_TIM13_IRQHandler(void) {
+    COUNT_IRQ(TIM8_UP_TIM13_IRQn);
+    __HAL_TIM_CLEAR_IT(&htim8, TIM_IT_UPDATE);
+    motors[1].tim_update_cb();
+}
+
+void TIM3_IRQHandler(void) {
+    COUNT_IRQ(TIM3_IRQn);
+    encoders[0].enc_edge_cb();
+}
+
+void TIM4_IRQHandler(void) {
+    COUNT_IRQ(TIM4_IRQn);
+    encoders[1].enc_edge_cb();
+}
+
+void ADC_IRQ_Dispatch(ADC_HandleTypeDef* hadc, void(*callback)(ADC_HandleTypeDef* hadc, bool injected)) {
+    // Injected measurements
+    uint32_t JEOC = __HAL_ADC_GET_FLAG(hadc, ADC_FLAG_JEOC);
+    uint32_t JEOC_IT_EN = __HAL_ADC_GET_IT_SOURCE(hadc, ADC_IT_JEOC);
+    if (JEOC && JEOC_IT_EN) {
+        callback(hadc, true);
+        __HAL_ADC_CLEAR_FLAG(hadc, (ADC_FLAG_JSTRT | ADC_FLAG_JEOC));
+    }
+    // Regular measurements
+    uint32_t EOC = __HAL_ADC_GET_FLAG(hadc, ADC_FLAG_EOC);
+    uint32_t EOC_IT_EN = __HAL_ADC_GET_IT_SOURCE(hadc, ADC_IT_EOC);
+    if (EOC && EOC_IT_EN) {
+        callback(hadc, false);
+        __HAL_ADC_CLEAR_FLAG(hadc, (ADC_FLAG_STRT | ADC_FLAG_EOC));
+    }
+}
+
+void ADC_IRQHandler(void) {
+    COUNT_IRQ(ADC_IRQn);
+    ADC_IRQ_Dispatch(&hadc1, &vbus_sense_adc_cb);
+    ADC_IRQ_Dispatch(&hadc2, &pwm_trig_adc_cb);
+    ADC_IRQ_Dispatch(&hadc3, &pwm_trig_adc_cb);
+}
+
+}
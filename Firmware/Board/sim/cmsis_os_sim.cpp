@@ -0,0 +1,310 @@
+/*
+* @brief CMSIS-RTOS implementation of the simulated board.
+*
+* Each RTOS thread is backed by a host thread, but only one of them holds the
+* simulated CPU at any given time. When the CPU becomes free it goes to the
+* runnable thread with the highest priority (the one created first among equal
+* priorities). A thread keeps the CPU until it blocks, i.e. scheduling is
+* cooperative.
+*
+* Virtual time only advances (and interrupts are only dispatched) when no
+* thread is runnable, i.e. when the simulated CPU would be idle. As a
+* consequence the firmware never misses a deadline because of a slow host and
+* every run with the same inputs produces the same control loop behavior.
+*
+* Interrupt handlers run on the simulation engine's thread, which is not an
+* RTOS thread. Other non-RTOS threads must not call into the kernel.
+*/
+
+#include <cmsis_os.h>
+#include "sim.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SimThread {
+    osThreadDef_t def; // copied because the definition is often a local variable
+    void* argument;
+    std::condition_variable cv; // notified when the thread may be next to run
+    bool blocked = false;
+    uint64_t deadline_ns = UINT64_MAX;
+    int32_t signals = 0;
+    bool notified = false;
+    bool suspended = false;
+};
+
+struct SimSemaphore {
+    int32_t count;
+    int32_t max_count;
+};
+
+static std::mutex kernel_mutex;
+static std::condition_variable idle_cv;
+static bool kernel_started = false;
+static size_t n_runnable = 0;
+static SimThread* cpu_owner = nullptr;
+static uint64_t now_ns = 0;
+static std::vector<SimThread*> threads;
+static thread_local SimThread* current_thread = nullptr;
+
+static constexpr uint64_t ns_per_tick = 1000000000ULL / configTICK_RATE_HZ;
+
+static uint64_t timeout_to_deadline_ns(uint32_t millisec) {
+    return (millisec == osWaitForever) ? UINT64_MAX : now_ns + (uint64_t)millisec * 1000000ULL;
+}
+
+// @brief Returns the runnable thread with the highest priority
+static SimThread* next_thread() {
+    SimThread* next = nullptr;
+    for (SimThread* thread : threads) {
+        if (!thread->blocked && (!next || thread->def.tpriority > next->def.tpriority)) {
+            next = thread;
+        }
+    }
+    return next;
+}
+
+// @brief Hands the CPU to the next thread if it is free
+static void dispatch() {
+    if (kernel_started && !cpu_owner) {
+        SimThread* next = next_thread();
+        if (next) {
+            next->cv.notify_one();
+        }
+    }
+}
+
+// @brief Marks a blocked thread runnable. The thread re-evaluates its wait
+// condition once it gets the CPU and blocks again if it is not yet satisfied.
+static void wake(SimThread* thread) {
+    if (thread->blocked) {
+        thread->blocked = false;
+        ++n_runnable;
+        dispatch();
+    }
+}
+
+// @brief Waits until the calling thread is scheduled.
+static void acquire_cpu(std::unique_lock<std::mutex>& lock, SimThread* thread) {
+    thread->cv.wait(lock, [&] {
+        return kernel_started && !cpu_owner && next_thread() == thread;
+    });
+    cpu_owner = thread;
+}
+
+// @brief Blocks the calling thread until it is woken or the deadline passes.
+// Returns false if the deadline has passed.
+static bool block(std::unique_lock<std::mutex>& lock, uint64_t deadline_ns) {
+    if (now_ns >= deadline_ns) {
+        return false;
+    }
+
+    SimThread* thread = current_thread;
+    thread->deadline_ns = deadline_ns;
+    thread->blocked = true;
+    cpu_owner = nullptr;
+    if (--n_runnable == 0) {
+        idle_cv.notify_all();
+    }
+    dispatch();
+    acquire_cpu(lock, thread);
+    return true;
+}
+
+uint64_t sim_get_time_ns() {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    return now_ns;
+}
+
+void sim_wait_until_idle() {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    idle_cv.wait(lock, [] { return n_runnable == 0; });
+}
+
+void sim_advance_time(uint64_t delta_ns) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    now_ns += delta_ns;
+    for (SimThread* thread : threads) {
+        if (thread->deadline_ns <= now_ns) {
+            wake(thread);
+        }
+    }
+}
+
+static void thread_entry(SimThread* thread) {
+    {
+        std::unique_lock<std::mutex> lock(kernel_mutex);
+        acquire_cpu(lock, thread);
+    }
+    current_thread = thread;
+    thread->def.pthread(thread->argument);
+
+    // RTOS threads must not return. Treat this like vTaskDelete().
+    vTaskDelete(thread);
+}
+
+osStatus osKernelStart(void) {
+    {
+        std::unique_lock<std::mutex> lock(kernel_mutex);
+        kernel_started = true;
+        dispatch();
+    }
+    sim_run();
+    return osOK;
+}
+
+uint32_t osKernelSysTick(void) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    return (uint32_t)(now_ns / ns_per_tick);
+}
+
+osThreadId osThreadCreate(const osThreadDef_t* thread_def, void* argument) {
+    SimThread* thread = new SimThread();
+    thread->def = *thread_def;
+    thread->argument = argument;
+
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    threads.push_back(thread);
+    ++n_runnable;
+    std::thread(thread_entry, thread).detach();
+    return thread;
+}
+
+osThreadId osThreadGetId(void) {
+    return current_thread;
+}
+
+osStatus osThreadSuspend(osThreadId thread_id) {
+    if (thread_id && thread_id != current_thread) {
+        return osErrorParameter; // suspending other threads is not supported
+    }
+
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    current_thread->suspended = true;
+    while (current_thread->suspended) {
+        block(lock, UINT64_MAX);
+    }
+    return osOK;
+}
+
+osStatus osThreadResume(osThreadId thread_id) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    if (thread_id && thread_id->suspended) {
+        thread_id->suspended = false;
+        wake(thread_id);
+    }
+    return osOK;
+}
+
+osStatus osDelay(uint32_t millisec) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    uint64_t deadline_ns = timeout_to_deadline_ns(millisec);
+    while (block(lock, deadline_ns)) {
+    }
+    return osEventTimeout;
+}
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    int32_t previous = thread_id->signals;
+    thread_id->signals |= signals;
+    thread_id->notified = true;
+    wake(thread_id);
+    return previous;
+}
+
+// Same semantics as the FreeRTOS based implementation: returns as soon as the
+// thread is notified and clears the specified signals on exit.
+osEvent osSignalWait(int32_t signals, uint32_t millisec) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    osEvent event;
+    event.value.signals = 0;
+
+    uint64_t deadline_ns = timeout_to_deadline_ns(millisec);
+    while (!current_thread->notified) {
+        if (!block(lock, deadline_ns)) {
+            event.status = millisec ? osEventTimeout : osOK;
+            return event;
+        }
+    }
+
+    current_thread->notified = false;
+    event.value.signals = current_thread->signals;
+    current_thread->signals &= ~signals;
+    event.status = osEventSignal;
+    return event;
+}
+
+osSemaphoreId osSemaphoreCreate(const osSemaphoreDef_t* semaphore_def, int32_t count) {
+    (void)semaphore_def;
+    return new SimSemaphore{count, count};
+}
+
+osStatus osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    uint64_t deadline_ns = timeout_to_deadline_ns(millisec);
+    while (semaphore_id->count == 0) {
+        if (!block(lock, deadline_ns)) {
+            return osErrorOS;
+        }
+    }
+    --semaphore_id->count;
+    return osOK;
+}
+
+osStatus osSemaphoreRelease(osSemaphoreId semaphore_id) {
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    if (semaphore_id->count >= semaphore_id->max_count) {
+        return osErrorOS;
+    }
+    ++semaphore_id->count;
+
+    // Waiters are not tracked per semaphore. Every blocked thread re-checks
+    // its wait condition, which is cheap for the handful of threads in this
+    // firmware.
+    for (SimThread* thread : threads) {
+        if (!thread->suspended) {
+            wake(thread);
+        }
+    }
+    return osOK;
+}
+
+uint32_t xTaskGetTickCount(void) {
+    return osKernelSysTick();
+}
+
+void vTaskDelete(xTaskHandle xTaskToDelete) {
+    if (xTaskToDelete && xTaskToDelete != current_thread) {
+        return; // deleting other threads is not supported
+    }
+
+    // The host thread stays around but is never woken again.
+    std::unique_lock<std::mutex> lock(kernel_mutex);
+    for (;;) {
+        current_thread->suspended = true;
+        block(lock, UINT64_MAX);
+    }
+}
+
+uint32_t uxTaskGetStackHighWaterMark(xTaskHandle xTask) {
+    // Host threads have plenty of stack. Report the configured size as unused.
+    SimThread* thread = xTask ? xTask : current_thread;
+    return thread ? thread->def.stacksize : 0;
+}
+
+size_t xPortGetMinimumEverFreeHeapSize(void) {
+    return configTOTAL_HEAP_SIZE;
+}
+
+void* pvPortMalloc(size_t xSize) {
+    return malloc(xSize);
+}
+
+void vPortFree(void* pv) {
+    free(pv);
+}
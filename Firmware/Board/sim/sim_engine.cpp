@@ -0,0 +1,397 @@
+/*
+* @brief Simulation engine of the simulated board.
+*
+* Plays the role of the PWM timers, ADCs, inverters, motors and encoders.
+*
+* Each control period (125us by default) contains the same events as on ODrive v3.x:
+*   1. M0 current measurement (TIM1 update, ADC1/2/3 injected conversions)
+*   2. M1 current measurement (TIM8 update, ADC2/3 regular conversions)
+*   3. M0 DC calibration
+*   4. M1 DC calibration
+* After each event the engine waits until all RTOS threads are blocked before
+* it integrates the plant up to the next event. Like on the hardware, the PWM
+* timings that the interrupt handlers write to CCR1..3 only take effect at the
+* next update event of the timer (output compare preload). With the above
+* order this means that the timings computed after a current measurement
+* are applied during the whole next control period.
+*
+* Runtime options are taken from environment variables:
+*   ODRIVE_SIM_REALTIME: 0 to run as fast as possible (default: 1)
+*   ODRIVE_SIM_VBUS: DC bus voltage in V (default: 24)
+*   ODRIVE_SIM_ENCODER_CPR: counts per revolution of both encoders (default: 8192)
+*/
+
+#include <board.h>
+#include <adc.h>
+#include <tim.h>
+
+#include "sim.hpp"
+#include "sim_plant.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+void TIM1_UP_TIM10_IRQHandler(void);
+void TIM8_UP_TIM13_IRQHandler(void);
+void ADC_IRQHandler(void);
+void EXTI9_5_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
+void TIM3_IRQHandler(void);
+void TIM4_IRQHandler(void);
+void vApplicationIdleHook(void);
+}
+
+static constexpr float adc_full_scale = static_cast<float>(1UL << 12UL);
+static constexpr float adc_ref_voltage = 3.3f;
+static constexpr float adc_midpoint = adc_full_scale / 2.0f;
+
+// ADC value that the FET thermistors report at room temperature
+static constexpr uint16_t fet_thermistor_adcval = 1024; // ~26°C
+
+static constexpr float max_integration_step = 10e-6f; // [s]
+
+struct SimAxis {
+    SimPmsm motor;
+    TIM_TypeDef* pwm_timer;
+    void (*tim_update_irq_handler)(void);
+    SimGateDriver& gate_driver;
+    TIM_TypeDef* encoder_timer;
+    uint16_t index_pin_mask;
+    void (*index_irq_handler)(void);
+    void (*capture_irq_handler)(void);
+
+    uint32_t active_ccr[3] = {0, 0, 0}; // compare values after the preload
+    int64_t encoder_count = 0;
+    int64_t encoder_turns = 0;
+    bool index_pending = false;
+    bool capture_pending = false;
+    uint64_t capture_clocks = 0; // time of the captured edge
+};
+
+extern SimGateDriver m0_gate_driver;
+extern SimGateDriver m1_gate_driver;
+
+static std::vector<SimAxis> sim_axes;
+static float sim_vbus = 24.0f;
+static bool sim_realtime = true;
+static int32_t sim_encoder_cpr = 8192;
+static float sim_dead_time = 0.0f; // [s]
+
+static uint16_t current_to_adcval(float current, float gain) {
+    float adcval = adc_midpoint + current * SHUNT_RESISTANCE * gain * (adc_full_scale / adc_ref_voltage);
+    return (uint16_t)std::clamp(lroundf(adcval), 0L, (long)adc_full_scale - 1);
+}
+
+static float getenv_float(const char* name, float default_val) {
+    const char* str = getenv(name);
+    return str ? strtof(str, nullptr) : default_val;
+}
+
+// @brief Emulates the input capture on the rising edges of encoder A, which
+// the timer latches in CCR1. Edges that occur while the capture interrupt is
+// disabled are ignored.
+// @param pos: positions before and after the step [counts]
+static void capture_edges(SimAxis& axis, double pos_before, double pos_after, uint64_t clocks_before, uint64_t clocks_after) {
+    TIM_TypeDef* tim = axis.encoder_timer;
+    int64_t count_before = (int64_t)floor(pos_before);
+    int64_t count_after = (int64_t)floor(pos_after);
+    if (count_before == count_after || axis.capture_pending || !(tim->DIER & TIM_IT_CC1)) {
+        return;
+    }
+
+    // In forward direction A rises when the count changes from 4n to 4n+1,
+    // in backward direction when it changes from 4n+3 to 4n+2.
+    bool down = count_after < count_before;
+    int64_t edge = down ? count_before : count_before + 1; // first boundary that is crossed
+    int64_t phase = down ? 3 : 1;
+    while (((edge % 4) + 4) % 4 != phase) {
+        edge += down ? -1 : 1;
+    }
+    if (down ? (edge <= count_after) : (edge > count_after)) {
+        return;
+    }
+
+    double frac = ((double)edge - pos_before) / (pos_after - pos_before);
+    axis.capture_clocks = clocks_before + (uint64_t)(frac * (double)(clocks_after - clocks_before));
+    tim->CCR1 = (uint16_t)(tim->CNT + (uint32_t)((down ? edge - 1 : edge) - axis.encoder_count));
+    if (down) {
+        tim->CR1 |= TIM_CR1_DIR;
+    } else {
+        tim->CR1 &= ~TIM_CR1_DIR;
+    }
+    axis.capture_pending = true;
+}
+
+// @brief Integrates all motors over dt and updates the encoder inputs.
+// @param clocks: time at the start of the integration [timer clocks]
+static void integrate(float dt, uint64_t clocks) {
+    int n_steps = (int)ceilf(dt / max_integration_step);
+    float h = dt / (float)n_steps;
+    uint64_t step_clocks = (uint64_t)llroundf(h * (float)TIM_1_8_CLOCK_HZ);
+    double counts_per_rad = (double)sim_encoder_cpr / (2.0 * (double)M_PI);
+
+    for (SimAxis& axis : sim_axes) {
+        bool floating = !(axis.pwm_timer->BDTR & TIM_BDTR_MOE) || !axis.gate_driver.enabled_;
+        float v_phase[3] = {0.0f, 0.0f, 0.0f};
+        if (!floating) {
+            // The timers run in PWM mode 2, i.e. the high side is on while
+            // the counter is above the compare value.
+            for (size_t i = 0; i < 3; ++i) {
+                float duty = 1.0f - std::clamp((float)axis.active_ccr[i] / (float)pwm_period_clocks, 0.0f, 1.0f);
+                v_phase[i] = duty * sim_vbus;
+            }
+        }
+
+        for (int i = 0; i < n_steps; ++i) {
+            double pos_before = axis.motor.pos_ * counts_per_rad;
+            // During the dead time both switches of a phase are off and the
+            // current flows through the body diode that opposes it. This
+            // costs a fraction dead_time / PWM period of vbus, except on legs
+            // that don't switch.
+            float v_applied[3] = {v_phase[0], v_phase[1], v_phase[2]};
+            if (!floating && sim_dead_time > 0.0f) {
+                float i_phase[3];
+                axis.motor.get_phase_currents(i_phase);
+                float v_dead = sim_vbus * sim_dead_time * (float)TIM_1_8_CLOCK_HZ / (float)(2 * pwm_period_clocks);
+                for (size_t j = 0; j < 3; ++j) {
+                    bool switching = axis.active_ccr[j] > 0 && axis.active_ccr[j] < pwm_period_clocks;
+                    if (switching)
+                        v_applied[j] -= std::copysign(v_dead, i_phase[j]);
+                }
+            }
+            axis.motor.step(h, v_applied, floating);
+            capture_edges(axis, pos_before, axis.motor.pos_ * counts_per_rad,
+                          clocks + (uint64_t)i * step_clocks, clocks + (uint64_t)(i + 1) * step_clocks);
+        }
+
+        // Quadrature encoder: the timer counts edges relative to wherever the
+        // firmware last set it.
+        double turns = axis.motor.pos_ / (2.0 * (double)M_PI);
+        int64_t count = (int64_t)floor(turns * (double)sim_encoder_cpr);
+        axis.encoder_timer->CNT = (uint16_t)(axis.encoder_timer->CNT + (uint32_t)(count - axis.encoder_count));
+        axis.encoder_count = count;
+
+        int64_t full_turns = (int64_t)floor(turns);
+        if (full_turns != axis.encoder_turns) {
+            axis.encoder_turns = full_turns;
+            axis.index_pending = true;
+        }
+    }
+}
+
+// @brief Dispatches interrupts that don't belong to the PWM cycle
+// @param clocks: current time [timer clocks]
+static void dispatch_async_irqs(uint64_t clocks) {
+    for (SimAxis& axis : sim_axes) {
+        if (axis.capture_pending) {
+            // The handler sees the time of the edge
+            axis.capture_pending = false;
+            sim_set_cycle_count(axis.capture_clocks);
+            axis.encoder_timer->SR |= TIM_FLAG_CC1;
+            axis.capture_irq_handler();
+            sim_set_cycle_count(clocks);
+        }
+        if (axis.index_pending) {
+            axis.index_pending = false;
+            if (EXTI->IMR & axis.index_pin_mask) {
+                EXTI->PR |= axis.index_pin_mask;
+                axis.index_irq_handler();
+            }
+        }
+    }
+}
+
+// @brief Simulates a PWM timer update event of one motor together with the
+// ADC conversions triggered by it.
+static void pwm_event(size_t axis_num, bool current_meas) {
+    SimAxis& axis = sim_axes[axis_num];
+
+    // Update event: the preloaded compare values become active
+    axis.active_ccr[0] = axis.pwm_timer->CCR1;
+    axis.active_ccr[1] = axis.pwm_timer->CCR2;
+    axis.active_ccr[2] = axis.pwm_timer->CCR3;
+
+    // The shunts of phase B and C are on the low side and only see the
+    // current while the low side is on. At the bottom of the counter
+    // (current measurement) that is the case unless the compare value is 0,
+    // at the top (DC calibration) only if the compare value is the full
+    // period, i.e. if the leg is clamped to the low side.
+    bool floating = !(axis.pwm_timer->BDTR & TIM_BDTR_MOE) || !axis.gate_driver.enabled_;
+    float i_phase[3] = {0.0f, 0.0f, 0.0f};
+    axis.motor.get_phase_currents(i_phase);
+    for (size_t i = 1; i < 3; ++i) {
+        bool low_side_on = current_meas ? (axis.active_ccr[i] > 0) : (axis.active_ccr[i] >= pwm_period_clocks);
+        if (floating ? !current_meas : !low_side_on) {
+            i_phase[i] = 0.0f;
+        }
+    }
+    uint16_t adcval_phB = current_to_adcval(i_phase[1], axis.gate_driver.gain_);
+    uint16_t adcval_phC = current_to_adcval(i_phase[2], axis.gate_driver.gain_);
+
+    // The counter direction tells the handlers whether this is a current
+    // measurement (counting up) or a DC calibration (counting down).
+    if (current_meas) {
+        axis.pwm_timer->CR1 &= ~TIM_CR1_DIR;
+    } else {
+        axis.pwm_timer->CR1 |= TIM_CR1_DIR;
+    }
+
+    if (axis.pwm_timer->DIER & TIM_IT_UPDATE) {
+        axis.pwm_timer->SR |= TIM_FLAG_UPDATE;
+        axis.tim_update_irq_handler();
+    }
+
+    if (axis_num == 0) {
+        // TIM1 triggers the injected conversions of all three ADCs
+        ADC1->JDR1 = (uint32_t)lroundf(sim_vbus / VBUS_S_DIVIDER_RATIO * (adc_full_scale / adc_ref_voltage));
+        ADC2->JDR1 = adcval_phB;
+        ADC3->JDR1 = adcval_phC;
+        ADC1->SR |= ADC_SR_JEOC;
+        ADC2->SR |= ADC_SR_JEOC;
+        ADC3->SR |= ADC_SR_JEOC;
+    } else {
+        // TIM8 triggers the regular conversions of ADC2 and ADC3
+        ADC2->DR = adcval_phB;
+        ADC3->DR = adcval_phC;
+        ADC2->SR |= ADC_SR_EOC;
+        ADC3->SR |= ADC_SR_EOC;
+    }
+    ADC_IRQHandler();
+    ADC1->SR &= ~ADC_SR_JEOC;
+    ADC2->SR &= ~(ADC_SR_JEOC | ADC_SR_EOC);
+    ADC3->SR &= ~(ADC_SR_JEOC | ADC_SR_EOC);
+}
+
+static void update_general_purpose_adc() {
+    if (!sim_adc1_dma_buffer) {
+        return;
+    }
+    for (size_t i = 0; i < sim_adc1_dma_length; ++i) {
+        sim_adc1_dma_buffer[i] = 0;
+    }
+    // FET thermistors of M0 and M1
+    for (size_t channel : {15, 4}) {
+        if (channel < sim_adc1_dma_length) {
+            sim_adc1_dma_buffer[channel] = fet_thermistor_adcval;
+        }
+    }
+}
+
+void sim_run() {
+    sim_vbus = getenv_float("ODRIVE_SIM_VBUS", sim_vbus);
+    sim_realtime = getenv_float("ODRIVE_SIM_REALTIME", 1.0f) != 0.0f;
+    sim_encoder_cpr = (int32_t)getenv_float("ODRIVE_SIM_ENCODER_CPR", (float)sim_encoder_cpr);
+    sim_dead_time = getenv_float("ODRIVE_SIM_DEAD_TIME", sim_dead_time);
+    SimPmsm::Config_t motor_config;
+    motor_config.cogging_torque = getenv_float("ODRIVE_SIM_COGGING", motor_config.cogging_torque);
+    motor_config.phase_inductance_q = getenv_float("ODRIVE_SIM_INDUCTANCE_Q", motor_config.phase_inductance_q);
+    motor_config.d_axis_saturation = getenv_float("ODRIVE_SIM_D_SATURATION", motor_config.d_axis_saturation);
+
+    sim_axes.push_back({SimPmsm{motor_config}, TIM1, &TIM1_UP_TIM10_IRQHandler, m0_gate_driver, TIM3, M0_ENC_Z_Pin, &EXTI9_5_IRQHandler, &TIM3_IRQHandler});
+    sim_axes.push_back({SimPmsm{motor_config}, TIM8, &TIM8_UP_TIM13_IRQHandler, m1_gate_driver, TIM4, M1_ENC_Z_Pin, &EXTI15_10_IRQHandler, &TIM4_IRQHandler});
+
+    // Relative time of each event in the control period [timer clocks]
+    const uint64_t clocks_per_period = 2ULL * pwm_period_clocks * (pwm_rcr + 1);
+    struct Event { uint64_t clocks; size_t axis_num; bool current_meas; };
+    const Event events[] = {
+        {0, 0, true},
+        {pwm_period_clocks, 1, true},
+        {clocks_per_period / 2, 0, false},
+        {clocks_per_period / 2 + pwm_period_clocks, 1, false},
+    };
+
+    auto clocks_to_ns = [](uint64_t clocks) {
+        return clocks * 1000000000ULL / (uint64_t)TIM_1_8_CLOCK_HZ;
+    };
+
+    auto wall_clock_start = std::chrono::steady_clock::now();
+    uint64_t clocks = 0;
+    uint64_t last_ms = 0;
+    sim_wait_until_idle();
+
+    for (;;) {
+        for (size_t i = 0; i < sizeof(events) / sizeof(events[0]); ++i) {
+            sim_set_cycle_count(clocks);
+            pwm_event(events[i].axis_num, events[i].current_meas);
+            sim_wait_until_idle();
+
+            uint64_t next = (i + 1 < sizeof(events) / sizeof(events[0])) ? events[i + 1].clocks : clocks_per_period;
+            uint64_t delta_clocks = next - events[i].clocks;
+            uint64_t delta_ns = clocks_to_ns(clocks + delta_clocks) - clocks_to_ns(clocks);
+            integrate((float)delta_clocks / (float)TIM_1_8_CLOCK_HZ, clocks);
+            clocks += delta_clocks;
+            sim_set_cycle_count(clocks);
+
+            TIM_TIME_BASE->CNT = (uint32_t)((clocks_to_ns(clocks) / 1000ULL) % 1000ULL);
+            sim_advance_time(delta_ns);
+            dispatch_async_irqs(clocks);
+            sim_tcp_poll();
+            sim_wait_until_idle();
+        }
+
+        uint64_t now_ms = clocks_to_ns(clocks) / 1000000ULL;
+        if (now_ms != last_ms) {
+            last_ms = now_ms;
+            update_general_purpose_adc();
+            vApplicationIdleHook();
+        }
+
+        if (sim_realtime) {
+            std::this_thread::sleep_until(wall_clock_start + std::chrono::nanoseconds(clocks_to_ns(clocks)));
+        }
+    }
+}
+
+void sim_reset() {
+    // Re-run the same executable with the same arguments. This retains the
+    // NVM file, just like a reboot of the real hardware retains the flash.
+    fflush(stdout);
+    std::vector<std::string> args;
+    FILE* cmdline = fopen("/proc/self/cmdline", "rb");
+    if (cmdline) {
+        std::string arg;
+        int c;
+        while ((c = fgetc(cmdline)) != EOF) {
+            if (c == '\0') {
+                args.push_back(arg);
+                arg.clear();
+            } else {
+                arg += (char)c;
+            }
+        }
+        fclose(cmdline);
+    }
+
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    // Resolve the link so that the new process keeps its name
+    char path[4096];
+    ssize_t path_len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (path_len < 0) {
+        path_len = 0;
+    }
+    path[path_len] = '\0';
+
+    // Don't leak the TCP sockets into the new process image
+    for (int fd = 3; fd < 1024; ++fd) {
+        close(fd);
+    }
+    execv(path, argv.data());
+
+    // If that fails, the best we can do is to exit
+    perror("reboot failed");
+    exit(1);
+}
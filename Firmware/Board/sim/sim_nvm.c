@@ -0,0 +1,150 @@
+/*
+* @brief File backed implementation of the NVM API in stm32_nvm.h.
+*
+* The most recent committed block is stored as a plain file. A commit writes
+* the staging area to a temporary file and renames it over the old one, so
+* that the previous data stays valid until the commit succeeded, just like
+* the two flash sectors on the real hardware.
+*
+* The file path is taken from the environment variable ODRIVE_SIM_NVM_FILE
+* (default: odrive_sim_nvm.bin in the working directory).
+*/
+
+#include <Drivers/STM32/stm32_nvm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same usable size as the two 128kB flash sectors on the real hardware
+#define NVM_SIZE    0x20000
+
+static uint8_t data_[NVM_SIZE];
+static size_t n_valid_ = 0; // number of bytes that can be read
+
+static uint8_t staging_area_[NVM_SIZE];
+static size_t n_staging_area_ = 0; // number of bytes that were reserved using NVM_start_write
+
+static const char* get_path(void) {
+    const char* path = getenv("ODRIVE_SIM_NVM_FILE");
+    return path ? path : "odrive_sim_nvm.bin";
+}
+
+// @brief Loads the most recently committed block from the backing file.
+// A missing file is treated like erased flash.
+// @returns 0 on success or a non-zero error code otherwise
+int NVM_init(void) {
+    n_valid_ = 0;
+    n_staging_area_ = 0;
+
+    FILE* file = fopen(get_path(), "rb");
+    if (!file)
+        return 0;
+    n_valid_ = fread(data_, 1, sizeof(data_), file);
+    int status = ferror(file) ? -1 : 0;
+    fclose(file);
+    return status;
+}
+
+// @brief Erases all data in the NVM.
+// @returns 0 on success or a non-zero error code otherwise
+int NVM_erase(void) {
+    n_valid_ = 0;
+    n_staging_area_ = 0;
+    if (remove(get_path()) != 0) {
+        FILE* file = fopen(get_path(), "rb");
+        if (file) {
+            fclose(file);
+            return -1; // file exists but can't be removed
+        }
+    }
+    return 0;
+}
+
+// @brief Returns the maximum number of bytes that can be read using NVM_read.
+// This holds until NVM_commit is called.
+size_t NVM_get_max_read_length(void) {
+    return n_valid_;
+}
+
+// @brief Returns the maximum length (in bytes) that can passed to NVM_start_write.
+// This holds until NVM_commit is called.
+size_t NVM_get_max_write_length(void) {
+    return NVM_SIZE;
+}
+
+// @brief Reads from the latest committed block in the non-volatile memory.
+// The function either succeeds or leaves the provided buffer unmodified.
+// @param offset: offset in bytes (0 meaning the beginning of the valid area)
+// @param data: buffer to write to
+// @param length: length in bytes (if (offset + length) is out of range, the function fails)
+// @returns 0 on success or a non-zero error code otherwise
+int NVM_read(size_t offset, uint8_t *data, size_t length) {
+    if (offset + length > n_valid_)
+        return -1;
+    memcpy(data, &data_[offset], length);
+    return 0;
+}
+
+// @brief Starts an atomic write operation.
+//
+// The most recent valid NVM data is not modified or invalidated until NVM_commit is called.
+// The length must be at most equal to the size indicated by NVM_get_max_write_length().
+//
+// @param length: Length of the staging block that should be created
+int NVM_start_write(size_t length) {
+    length = (length + 7) & ~(size_t)7; // round to multiple of 64 bit
+    if (length > NVM_SIZE)
+        return -1;
+    memset(staging_area_, 0xff, length); // erased flash reads as 0xff
+    n_staging_area_ = length;
+    return 0;
+}
+
+// @brief Writes to the current data block that was opened with NVM_start_write.
+//
+// The operation fails if (offset + length) is larger than the length passed to NVM_start_write.
+// The most recent valid NVM data is not modified or invalidated until NVM_commit is called.
+//
+// @param offset: offset in bytes (0 meaning the beginning of the data block)
+// @param data: buffer to read from
+// @param length: length in bytes (if (offset + length) is out of range, the function fails)
+int NVM_write(size_t offset, uint8_t *data, size_t length) {
+    if (offset + length > n_staging_area_)
+        return -1;
+    memcpy(&staging_area_[offset], data, length);
+    return 0;
+}
+
+// @brief Commits the new data to NVM atomically.
+int NVM_commit(void) {
+    char tmp_path[1024];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", get_path()) >= (int)sizeof(tmp_path))
+        return -1;
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file)
+        return -1;
+    size_t written = fwrite(staging_area_, 1, n_staging_area_, file);
+    if (fclose(file) != 0 || written != n_staging_area_) {
+        remove(tmp_path);
+        return -1;
+    }
+    if (rename(tmp_path, get_path()) != 0)
+        return -1;
+
+    memcpy(data_, staging_area_, n_staging_area_);
+    n_valid_ = n_staging_area_;
+    n_staging_area_ = 0;
+    return 0;
+}
+
+// @brief Prints the content of the NVM (see stm32_nvm.c for the real test)
+void NVM_demo(void) {
+    printf("=== NVM TEST ===\r\n");
+    if (NVM_init() != 0) {
+        printf("NVM init failed\r\n");
+        return;
+    }
+    printf("NVM contains %u valid bytes at %s\r\n", (unsigned int)n_valid_, get_path());
+}
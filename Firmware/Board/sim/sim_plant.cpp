@@ -0,0 +1,97 @@
+#include "sim_plant.hpp"
+
+#include <math.h>
+
+static constexpr double one_by_sqrt3 = 0.57735026918962576451;
+static constexpr double sqrt3_by_2 = 0.86602540378443864676;
+
+double SimPmsm::flux_linkage() const {
+    // Same relation as in MotorSim.py: kt = 8.27/Kv and
+    // torque = 3/2 * pole_pairs * lambda_m * Iq
+    double torque_constant = 8.27 / (double)config_.kv;
+    return 2.0 * torque_constant / (3.0 * (double)config_.pole_pairs);
+}
+
+double SimPmsm::elec_angle(double pos) const {
+    return (double)config_.pole_pairs * pos + (double)config_.phase_offset;
+}
+
+SimPmsm::State SimPmsm::derivative(const State& x, double v_alpha, double v_beta) const {
+    double R = config_.phase_resistance;
+    double L_d = config_.phase_inductance_d;
+    double L_q = config_.phase_inductance_q;
+    double pp = config_.pole_pairs;
+    double lambda_m = flux_linkage();
+    double J = config_.inertia;
+    double load_torque = config_.load_torque;
+    double coulomb_friction = config_.coulomb_friction;
+    double viscous_friction = config_.viscous_friction;
+
+    double theta = elec_angle(x.pos);
+    double c = cos(theta);
+    double s = sin(theta);
+    double v_d = c * v_alpha + s * v_beta;
+    double v_q = c * v_beta - s * v_alpha;
+    double omega_e = pp * x.vel;
+
+    // The incremental d-axis inductance drops when i_d adds to the magnet flux
+    double L_d_inc = L_d * exp(-(double)config_.d_axis_saturation * x.i_d);
+
+    double torque = 1.5 * pp * (lambda_m * x.i_q + (L_d - L_q) * x.i_d * x.i_q) - load_torque;
+    torque -= (double)config_.cogging_torque * sin(config_.cogging_order * x.pos);
+
+    // Coulomb friction is smoothed around zero speed to keep the ODE
+    // non-stiff. Below 10mrad/s it behaves like a strong viscous damper.
+    double friction_vel_band = 0.01;
+    double coulomb_factor = x.vel / friction_vel_band;
+    if (coulomb_factor > 1.0) coulomb_factor = 1.0;
+    if (coulomb_factor < -1.0) coulomb_factor = -1.0;
+    double friction = coulomb_friction * coulomb_factor + viscous_friction * x.vel;
+
+    return {
+        x.vel,
+        (torque - friction) / J,
+        (v_d - R * x.i_d + omega_e * L_q * x.i_q) / L_d_inc,
+        (v_q - R * x.i_q - omega_e * L_d * x.i_d - omega_e * lambda_m) / L_q
+    };
+}
+
+void SimPmsm::step(float dt, const float v_phase[3], bool floating) {
+    double h = dt;
+    // Only the differential mode voltage reaches the windings (floating star point)
+    double v_alpha = (2.0 * (double)v_phase[0] - (double)v_phase[1] - (double)v_phase[2]) / 3.0;
+    double v_beta = one_by_sqrt3 * ((double)v_phase[1] - (double)v_phase[2]);
+
+    State x = {pos_, vel_, floating ? 0.0 : i_d_, floating ? 0.0 : i_q_};
+
+    auto add = [](const State& a, const State& b, double h) {
+        return State{a.pos + h * b.pos, a.vel + h * b.vel, a.i_d + h * b.i_d, a.i_q + h * b.i_q};
+    };
+
+    State k1 = derivative(x, v_alpha, v_beta);
+    State k2 = derivative(add(x, k1, h / 2), v_alpha, v_beta);
+    State k3 = derivative(add(x, k2, h / 2), v_alpha, v_beta);
+    State k4 = derivative(add(x, k3, h), v_alpha, v_beta);
+
+    pos_ = x.pos + h / 6 * (k1.pos + 2 * k2.pos + 2 * k3.pos + k4.pos);
+    vel_ = x.vel + h / 6 * (k1.vel + 2 * k2.vel + 2 * k3.vel + k4.vel);
+    i_d_ = floating ? 0.0 : x.i_d + h / 6 * (k1.i_d + 2 * k2.i_d + 2 * k3.i_d + k4.i_d);
+    i_q_ = floating ? 0.0 : x.i_q + h / 6 * (k1.i_q + 2 * k2.i_q + 2 * k3.i_q + k4.i_q);
+}
+
+void SimPmsm::get_phase_currents(float i_phase[3]) const {
+    double theta = elec_angle(pos_);
+    double c = cos(theta);
+    double s = sin(theta);
+    double i_alpha = c * i_d_ - s * i_q_;
+    double i_beta = s * i_d_ + c * i_q_;
+    i_phase[0] = (float)i_alpha;
+    i_phase[1] = (float)(-0.5 * i_alpha + sqrt3_by_2 * i_beta);
+    i_phase[2] = (float)(-0.5 * i_alpha - sqrt3_by_2 * i_beta);
+}
+
+float SimPmsm::get_torque() const {
+    double L_d = config_.phase_inductance_d;
+    double L_q = config_.phase_inductance_q;
+    return (float)(1.5 * (double)config_.pole_pairs * (flux_linkage() * i_q_ + (L_d - L_q) * i_d_ * i_q_));
+}
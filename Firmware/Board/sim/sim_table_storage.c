@@ -0,0 +1,84 @@
+/*
+* @brief File backed implementation of the table storage API in
+* stm32_table_storage.h.
+*
+* The tables are held in memory and written to a file after every change.
+* Like flash memory, writing can only clear bits. Setting them requires
+* erasing the whole table.
+*
+* The file path is taken from the environment variable ODRIVE_SIM_TABLE_FILE
+* (default: odrive_sim_tables.bin in the working directory).
+*/
+
+#include <Drivers/STM32/stm32_table_storage.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same layout as on the real hardware: two tables of 16kB
+#define N_TABLES    2
+#define TABLE_SIZE  0x4000
+
+static uint8_t tables_[N_TABLES][TABLE_SIZE];
+static int loaded_ = 0;
+
+static const char* get_path(void) {
+    const char* path = getenv("ODRIVE_SIM_TABLE_FILE");
+    return path ? path : "odrive_sim_tables.bin";
+}
+
+// A missing or short file is treated like erased flash
+static void load(void) {
+    if (loaded_)
+        return;
+    loaded_ = 1;
+    memset(tables_, 0xff, sizeof(tables_));
+    FILE* file = fopen(get_path(), "rb");
+    if (file) {
+        size_t n_read = fread(tables_, 1, sizeof(tables_), file);
+        (void)n_read;
+        fclose(file);
+    }
+}
+
+static int save(void) {
+    FILE* file = fopen(get_path(), "wb");
+    if (!file)
+        return -1;
+    size_t written = fwrite(tables_, 1, sizeof(tables_), file);
+    if (fclose(file) != 0 || written != sizeof(tables_))
+        return -1;
+    return 0;
+}
+
+size_t TABLE_STORAGE_get_count(void) {
+    return N_TABLES;
+}
+
+const uint8_t* TABLE_STORAGE_get(size_t table, size_t* size) {
+    if (table >= N_TABLES)
+        return NULL;
+    load();
+    if (size)
+        *size = TABLE_SIZE;
+    return tables_[table];
+}
+
+int TABLE_STORAGE_erase(size_t table) {
+    if (table >= N_TABLES)
+        return -1;
+    load();
+    memset(tables_[table], 0xff, TABLE_SIZE);
+    return save();
+}
+
+int TABLE_STORAGE_write(size_t table, size_t offset, const uint8_t *data, size_t length) {
+    if (table >= N_TABLES || (offset & 3) || (length & 3) || offset + length > TABLE_SIZE)
+        return -1;
+    load();
+    for (size_t i = 0; i < length; ++i) {
+        tables_[table][offset + i] &= data[i];
+    }
+    return save();
+}
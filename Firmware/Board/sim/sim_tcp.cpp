@@ -0,0 +1,182 @@
+/*
+* @brief Serves the native protocol on a TCP port. Takes the place of USB on
+* the simulated board.
+*
+* The wire format is the same as in fibre/cpp/posix_tcp.cpp, so odrivetool can
+* connect with "--path tcp:localhost:<port>". Unlike posix_tcp.cpp the packets
+* are not processed on the socket threads. A host thread receives the data and
+* hands it to an RTOS thread, just like the USB interrupt hands data to the
+* USB server thread. This way endpoint operations are sequenced with the
+* control loops like on the real hardware.
+*
+* Only one client is served at a time. Further clients wait in the backlog
+* until the current one disconnects.
+*/
+
+#include "sim.hpp"
+
+#include <cmsis_os.h>
+#include <fibre/protocol.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#define TCP_RX_BUF_LEN 512
+
+osThreadId tcp_thread;
+const uint32_t stack_size_tcp_thread = 4096; // Bytes
+
+// Collects the bytes of all packets that result from one chunk of received
+// data and sends them in one go. Sending header, payload and CRC of each
+// packet separately would make every round trip suffer from Nagle's algorithm.
+class TCPStreamSink : public StreamSink {
+public:
+    TCPStreamSink(int socket_fd) : socket_fd_(socket_fd) {}
+
+    int process_bytes(const uint8_t* buffer, size_t length, size_t* processed_bytes) override {
+        tx_buf_.insert(tx_buf_.end(), buffer, buffer + length);
+        if (processed_bytes)
+            *processed_bytes += length;
+        return 0;
+    }
+
+    size_t get_free_space() override { return SIZE_MAX; }
+
+    void flush() {
+        if (!tx_buf_.empty()) {
+            send(socket_fd_, tx_buf_.data(), tx_buf_.size(), MSG_NOSIGNAL);
+            tx_buf_.clear();
+        }
+    }
+
+private:
+    int socket_fd_;
+    std::vector<uint8_t> tx_buf_;
+};
+
+// Protocol stack of one client connection
+struct TCPConnection {
+    TCPConnection(int socket_fd) : stream_output(socket_fd) {}
+
+    TCPStreamSink stream_output;
+    StreamBasedPacketSink packet_output{stream_output};
+    BidirectionalPacketBasedChannel channel{packet_output};
+    StreamToPacketSegmenter stream_input{channel};
+};
+
+static osSemaphoreId sem_tcp_rx;
+
+// Handover from the socket thread to the TCP server thread. The socket thread
+// only writes these while rx_pending is false.
+static uint8_t rx_buf[TCP_RX_BUF_LEN];
+static size_t rx_len = 0;
+static int rx_socket_fd = -1;
+static uint32_t rx_connection_id = 0;
+static std::atomic<bool> rx_pending{false};
+static std::atomic<bool> rx_signalled{false};
+
+static void tcp_server_thread(void * ctx) {
+    (void) ctx;
+    std::optional<TCPConnection> connection;
+    uint32_t connection_id = 0;
+
+    for (;;) {
+        if (osSemaphoreWait(sem_tcp_rx, osWaitForever) != osOK || !rx_pending) {
+            continue;
+        }
+
+        if (!connection || rx_connection_id != connection_id) {
+            // New client: start over with a fresh protocol stack
+            connection_id = rx_connection_id;
+            connection.emplace(rx_socket_fd);
+        }
+        connection->stream_input.process_bytes(rx_buf, rx_len, nullptr);
+        connection->stream_output.flush();
+
+        rx_signalled = false;
+        rx_pending = false;
+    }
+}
+
+static void tcp_socket_thread(unsigned int port) {
+    int server_fd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    if (server_fd == -1) {
+        perror("TCP server: socket");
+        return;
+    }
+
+    int reuse = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in6 addr = {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(port);
+    addr.sin6_addr = in6addr_any;
+    if (bind(server_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+        perror("TCP server: bind");
+        close(server_fd);
+        return;
+    }
+    listen(server_fd, 8);
+
+    for (uint32_t connection_id = 1; ; ++connection_id) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd == -1) {
+            continue;
+        }
+        int nodelay = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        uint8_t buf[TCP_RX_BUF_LEN];
+        ssize_t n_received;
+        while ((n_received = recv(client_fd, buf, sizeof(buf), 0)) > 0) {
+            // The client sends packets in pieces too. Don't delay the ACKs
+            // it is waiting for.
+            int quickack = 1;
+            setsockopt(client_fd, IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
+
+            // Wait until the previous chunk was processed
+            while (rx_pending) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            memcpy(rx_buf, buf, (size_t)n_received);
+            rx_len = (size_t)n_received;
+            rx_socket_fd = client_fd;
+            rx_connection_id = connection_id;
+            rx_pending = true;
+        }
+
+        while (rx_pending) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        close(client_fd);
+    }
+}
+
+void sim_tcp_poll() {
+    // The socket thread must not enter the kernel, so it leaves this to the
+    // simulation engine.
+    if (rx_pending && !rx_signalled) {
+        rx_signalled = true;
+        osSemaphoreRelease(sem_tcp_rx);
+    }
+}
+
+void start_tcp_server(unsigned int port) {
+    osSemaphoreDef(sem_tcp_rx);
+    sem_tcp_rx = osSemaphoreCreate(osSemaphore(sem_tcp_rx), 1);
+    osSemaphoreWait(sem_tcp_rx, 0);
+
+    osThreadDef(tcp_server_thread_def, tcp_server_thread, osPriorityNormal, 0, stack_size_tcp_thread / sizeof(StackType_t));
+    tcp_thread = osThreadCreate(osThread(tcp_server_thread_def), NULL);
+
+    std::thread(tcp_socket_thread, port).detach();
+}
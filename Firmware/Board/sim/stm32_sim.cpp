@@ -0,0 +1,310 @@
+/*
+* @brief Peripheral instances and HAL replacement of the simulated board.
+*
+* Registers are plain memory. Everything that the firmware writes stays there
+* for the simulation engine to pick up and everything the engine writes is
+* what the firmware reads back.
+* HAL calls for peripherals without a simulated counterpart succeed without
+* doing anything.
+*/
+
+#include <board.h>
+#include <adc.h>
+#include <can.h>
+#include <i2c.h>
+#include <spi.h>
+#include <tim.h>
+#include <usart.h>
+#include <usbd_cdc_if.h>
+#include <arm_common_tables.h>
+
+#include "sim.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <atomic>
+
+/* Peripherals -----------------------------------------------------------------*/
+
+GPIO_TypeDef sim_gpioa, sim_gpiob, sim_gpioc, sim_gpiod;
+TIM_TypeDef sim_tim1, sim_tim2, sim_tim3, sim_tim4, sim_tim5, sim_tim8, sim_tim13, sim_tim14;
+ADC_TypeDef sim_adc1, sim_adc2, sim_adc3;
+DMA_Stream_TypeDef sim_dma_streams[16];
+EXTI_TypeDef sim_exti;
+SYSCFG_TypeDef sim_syscfg;
+NVIC_Type sim_nvic;
+SPI_TypeDef sim_spi3;
+USART_TypeDef sim_uart4;
+CAN_TypeDef sim_can1;
+I2C_TypeDef sim_i2c1;
+USB_OTG_GlobalTypeDef sim_usb_otg_fs;
+uint32_t sim_uid[3] = {0x0053494d, 0x4f445256, 0x00000001}; // "SIM" "ODRV" 1
+uint8_t sim_otp[528] = {0xff}; // unprogrammed, the hardware version is taken from the build flags
+CoreDebug_Type sim_core_debug;
+static DWT_Type sim_dwt_instance;
+
+TIM_HandleTypeDef htim1 = {TIM1, {}};
+TIM_HandleTypeDef htim2 = {TIM2, {}};
+TIM_HandleTypeDef htim3 = {TIM3, {}};
+TIM_HandleTypeDef htim4 = {TIM4, {}};
+TIM_HandleTypeDef htim5 = {TIM5, {}};
+TIM_HandleTypeDef htim8 = {TIM8, {}};
+TIM_HandleTypeDef htim13 = {TIM13, {}};
+
+ADC_HandleTypeDef hadc1 = {ADC1, {}};
+ADC_HandleTypeDef hadc2 = {ADC2, {}};
+ADC_HandleTypeDef hadc3 = {ADC3, {}};
+
+static DMA_HandleTypeDef hdma_uart4_rx = {DMA1_Stream2};
+
+SPI_HandleTypeDef hspi3 = {SPI3, {}};
+UART_HandleTypeDef huart4 = {UART4, {115200}, &hdma_uart4_rx, HAL_UART_STATE_READY};
+CAN_HandleTypeDef hcan1 = {CAN1, {}};
+I2C_HandleTypeDef hi2c1 = {I2C1, nullptr, 0, HAL_I2C_STATE_RESET, 0};
+
+USBD_HandleTypeDef hUsbDeviceFS;
+PCD_HandleTypeDef hpcd_USB_OTG_FS = {USB_OTG_FS};
+
+uint16_t* sim_adc1_dma_buffer = nullptr;
+size_t sim_adc1_dma_length = 0;
+
+static std::atomic<uint64_t> sim_cycle_count{0};
+
+void sim_set_cycle_count(uint64_t clocks) {
+    sim_cycle_count = clocks;
+}
+
+float32_t sinTable_f32[FAST_MATH_TABLE_SIZE + 1];
+
+static struct SinTableInit {
+    SinTableInit() {
+        for (size_t i = 0; i < FAST_MATH_TABLE_SIZE + 1; ++i) {
+            sinTable_f32[i] = (float32_t)sin(2.0 * (double)M_PI * (double)i / (double)FAST_MATH_TABLE_SIZE);
+        }
+    }
+} sin_table_init;
+
+char _estack; // normally provided by the linker script
+
+extern "C" {
+
+/* Core ------------------------------------------------------------------------*/
+
+// The simulation engine only dispatches interrupts while all threads are
+// blocked, so a thread can never be interrupted. The mask is kept per thread
+// just so that nested critical sections behave as expected.
+static thread_local uint32_t primask = 0;
+
+uint32_t __get_PRIMASK(void) { return primask; }
+void __set_PRIMASK(uint32_t priMask) { primask = priMask; }
+void __disable_irq(void) { primask = 1; }
+void __enable_irq(void) { primask = 0; }
+void __set_MSP(uint32_t topOfMainStack) { (void)topOfMainStack; }
+
+// The simulated time does not advance while the firmware runs, so the
+// cycle counter adds the host's per-thread CPU time since the simulated time
+// last changed. This way time stamps follow the simulated time while the
+// costs of code sections can still be measured. The absolute numbers of the
+// latter depend on the host but relative costs are meaningful.
+DWT_Type* sim_dwt(void) {
+    static thread_local uint64_t base_clocks = UINT64_MAX;
+    static thread_local uint64_t base_ns = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    uint64_t clocks = sim_cycle_count;
+    if (clocks != base_clocks) {
+        base_clocks = clocks;
+        base_ns = ns;
+    }
+    sim_dwt_instance.CYCCNT = (uint32_t)(clocks + (ns - base_ns) * (TIM_1_8_CLOCK_HZ / 1000000) / 1000);
+    return &sim_dwt_instance;
+}
+
+void NVIC_SystemReset(void) {
+    sim_reset();
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type IRQn) {
+    return (IRQn >= 0) ? (NVIC->IP[IRQn] >> 4) : 0;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void)SubPriority;
+    if (IRQn >= 0) {
+        NVIC->IP[IRQn] = (uint8_t)(PreemptPriority << 4);
+    }
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    NVIC->ISER[IRQn >> 5] |= (1UL << (IRQn & 0x1F));
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+    NVIC->ISER[IRQn >> 5] &= ~(1UL << (IRQn & 0x1F));
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(sim_get_time_ns() / 1000000ULL);
+}
+
+void _Error_Handler(const char* file, int line) {
+    fprintf(stderr, "error handler called from %s:%d\n", file, line);
+    abort();
+}
+
+/* GPIO ------------------------------------------------------------------------*/
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init) {
+    for (uint32_t pin = 0; pin < 16; ++pin) {
+        if (!(GPIO_Init->Pin & (1U << pin))) {
+            continue;
+        }
+        GPIOx->MODER = (GPIOx->MODER & ~(GPIO_MODER_MODER0 << (pin * 2U))) | ((GPIO_Init->Mode & 0x3U) << (pin * 2U));
+        GPIOx->PUPDR = (GPIOx->PUPDR & ~(GPIO_PUPDR_PUPDR0 << (pin * 2U))) | (GPIO_Init->Pull << (pin * 2U));
+        // Inputs float to their pull level since nothing is connected
+        if (GPIO_Init->Pull == GPIO_PULLUP) {
+            GPIOx->IDR |= (1U << pin);
+        } else if (GPIO_Init->Pull == GPIO_PULLDOWN) {
+            GPIOx->IDR &= ~(1U << pin);
+        }
+    }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    if (PinState == GPIO_PIN_SET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+}
+
+/* TIM -------------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    (void)Channel;
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    (void)Channel;
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef* htim, uint32_t Channel) {
+    (void)Channel;
+    htim->Instance->CR1 |= TIM_CR1_CEN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef* htim, TIM_IC_InitTypeDef* sConfig, uint32_t Channel) {
+    (void)htim; (void)sConfig; (void)Channel;
+    return HAL_OK;
+}
+
+/* ADC -------------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef* hadc) {
+    hadc->Instance->CR2 |= ADC_CR2_ADON;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* hadc, ADC_ChannelConfTypeDef* sConfig) {
+    (void)hadc; (void)sConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef* hadc, uint32_t* pData, uint32_t Length) {
+    if (hadc != &hadc1) {
+        return HAL_ERROR;
+    }
+    sim_adc1_dma_buffer = reinterpret_cast<uint16_t*>(pData);
+    sim_adc1_dma_length = Length;
+    return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef* hadc) {
+    return hadc->Instance->DR;
+}
+
+uint32_t HAL_ADCEx_InjectedGetValue(ADC_HandleTypeDef* hadc, uint32_t InjectedRank) {
+    switch (InjectedRank) {
+        case 1: return hadc->Instance->JDR1;
+        case 2: return hadc->Instance->JDR2;
+        case 3: return hadc->Instance->JDR3;
+        case 4: return hadc->Instance->JDR4;
+        default: return 0;
+    }
+}
+
+/* SPI -------------------------------------------------------------------------*/
+
+// No SPI devices are simulated. Transfers never complete, which the firmware
+// treats the same way as a disconnected device.
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef* hspi) { (void)hspi; return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef* hspi) { (void)hspi; return HAL_OK; }
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size) { (void)hspi; (void)pData; (void)Size; return HAL_ERROR; }
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pData, uint16_t Size) { (void)hspi; (void)pData; (void)Size; return HAL_ERROR; }
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA(SPI_HandleTypeDef* hspi, uint8_t* pTxData, uint8_t* pRxData, uint16_t Size) { (void)hspi; (void)pTxData; (void)pRxData; (void)Size; return HAL_ERROR; }
+
+/* UART ------------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart) { huart->RxState = HAL_UART_STATE_READY; return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef* huart) { huart->RxState = HAL_UART_STATE_RESET; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    (void)pData; (void)Size;
+    HAL_UART_TxCpltCallback(huart);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size) {
+    (void)pData;
+    huart->hdmarx->Instance->NDTR = Size;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef* huart) {
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+/* CAN -------------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan) { (void)hcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* sFilterConfig) { (void)hcan; (void)sFilterConfig; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan) { (void)hcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan) { (void)hcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs) { (void)hcan; (void)ActiveITs; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs) { (void)hcan; (void)InactiveITs; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef* hcan, CAN_TxHeaderTypeDef* pHeader, uint8_t aData[], uint32_t* pTxMailbox) { (void)hcan; (void)pHeader; (void)aData; (void)pTxMailbox; return HAL_OK; }
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef* hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef* pHeader, uint8_t aData[]) { (void)hcan; (void)RxFifo; (void)pHeader; (void)aData; return HAL_ERROR; }
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef* hcan) { (void)hcan; return HAL_OK; }
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef* hcan) { (void)hcan; return 3; }
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef* hcan, uint32_t RxFifo) { (void)hcan; (void)RxFifo; return 0; }
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef* hcan) { (void)hcan; return HAL_CAN_ERROR_NONE; }
+
+/* I2C -------------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_I2C_EnableListen_IT(I2C_HandleTypeDef* hi2c) { hi2c->State = HAL_I2C_STATE_LISTEN; return HAL_OK; }
+HAL_StatusTypeDef HAL_I2C_Slave_Sequential_Transmit_IT(I2C_HandleTypeDef* hi2c, uint8_t* pData, uint16_t Size, uint32_t XferOptions) { (void)hi2c; (void)pData; (void)Size; (void)XferOptions; return HAL_OK; }
+HAL_StatusTypeDef HAL_I2C_Slave_Sequential_Receive_IT(I2C_HandleTypeDef* hi2c, uint8_t* pData, uint16_t Size, uint32_t XferOptions) { (void)hi2c; (void)pData; (void)Size; (void)XferOptions; return HAL_OK; }
+
+/* USB -------------------------------------------------------------------------*/
+
+// There is no USB device. The fibre protocol is served over TCP instead
+// (see board_init()).
+
+void MX_USB_DEVICE_Init(void) {}
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef* hpcd) { (void)hpcd; }
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef* pdev, uint8_t endpoint_pair) { (void)pdev; (void)endpoint_pair; return USBD_OK; }
+uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len, uint8_t endpoint_pair) { (void)Buf; (void)Len; (void)endpoint_pair; return USBD_OK; }
+
+}
@@ -62,6 +62,19 @@
 
 #define TIM_TIME_BASE TIM14
 
+// PWM and control timing. TIM_1_8_PERIOD_CLOCKS, TIM_1_8_DEADTIME_CLOCKS
+// and TIM_1_8_RCR are only the defaults, the values in use are set from the
+// config at boot (see apply_pwm_config()).
+extern uint32_t pwm_period_clocks; // half of the PWM period [timer clocks]
+extern uint32_t pwm_deadtime_clocks; // [timer clocks]
+extern uint32_t pwm_rcr; // repetition counter, the control loop runs every pwm_rcr + 1 PWM periods
+
+// Period in [s]
+extern float current_meas_period;
+
+// Frequency in [Hz]
+extern float current_meas_hz;
+
 #ifdef __cplusplus
 #include <Drivers/DRV8301/drv8301.hpp>
 #include <Drivers/STM32/stm32_gpio.hpp>
@@ -96,14 +109,6 @@ extern UART_HandleTypeDef* uart2;
 extern PwmInput pwm0_input;
 #endif
 
-// Period in [s]
-#define CURRENT_MEAS_PERIOD ( (float)2*TIM_1_8_PERIOD_CLOCKS*(TIM_1_8_RCR+1) / (float)TIM_1_8_CLOCK_HZ )
-static const float current_meas_period = CURRENT_MEAS_PERIOD;
-
-// Frequency in [Hz]
-#define CURRENT_MEAS_HZ ( (float)(TIM_1_8_CLOCK_HZ) / (float)(2*TIM_1_8_PERIOD_CLOCKS*(TIM_1_8_RCR+1)) )
-static const int current_meas_hz = CURRENT_MEAS_HZ;
-
 #if HW_VERSION_VOLTAGE >= 48
 #define VBUS_S_DIVIDER_RATIO 19.0f
 #elif HW_VERSION_VOLTAGE == 24
@@ -453,7 +453,10 @@ void HAL_TIM_Encoder_MspInit(TIM_HandleTypeDef* tim_encoderHandle)
     __HAL_RCC_TIM3_CLK_ENABLE();
 
   /* USER CODE BEGIN TIM3_MspInit 1 */
-
+    /* TIM3 interrupt Init: captures the encoder edges. Must have the same
+     * priority as the update interrupts of TIM1/TIM8. */
+    HAL_NVIC_SetPriority(TIM3_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
   /* USER CODE END TIM3_MspInit 1 */
   }
   else if(tim_encoderHandle->Instance==TIM4)
@@ -465,7 +468,10 @@ void HAL_TIM_Encoder_MspInit(TIM_HandleTypeDef* tim_encoderHandle)
     __HAL_RCC_TIM4_CLK_ENABLE();
 
   /* USER CODE BEGIN TIM4_MspInit 1 */
-
+    /* TIM4 interrupt Init: captures the encoder edges. Must have the same
+     * priority as the update interrupts of TIM1/TIM8. */
+    HAL_NVIC_SetPriority(TIM4_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
   /* USER CODE END TIM4_MspInit 1 */
   }
 }
@@ -683,7 +689,7 @@ void HAL_TIM_Encoder_MspDeInit(TIM_HandleTypeDef* tim_encoderHandle)
     HAL_GPIO_DeInit(GPIOB, M0_ENC_A_Pin|M0_ENC_B_Pin);
 
   /* USER CODE BEGIN TIM3_MspDeInit 1 */
-
+    HAL_NVIC_DisableIRQ(TIM3_IRQn);
   /* USER CODE END TIM3_MspDeInit 1 */
   }
   else if(tim_encoderHandle->Instance==TIM4)
@@ -701,7 +707,7 @@ void HAL_TIM_Encoder_MspDeInit(TIM_HandleTypeDef* tim_encoderHandle)
     HAL_GPIO_DeInit(GPIOB, M1_ENC_A_Pin|M1_ENC_B_Pin);
 
   /* USER CODE BEGIN TIM4_MspDeInit 1 */
-
+    HAL_NVIC_DisableIRQ(TIM4_IRQn);
   /* USER CODE END TIM4_MspDeInit 1 */
   }
 }
@@ -258,6 +258,11 @@ void system_init() {
 
     // Configure the system clock
     SystemClock_Config();
+
+    // Start the CPU cycle counter (used for profiling)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 bool board_init() {
@@ -277,6 +282,18 @@ bool board_init() {
     MX_TIM5_Init();
     MX_TIM13_Init();
 
+    // CubeMX initializes the PWM timers with the defaults from main.h. The
+    // new values are loaded by the update event in start_synchronously().
+    for (TIM_HandleTypeDef* htim : {&htim1, &htim8}) {
+        htim->Init.Period = pwm_period_clocks;
+        htim->Init.RepetitionCounter = pwm_rcr;
+        htim->Instance->ARR = pwm_period_clocks;
+        htim->Instance->RCR = pwm_rcr;
+        MODIFY_REG(htim->Instance->BDTR, TIM_BDTR_DTG, pwm_deadtime_clocks);
+    }
+    htim13.Init.Period = (2 * pwm_period_clocks * (pwm_rcr + 1)) * ((float)TIM_APB1_CLOCK_HZ / (float)TIM_1_8_CLOCK_HZ) - 1;
+    htim13.Instance->ARR = htim13.Init.Period;
+
     HAL_UART_DeInit(uart0);
     uart0->Init.BaudRate = odrv.config_.uart0_baudrate;
     HAL_UART_Init(uart0);
@@ -328,7 +345,7 @@ bool board_init() {
     */
     Stm32Timer::start_synchronously<3>(
         {&htim1, &htim8, &htim13},
-        {TIM_1_8_PERIOD_CLOCKS / 2 - 1 * 128 /* TODO: explain why this offset */, 0, TIM_1_8_PERIOD_CLOCKS / 2 - 1 * 128}
+        {pwm_period_clocks / 2 - 1 * 128 /* TODO: explain why this offset */, 0, pwm_period_clocks / 2 - 1 * 128}
     );
 
     return true;
@@ -365,6 +382,16 @@ void TIM8_UP_TIM13_IRQHandler(void) {
     motors[1].tim_update_cb();
 }
 
+void TIM3_IRQHandler(void) {
+    COUNT_IRQ(TIM3_IRQn);
+    encoders[0].enc_edge_cb();
+}
+
+void TIM4_IRQHandler(void) {
+    COUNT_IRQ(TIM4_IRQn);
+    encoders[1].enc_edge_cb();
+}
+
 void TIM5_IRQHandler(void) {
     COUNT_IRQ(TIM5_IRQn);
     pwm0_input.on_capture();
@@ -36,6 +36,12 @@ static inline void cpu_exit_critical(uint32_t priority_mask) {
     __set_PRIMASK(priority_mask);
 }
 
+// @brief Returns the current value of the CPU cycle counter.
+// The counter is started in system_init() and wraps around every ~25s.
+static inline uint32_t cpu_get_cycles() {
+    return DWT->CYCCNT;
+}
+
 #ifdef __cplusplus
 }
 #endif
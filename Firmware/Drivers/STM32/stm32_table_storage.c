@@ -0,0 +1,126 @@
+/*
+* Flash-based storage for large lookup tables
+*
+* Each table lives in a dedicated flash sector so that it can be read in place
+* and rewritten without touching the configuration in stm32_nvm.c or any
+* other table. The sectors are excluded from the program memory in the
+* linker script.
+*
+* We use the 16kB sectors 1 and 2, i.e. one table per axis. Sector 0 holds the
+* interrupt vector table, the program starts in sector 3.
+*
+* Erasing a sector stalls the CPU for several hundred milliseconds, so this
+* must only be done while the motors are disarmed.
+*/
+
+#include "stm32_table_storage.h"
+
+#include <string.h>
+
+#if defined(STM32F405xx)
+
+#include <stm32f405xx.h>
+#include <stm32f4xx_hal.h>
+
+typedef struct {
+    const uint32_t sector_id;   //!< HAL ID of this sector
+    const uint8_t* const data;
+    const size_t size;
+} table_sector_t;
+
+static const table_sector_t table_sectors[] = {
+    {FLASH_SECTOR_1, (const uint8_t*)0x8004000UL, 0x4000UL},
+    {FLASH_SECTOR_2, (const uint8_t*)0x8008000UL, 0x4000UL},
+};
+
+#else
+#error "unknown flash sector size"
+#endif
+
+#define N_TABLES (sizeof(table_sectors) / sizeof(table_sectors[0]))
+
+static const uint32_t FLASH_ERR_FLAGS =
+#if defined(FLASH_FLAG_EOP)
+        FLASH_FLAG_EOP |
+#endif
+#if defined(FLASH_FLAG_OPERR)
+        FLASH_FLAG_OPERR |
+#endif
+#if defined(FLASH_FLAG_WRPERR)
+        FLASH_FLAG_WRPERR |
+#endif
+#if defined(FLASH_FLAG_PGAERR)
+        FLASH_FLAG_PGAERR |
+#endif
+#if defined(FLASH_FLAG_PGSERR)
+        FLASH_FLAG_PGSERR |
+#endif
+#if defined(FLASH_FLAG_PGPERR)
+        FLASH_FLAG_PGPERR |
+#endif
+        0;
+
+// @brief Returns the number of available tables.
+size_t TABLE_STORAGE_get_count(void) {
+    return N_TABLES;
+}
+
+// @brief Returns a pointer to the flash memory of the specified table.
+// @param size: Set to the maximum size of the table in bytes
+// @returns NULL if the table does not exist
+const uint8_t* TABLE_STORAGE_get(size_t table, size_t* size) {
+    if (table >= N_TABLES)
+        return NULL;
+    if (size)
+        *size = table_sectors[table].size;
+    return table_sectors[table].data;
+}
+
+// @brief Erases the specified table. This sets all bytes to 0xff.
+// @returns 0 on success or a non-zero error code otherwise
+int TABLE_STORAGE_erase(size_t table) {
+    if (table >= N_TABLES)
+        return -1;
+
+    FLASH_EraseInitTypeDef erase_struct = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+#if defined(FLASH_OPTCR_nDBANK)
+        .Banks = 0, // only used for mass erase
+#endif
+        .Sector = table_sectors[table].sector_id,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3
+    };
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_ERR_FLAGS);
+    uint32_t sector_error;
+    int status = (HAL_FLASHEx_Erase(&erase_struct, &sector_error) != HAL_OK)
+            ? HAL_FLASH_GetError() : 0;
+    HAL_FLASH_Lock();
+    return status;
+}
+
+// @brief Writes to the specified table. The affected area must be erased.
+// @param offset: offset in bytes, must be a multiple of 4
+// @param length: length in bytes, must be a multiple of 4
+// @returns 0 on success or a non-zero error code otherwise
+int TABLE_STORAGE_write(size_t table, size_t offset, const uint8_t *data, size_t length) {
+    if (table >= N_TABLES || (offset & 3) || (length & 3)
+            || offset + length > table_sectors[table].size)
+        return -1;
+
+    uint32_t address = (uint32_t)table_sectors[table].data + offset;
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_ERR_FLAGS);
+    int status = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, address + i, word) != HAL_OK) {
+            status = HAL_FLASH_GetError();
+            break;
+        }
+    }
+    HAL_FLASH_Lock();
+    return status;
+}
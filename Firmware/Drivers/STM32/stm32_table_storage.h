@@ -0,0 +1,28 @@
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TABLE_STORAGE_H
+#define __TABLE_STORAGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Exported variables --------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+size_t TABLE_STORAGE_get_count(void);
+const uint8_t* TABLE_STORAGE_get(size_t table, size_t* size);
+int TABLE_STORAGE_erase(size_t table);
+int TABLE_STORAGE_write(size_t table, size_t offset, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TABLE_STORAGE_H
@@ -0,0 +1,169 @@
+#include "odrive_main.h"
+
+/*
+ * Measures the frequency response and sets pos_gain, vel_gain and
+ * vel_integrator_gain of the controller.
+ *
+ * The measurement runs in velocity control with the gains that are
+ * configured when the state is entered. They must be stable, but can be soft.
+ */
+bool Autotuner::run() {
+    Controller& controller = axis_->controller_;
+    num_points_ = 0;
+    crossover_freq_ = 0.0f;
+    phase_margin_ = 0.0f;
+
+    if (!(config_.start_freq > 0.0f) || !(config_.end_freq > config_.start_freq)
+            || !(config_.end_freq < 0.25f * current_meas_hz)) {
+        return axis_->error_ |= Axis::ERROR_AUTOTUNE_FAILED, false;
+    }
+
+    // The measurement uses the motor encoder, while the velocity loop of
+    // dual loop control runs on the load encoder
+    if (controller.config_.enable_dual_loop)
+        return axis_->error_ |= Axis::ERROR_AUTOTUNE_FAILED, false;
+
+    Controller::ControlMode stored_control_mode = controller.config_.control_mode;
+    Controller::InputMode stored_input_mode = controller.config_.input_mode;
+    controller.config_.control_mode = Controller::CONTROL_MODE_VELOCITY_CONTROL;
+    controller.config_.input_mode = Controller::INPUT_MODE_PASSTHROUGH;
+    controller.input_vel_ = 0.0f;
+    controller.input_torque_ = 0.0f;
+    controller.vel_integrator_torque_ = 0.0f;
+
+    // Logarithmic frequency sweep
+    bool measured = true;
+    for (size_t i = 0; i < NUM_POINTS && measured; ++i) {
+        float freq = config_.start_freq * powf(config_.end_freq / config_.start_freq, (float)i / (float)(NUM_POINTS - 1));
+        measured = measure_point(freq, &response_[i]);
+        if (measured) {
+            // Unwrap the phase relative to the previous point
+            float prev_phase = i ? response_[i - 1].phase : 0.0f;
+            while (response_[i].phase - prev_phase > 180.0f)
+                response_[i].phase -= 360.0f;
+            while (response_[i].phase - prev_phase <= -180.0f)
+                response_[i].phase += 360.0f;
+            num_points_ = i + 1;
+        }
+    }
+
+    controller.config_.control_mode = stored_control_mode;
+    controller.config_.input_mode = stored_input_mode;
+    if (!measured)
+        return axis_->check_for_errors(); // aborted
+
+    // Phase lag of the PI controller at the crossover frequency
+    const float integrator_lag = atanf(1.0f / CROSSOVER_RATIO) * (180.0f / M_PI);
+
+    // Use the highest crossover frequency up to the desired bandwidth that
+    // still has enough phase margin
+    float target_freq = std::min(config_.bandwidth, response_[num_points_ - 1].freq);
+    float gain = 0.0f;
+    float phase = 0.0f;
+    for (int i = num_points_; i >= 0; --i) {
+        float freq = (i == (int)num_points_) ? target_freq : response_[i].freq;
+        if (freq > target_freq || !interpolate(freq, &gain, &phase))
+            continue;
+        if (180.0f + phase - integrator_lag >= config_.phase_margin) {
+            crossover_freq_ = freq;
+            phase_margin_ = 180.0f + phase - integrator_lag;
+            break;
+        }
+    }
+    if (crossover_freq_ <= 0.0f || !(gain > 0.0f)) {
+        return axis_->error_ |= Axis::ERROR_AUTOTUNE_FAILED, false;
+    }
+
+    // Unity loop gain at the crossover frequency
+    float omega = 2.0f * M_PI * crossover_freq_;
+    float vel_gain = 1.0f / (gain * sqrtf(1.0f + 1.0f / (CROSSOVER_RATIO * CROSSOVER_RATIO)));
+    controller.config_.vel_gain = vel_gain;
+    controller.config_.vel_integrator_gain = vel_gain * omega / CROSSOVER_RATIO;
+    controller.config_.pos_gain = omega / CROSSOVER_RATIO;
+
+    return axis_->check_for_errors();
+}
+
+/*
+ * Excites the axis at the specified frequency [Hz] and correlates the applied
+ * torque and the velocity estimate with the excitation.
+ *
+ * The frequency is adjusted slightly so that the measurement covers an
+ * integer number of periods.
+ *
+ * Returns false if the state was aborted or an error occurred.
+ */
+bool Autotuner::measure_point(float freq, ResponsePoint_t* point) {
+    Encoder& encoder = axis_->encoder_;
+    Motor& motor = axis_->motor_;
+
+    // At least 4 periods and 0.2s, after 2 periods and 0.05s of settling
+    uint32_t n_periods = std::max(4, (int)ceilf(0.2f * freq));
+    uint32_t n_measure = (uint32_t)roundf((float)n_periods * current_meas_hz / freq);
+    uint32_t n_settle = (uint32_t)(std::max(2.0f / freq, 0.05f) * current_meas_hz);
+    float phase_step = 2.0f * M_PI * (float)n_periods / (float)n_measure;
+
+    float torque_re = 0.0f;
+    float torque_im = 0.0f;
+    float vel_re = 0.0f;
+    float vel_im = 0.0f;
+    float phase = 0.0f;
+    uint32_t i = 0;
+
+    axis_->run_control_loop([&]() {
+        float torque_setpoint;
+        if (!axis_->update_controller(&torque_setpoint))
+            return axis_->error_ |= Axis::ERROR_CONTROLLER_FAILED, false;
+
+        float c = our_arm_cos_f32(phase);
+        float s = our_arm_sin_f32(phase);
+        float torque = torque_setpoint + config_.excitation_torque * s;
+        if (i >= n_settle) {
+            torque_re += torque * c;
+            torque_im -= torque * s;
+            vel_re += encoder.vel_estimate_ * c;
+            vel_im -= encoder.vel_estimate_ * s;
+        }
+        phase = wrap_pm_pi(phase + phase_step);
+
+        float phase_vel = (2*M_PI) * encoder.vel_estimate_ * motor.config_.pole_pairs;
+        if (!motor.update(torque, encoder.phase_, phase_vel))
+            return false; // set_error should update axis.error_
+
+        return ++i < n_settle + n_measure;
+    });
+    if (i < n_settle + n_measure)
+        return false;
+
+    float torque_mag = sqrtf(torque_re * torque_re + torque_im * torque_im);
+    if (!(torque_mag > 0.0f)) {
+        axis_->error_ |= Axis::ERROR_AUTOTUNE_FAILED;
+        return false;
+    }
+    point->freq = (float)n_periods * current_meas_hz / (float)n_measure;
+    point->gain = sqrtf(vel_re * vel_re + vel_im * vel_im) / torque_mag;
+    point->phase = (atan2f(vel_im, vel_re) - atan2f(torque_im, torque_re)) * (180.0f / M_PI);
+    return true;
+}
+
+// @brief Interpolates the measured response at the specified frequency [Hz].
+// Gain and frequency are interpolated logarithmically.
+// @returns false if the frequency is outside of the measured range
+bool Autotuner::interpolate(float freq, float* gain, float* phase) {
+    for (size_t i = 0; i < num_points_; ++i) {
+        const ResponsePoint_t& hi = response_[i];
+        if (freq > hi.freq)
+            continue;
+        if (freq == hi.freq || i == 0) {
+            *gain = hi.gain;
+            *phase = hi.phase;
+            return freq == hi.freq;
+        }
+        const ResponsePoint_t& lo = response_[i - 1];
+        float frac = logf(freq / lo.freq) / logf(hi.freq / lo.freq);
+        *gain = lo.gain * powf(hi.gain / lo.gain, frac);
+        *phase = lo.phase + frac * (hi.phase - lo.phase);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+#ifndef __AUTOTUNER_HPP
+#define __AUTOTUNER_HPP
+
+#include <autogen/interfaces.hpp>
+
+/**
+ * @brief Measures the frequency response of the velocity loop plant and
+ * derives the controller gains from it (AXIS_STATE_AUTOTUNING).
+ *
+ * The axis is held at zero velocity by the controller while a sinusoidal
+ * torque is added to its output, stepping through NUM_POINTS logarithmically
+ * spaced frequencies. At each frequency the applied torque and the velocity
+ * estimate are correlated with the excitation over an integer number of
+ * periods (a single bin DFT). Their ratio is the response of everything
+ * between the torque setpoint and the velocity estimate, including the
+ * current controller and the encoder estimator.
+ *
+ * The crossover frequency of the velocity loop is placed at config.bandwidth,
+ * or lower if the phase margin there would be below config.phase_margin.
+ * The integrator corner and the position loop bandwidth are placed a factor
+ * of CROSSOVER_RATIO below the crossover.
+ */
+class Autotuner : public ODriveIntf::AutotunerIntf {
+public:
+    static constexpr size_t NUM_POINTS = 16;
+    static constexpr float CROSSOVER_RATIO = 4.0f;
+
+    struct Config_t {
+        float excitation_torque = 0.02f;  // [Nm]
+        float start_freq = 5.0f;          // [Hz]
+        float end_freq = 200.0f;          // [Hz]
+        float bandwidth = 20.0f;          // [Hz] desired velocity loop crossover
+        float phase_margin = 50.0f;       // [deg] minimum phase margin
+    };
+
+    // Frequency response from torque setpoint to velocity estimate
+    struct ResponsePoint_t {
+        float freq = 0.0f;   // [Hz]
+        float gain = 0.0f;   // [(turn/s)/Nm]
+        float phase = 0.0f;  // [deg]
+    };
+
+    bool run();
+
+    float get_response_freq(uint32_t index) override {
+        return index < num_points_ ? response_[index].freq : 0.0f;
+    }
+    float get_response_gain(uint32_t index) override {
+        return index < num_points_ ? response_[index].gain : 0.0f;
+    }
+    float get_response_phase(uint32_t index) override {
+        return index < num_points_ ? response_[index].phase : 0.0f;
+    }
+
+    Config_t config_;
+    Axis* axis_ = nullptr;
+
+    uint32_t num_points_ = 0;
+    float crossover_freq_ = 0.0f; // [Hz]
+    float phase_margin_ = 0.0f;   // [deg]
+
+private:
+    bool measure_point(float freq, ResponsePoint_t* point);
+    bool interpolate(float freq, float* gain, float* phase);
+
+    ResponsePoint_t response_[NUM_POINTS];
+};
+
+#endif // __AUTOTUNER_HPP
@@ -52,6 +52,7 @@ Axis::Axis(int axis_num,
     min_endstop_.axis_ = this;
     max_endstop_.axis_ = this;
     mechanical_brake_.axis_ = this;
+    autotuner_.axis_ = this;
 }
 
 Axis::LockinConfig_t Axis::default_calibration() {
@@ -90,6 +91,8 @@ bool Axis::apply_config() {
     config_.parent = this;
     decode_step_dir_pins();
     watchdog_feed();
+    checks_divider_ = std::max(1, (int)roundf(current_meas_hz / CHECKS_RATE));
+    thermal_divider_ = std::max(1, (int)roundf(current_meas_hz / THERMAL_RATE));
     return true;
 }
 
@@ -100,9 +103,17 @@ void Axis::clear_config() {
     config_.can_node_id = axis_num_;
 }
 
-// @brief Does Nothing
+// @brief Loads data that is not part of the configuration
 bool Axis::setup() {
-    // Does nothing - Motor and encoder setup called separately.
+    // Motor and encoder setup called separately.
+    controller_.load_anticogging_map();
+    // Estimates for states that run the controller without selecting an
+    // encoder first, such as autotuning. Closed loop control selects the
+    // encoder again when it starts. Dual loop control is not autotuned, so an
+    // invalid dual loop configuration only fails when closed loop starts.
+    if (controller_.config_.load_encoder_axis < AXIS_COUNT
+            && !controller_.config_.enable_dual_loop)
+        controller_.select_encoder(controller_.config_.load_encoder_axis);
     return true;
 }
 
@@ -168,6 +179,8 @@ void Axis::set_step_dir_active(bool active) {
 // @brief Do axis level checks and call subcomponent do_checks
 // Returns true if everything is ok.
 bool Axis::do_checks() {
+    CycleProfiler::Measurement measurement(profiler_.do_checks_);
+
     if (!brake_resistor_armed)
         error_ |= ERROR_BRAKE_RESISTOR_DISARMED;
     if ((current_state_ != AXIS_STATE_IDLE) && (motor_.armed_state_ == Motor::ARMED_STATE_DISARMED))
@@ -179,9 +192,13 @@ bool Axis::do_checks() {
         error_ |= ERROR_DC_BUS_OVER_VOLTAGE;
 
     // Sub-components should use set_error which will propegate to this error_
-    motor_.effective_current_lim();
-    for (ThermistorCurrentLimiter* thermistor : thermistors_) {
-        thermistor->do_checks();
+    if (is_due(checks_divider_)) {
+        motor_.effective_current_lim();
+    }
+    if (is_due(thermal_divider_)) {
+        for (ThermistorCurrentLimiter* thermistor : thermistors_) {
+            thermistor->do_checks();
+        }
     }
     motor_.do_checks();
     // encoder_.do_checks();
@@ -200,19 +217,38 @@ bool Axis::do_checks() {
 
 // @brief Update all esitmators
 bool Axis::do_updates() {
+    CycleProfiler::Measurement measurement(profiler_.do_updates_);
+
     // Sub-components should use set_error which will propegate to this error_
-    for (ThermistorCurrentLimiter* thermistor : thermistors_) {
-        thermistor->update();
+    if (is_due(thermal_divider_)) {
+        for (ThermistorCurrentLimiter* thermistor : thermistors_) {
+            thermistor->update();
+        }
     }
     encoder_.update();
     sensorless_estimator_.update();
-    min_endstop_.update();
-    max_endstop_.update();
+    if (is_due(checks_divider_)) {
+        min_endstop_.update();
+        max_endstop_.update();
+    }
     bool ret = check_for_errors();
-    odCAN->send_heartbeat(this);
+    if (is_due(checks_divider_)) {
+        odCAN->send_heartbeat(this);
+    }
     return ret;
 }
 
+// @brief Runs the controller if it is due in the current iteration of the
+// control loop. Otherwise returns the torque setpoint of its last update.
+bool Axis::update_controller(float* torque_setpoint) {
+    if (is_due(controller_.config_.update_divider)) {
+        if (!controller_.update(&controller_torque_setpoint_))
+            return false;
+    }
+    *torque_setpoint = controller_torque_setpoint_;
+    return true;
+}
+
 // @brief Feed the watchdog to prevent watchdog timeouts.
 void Axis::watchdog_feed() {
     watchdog_current_value_ = get_watchdog_reset();
@@ -298,6 +334,7 @@ bool Axis::run_lockin_spin(const LockinConfig_t &lockin_config) {
 // Note run_sensorless_control_loop and run_closed_loop_control_loop are very similar and differ only in where we get the estimate from.
 bool Axis::run_sensorless_control_loop() {
     controller_.pos_estimate_linear_src_ = nullptr;
+    controller_.pos_estimate_encoder_ = nullptr;
     controller_.pos_estimate_circular_src_ = nullptr;
     controller_.pos_estimate_valid_src_ = nullptr;
     controller_.vel_estimate_src_ = &sensorless_estimator_.vel_estimate_;
@@ -306,7 +343,7 @@ bool Axis::run_sensorless_control_loop() {
     run_control_loop([this](){
         // Note that all estimators are updated in the loop prefix in run_control_loop
         float torque_setpoint;
-        if (!controller_.update(&torque_setpoint))
+        if (!update_controller(&torque_setpoint))
             return error_ |= ERROR_CONTROLLER_FAILED, false;
         if (!motor_.update(torque_setpoint, sensorless_estimator_.phase_, sensorless_estimator_.vel_estimate_))
             return false; // set_error should update axis.error_
@@ -348,7 +385,7 @@ bool Axis::run_closed_loop_control_loop() {
     run_control_loop([this](){
         // Note that all estimators are updated in the loop prefix in run_control_loop
         float torque_setpoint;
-        if (!controller_.update(&torque_setpoint))
+        if (!update_controller(&torque_setpoint))
             return error_ |= ERROR_CONTROLLER_FAILED, false;
 
         float phase_vel = (2*M_PI) * encoder_.vel_estimate_ * motor_.config_.pole_pairs;
@@ -413,7 +450,7 @@ bool Axis::run_homing() {
     run_control_loop([this](){
         // Note that all estimators are updated in the loop prefix in run_control_loop
         float torque_setpoint;
-        if (!controller_.update(&torque_setpoint))
+        if (!update_controller(&torque_setpoint))
             return error_ |= ERROR_CONTROLLER_FAILED, false;
 
         float phase_vel = (2*M_PI) * encoder_.vel_estimate_ * motor_.config_.pole_pairs;
@@ -442,7 +479,7 @@ bool Axis::run_homing() {
     run_control_loop([this](){
         // Note that all estimators are updated in the loop prefix in run_control_loop
         float torque_setpoint;
-        if (!controller_.update(&torque_setpoint))
+        if (!update_controller(&torque_setpoint))
             return error_ |= ERROR_CONTROLLER_FAILED, false;
 
         float phase_vel = (2*M_PI) * encoder_.vel_estimate_ * motor_.config_.pole_pairs;
@@ -459,6 +496,114 @@ bool Axis::run_homing() {
     return check_for_errors();
 }
 
+/*
+ * Identifies the mechanical load by applying a torque of +-inertia_id.torque,
+ * which is reversed whenever the velocity reaches +-inertia_id.vel.
+ *
+ * The load is modeled as
+ *   torque = inertia * accel + viscous_damping * vel + coulomb_friction * sign(vel)
+ * Integrating this over short windows avoids differentiating the velocity
+ * estimate. The parameters are fitted to all windows by least squares and
+ * written to the controller config.
+ */
+bool Axis::run_inertia_identification() {
+    const InertiaIdConfig_t& config = config_.inertia_id;
+    const uint32_t window_length = static_cast<uint32_t>(current_meas_hz / 100.0f); // 10ms
+    const uint32_t n_samples = static_cast<uint32_t>(config.duration * current_meas_hz);
+
+    // Normal equations of the least squares fit
+    float ata[3][3] = {{0.0f}};
+    float aty[3] = {0.0f};
+    uint32_t n_windows = 0;
+
+    float direction = 1.0f;
+    float torque_integral = 0.0f;     // [Nm*s]
+    float vel_integral = 0.0f;        // [turn]
+    float sign_integral = 0.0f;       // [s]
+    float window_start_vel = encoder_.vel_estimate_;
+    bool window_reversed = false;
+    uint32_t reversed_windows = 0;    // windows to skip while the velocity estimate settles
+    uint32_t i = 0;
+
+    run_control_loop([&]() {
+        float vel = encoder_.vel_estimate_;
+        if (std::abs(vel) > 2.0f * config.vel) {
+            error_ |= ERROR_INERTIA_ID_FAILED;
+            return false;
+        }
+
+        // Gimbal motors are voltage controlled, so only the setpoint is known
+        float torque_meas = (motor_.config_.motor_type == Motor::MOTOR_TYPE_GIMBAL)
+                ? direction * config.torque
+                : motor_.config_.direction * motor_.current_control_.Iq_measured * motor_.config_.torque_constant;
+        torque_integral += torque_meas * current_meas_period;
+        vel_integral += vel * current_meas_period;
+        sign_integral += (vel > 0.0f ? 1.0f : vel < 0.0f ? -1.0f : 0.0f) * current_meas_period;
+
+        if (++i % window_length == 0) {
+            if (window_reversed) {
+                reversed_windows = 2;
+                window_reversed = false;
+            }
+            if (reversed_windows) {
+                --reversed_windows;
+            } else {
+                float a[3] = {vel - window_start_vel, vel_integral, sign_integral};
+                for (size_t row = 0; row < 3; ++row) {
+                    for (size_t col = 0; col < 3; ++col)
+                        ata[row][col] += a[row] * a[col];
+                    aty[row] += a[row] * torque_integral;
+                }
+                ++n_windows;
+            }
+            torque_integral = 0.0f;
+            vel_integral = 0.0f;
+            sign_integral = 0.0f;
+            window_start_vel = vel;
+        }
+
+        if (direction * vel >= config.vel) {
+            direction = -direction;
+            window_reversed = true;
+        }
+
+        float phase_vel = (2*M_PI) * vel * motor_.config_.pole_pairs;
+        if (!motor_.update(direction * config.torque, encoder_.phase_, phase_vel))
+            return false;
+        return i < n_samples;
+    });
+
+    if (i < n_samples)
+        return check_for_errors(); // aborted
+
+    // Solve the normal equations with Cramer's rule
+    auto det3 = [](const float m[3][3]) {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    };
+    float det = det3(ata);
+    float result[3];
+    for (size_t col = 0; col < 3; ++col) {
+        float m[3][3];
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t k = 0; k < 3; ++k)
+                m[row][k] = (k == col) ? aty[row] : ata[row][k];
+        }
+        result[col] = det3(m) / det;
+    }
+
+    if (n_windows < 3 || !(det > 0.0f) || !(result[0] > 0.0f) || !std::isfinite(result[0])) {
+        error_ |= ERROR_INERTIA_ID_FAILED;
+        return false;
+    }
+    controller_.config_.inertia = result[0];
+    controller_.config_.viscous_damping = std::max(result[1], 0.0f);
+    controller_.config_.coulomb_friction = std::max(result[2], 0.0f);
+
+    return check_for_errors();
+}
+
 bool Axis::run_idle_loop() {
     // run_control_loop ignores missed modulation timing updates
     // if and only if we're in AXIS_STATE_IDLE
@@ -557,13 +702,30 @@ void Axis::run_state_machine_loop() {
             case AXIS_STATE_SENSORLESS_CONTROL: {
                 if (!motor_.is_calibrated_ || motor_.config_.direction==0)
                         goto invalid_state_label;
-                status = run_lockin_spin(config_.sensorless_ramp); // TODO: restart if desired
-                if (status) {
-                    // call to controller.reset() that happend when arming means that vel_setpoint
-                    // is zeroed. So we make the setpoint the spinup target for smooth transition.
-                    controller_.vel_setpoint_ = config_.sensorless_ramp.vel;
-                    status = run_sensorless_control_loop();
+                if (sensorless_estimator_.config_.enable_hfi && motor_.config_.motor_type != Motor::MOTOR_TYPE_HIGH_CURRENT)
+                    goto invalid_state_label;
+                bool spinning = false;
+                status = true;
+                if (sensorless_estimator_.config_.enable_flying_start) {
+                    status = sensorless_estimator_.run_flying_start(&spinning);
+                    // Continue at the speed that the rotor already has
+                    controller_.vel_setpoint_ = sensorless_estimator_.vel_estimate_;
+                }
+                if (status && !spinning) {
+                    if (sensorless_estimator_.config_.enable_hfi) {
+                        // Starts from standstill, the setpoint stays at zero
+                        controller_.vel_setpoint_ = 0.0f;
+                        status = sensorless_estimator_.run_hfi_startup();
+                    } else {
+                        status = run_lockin_spin(config_.sensorless_ramp); // TODO: restart if desired
+                        // call to controller.reset() that happend when arming means that vel_setpoint
+                        // is zeroed. So we make the setpoint the spinup target for smooth transition.
+                        controller_.vel_setpoint_ = config_.sensorless_ramp.vel;
+                    }
                 }
+                if (status)
+                    status = run_sensorless_control_loop();
+                sensorless_estimator_.stop_hfi();
             } break;
 
             case AXIS_STATE_CLOSED_LOOP_CONTROL: {
@@ -575,6 +737,22 @@ void Axis::run_state_machine_loop() {
                 status = run_closed_loop_control_loop();
             } break;
 
+            case AXIS_STATE_INERTIA_IDENTIFICATION: {
+                if (!motor_.is_calibrated_ || motor_.config_.direction==0)
+                    goto invalid_state_label;
+                if (!encoder_.is_ready_)
+                    goto invalid_state_label;
+                status = run_inertia_identification();
+            } break;
+
+            case AXIS_STATE_AUTOTUNING: {
+                if (!motor_.is_calibrated_ || motor_.config_.direction==0)
+                    goto invalid_state_label;
+                if (!encoder_.is_ready_)
+                    goto invalid_state_label;
+                status = autotuner_.run();
+            } break;
+
             case AXIS_STATE_IDLE: {
                 run_idle_loop();
                 status = motor_.arm(); // done with idling - try to arm the motor
@@ -5,10 +5,15 @@ class Axis;
 
 #include "encoder.hpp"
 #include "sensorless_estimator.hpp"
+#include "biquad_filter.hpp"
+#include "input_shaper.hpp"
+#include "backlash_estimator.hpp"
 #include "controller.hpp"
 #include "trapTraj.hpp"
 #include "endstop.hpp"
 #include "mechanical_brake.hpp"
+#include "cycle_profiler.hpp"
+#include "autotuner.hpp"
 #include "low_level.h"
 #include "utils.hpp"
 #include "communication/interface_uart.h" // TODO: remove once uart_poll() is gone
@@ -29,6 +34,12 @@ public:
         bool finish_on_enc_idx = false;
     };
 
+    struct InertiaIdConfig_t {
+        float torque = 0.05f;    // [Nm] amplitude of the torque excitation
+        float vel = 4.0f;        // [turn/s] the torque is reversed at this velocity
+        float duration = 4.0f;   // [s]
+    };
+
     static LockinConfig_t default_calibration();
     static LockinConfig_t default_sensorless();
     static LockinConfig_t default_lockin();
@@ -61,6 +72,7 @@ public:
         LockinConfig_t calibration_lockin = default_calibration();
         LockinConfig_t sensorless_ramp = default_sensorless();
         LockinConfig_t general_lockin;
+        InertiaIdConfig_t inertia_id;
         uint32_t can_node_id = 0; // Both axes will have the same id to start
         bool can_node_id_extended = false;
         uint32_t can_heartbeat_rate_ms = 100;
@@ -75,6 +87,12 @@ public:
         bool is_homed = false;
     };
 
+    // Rates of the tasks in run_control_loop that don't need to run in every
+    // current control cycle. The controller runs every
+    // controller.config.update_divider-th cycle.
+    static constexpr float CHECKS_RATE = 1000.0f; // [Hz] current limit, endstops, CAN heartbeat
+    static constexpr float THERMAL_RATE = 100.0f; // [Hz] thermistors
+
     enum thread_signals {
         M_SIGNAL_PH_CURRENT_MEAS = 1u << 0
     };
@@ -110,6 +128,13 @@ public:
     bool check_PSU_brownout();
     bool do_checks();
     bool do_updates();
+    bool update_controller(float* torque_setpoint);
+
+    // @brief Returns true if a task that runs every divider-th iteration of
+    // the control loop is due in the current iteration.
+    bool is_due(uint32_t divider) const {
+        return rate_group_counter_ % divider == 0;
+    }
 
     void watchdog_feed();
     bool watchdog_check();
@@ -151,6 +176,8 @@ public:
     // @tparam T Must be a callable type that takes no arguments and returns a bool
     template<typename T>
     void run_control_loop(const T& update_handler) {
+        // All rate groups are due in the first iteration
+        rate_group_counter_ = 0;
         while (requested_state_ == AXIS_STATE_UNDEFINED) {
             // look for errors at axis level and also all subcomponents
             bool checks_ok = do_checks();
@@ -170,7 +197,11 @@ public:
 
             // Run main loop function, defer quitting for after wait
             // TODO: change arming logic to arm after waiting
-            bool main_continue = update_handler();
+            bool main_continue;
+            {
+                CycleProfiler::Measurement measurement(profiler_.update_handler_);
+                main_continue = update_handler();
+            }
 
             if (axis_num_ == 0) {
                 uart_poll(); // TODO: move to board-level control loop once it exists
@@ -178,9 +209,15 @@ public:
 
             // Check we meet deadlines after queueing
             ++loop_counter_;
+            ++rate_group_counter_;
 
             // Wait until the current measurement interrupt fires
-            if (!wait_for_current_meas()) {
+            bool current_meas_ok;
+            {
+                CycleProfiler::Measurement measurement(profiler_.wait_for_current_meas_);
+                current_meas_ok = wait_for_current_meas();
+            }
+            if (!current_meas_ok) {
                 // maybe the interrupt handler is dead, let's be
                 // safe and float the phases
                 safety_critical_disarm_motor_pwm(motor_);
@@ -198,10 +235,11 @@ public:
     bool run_sensorless_control_loop();
     bool run_closed_loop_control_loop();
     bool run_homing();
+    bool run_inertia_identification();
     bool run_idle_loop();
 
-    constexpr uint32_t get_watchdog_reset() {
-        return static_cast<uint32_t>(std::clamp<float>(config_.watchdog_timeout, 0, UINT32_MAX / (current_meas_hz + 1)) * current_meas_hz);
+    uint32_t get_watchdog_reset() {
+        return static_cast<uint32_t>(std::clamp<float>(config_.watchdog_timeout, 0.0f, static_cast<float>(UINT32_MAX) / (current_meas_hz + 1.0f)) * current_meas_hz);
     }
 
     void run_state_machine_loop();
@@ -223,6 +261,8 @@ public:
     Endstop& min_endstop_;
     Endstop& max_endstop_;
     MechanicalBrake& mechanical_brake_;
+    CycleProfiler profiler_;
+    Autotuner autotuner_;
 
     // List of current_limiters and thermistors to
     // provide easy iteration.
@@ -251,6 +291,13 @@ public:
 
     // watchdog
     uint32_t watchdog_current_value_= 0;
+
+private:
+    // Rate groups of run_control_loop
+    uint32_t rate_group_counter_ = 0; // iterations since run_control_loop was entered
+    uint32_t checks_divider_ = 1;
+    uint32_t thermal_divider_ = 1;
+    float controller_torque_setpoint_ = 0.0f; // [Nm] held between the controller updates
 };
 
 
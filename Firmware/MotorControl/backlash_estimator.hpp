@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * @brief Estimates the backlash and the compliance of a transmission from
+ * the deflection between the motor and the load side and the torque that
+ * goes through it.
+ *
+ * The deflection is modelled as a spring with play:
+ *   offset + compliance * torque + 0.5 * backlash * sign(torque)
+ * Two straight lines with a common slope are fitted to the samples with
+ * positive and negative torque. The slope is the compliance and the distance
+ * between the lines is the backlash. Old samples are forgotten with the
+ * specified time constant, such that the estimates follow slow changes, e.g.
+ * of the temperature.
+ */
+class BacklashEstimator {
+public:
+    static constexpr float MIN_WEIGHT = 100.0f; // samples needed with each sign of the torque
+
+    void reset() {
+        positive_ = {};
+        negative_ = {};
+        valid_ = false;
+        has_reference_ = false;
+    }
+
+    // @param torque: [Nm]
+    // @param deflection: motor side minus load side position [turns]
+    // @param forgetting: period divided by the time constant of the forgetting
+    void update(float torque, float deflection, float forgetting) {
+        // The encoders have an arbitrary offset. The sums are taken relative
+        // to the first sample, otherwise they would lose the resolution for
+        // the small variations.
+        if (!has_reference_) {
+            reference_ = deflection;
+            has_reference_ = true;
+        }
+        deflection -= reference_;
+
+        if (torque == 0.0f)
+            return; // can be anywhere in the play
+        Moments_t& m = (torque > 0.0f) ? positive_ : negative_;
+        float decay = 1.0f - forgetting;
+        m.weight = decay * m.weight + 1.0f;
+        m.torque = decay * m.torque + torque;
+        m.deflection = decay * m.deflection + deflection;
+        m.torque_sq = decay * m.torque_sq + torque * torque;
+        m.torque_deflection = decay * m.torque_deflection + torque * deflection;
+
+        valid_ = solve();
+    }
+
+    bool valid_ = false;
+    float backlash_ = 0.0f;   // [turns]
+    float compliance_ = 0.0f; // [turns/Nm]
+    float offset_ = 0.0f;     // [turns] deflection in the middle of the play
+
+private:
+    struct Moments_t {
+        float weight;
+        float torque;
+        float deflection;
+        float torque_sq;
+        float torque_deflection;
+    };
+
+    bool solve() {
+        if (positive_.weight < MIN_WEIGHT || negative_.weight < MIN_WEIGHT)
+            return false;
+
+        // Covariances about the means of each side
+        float var = positive_.torque_sq - positive_.torque * positive_.torque / positive_.weight
+                  + negative_.torque_sq - negative_.torque * negative_.torque / negative_.weight;
+        float cov = positive_.torque_deflection - positive_.torque * positive_.deflection / positive_.weight
+                  + negative_.torque_deflection - negative_.torque * negative_.deflection / negative_.weight;
+        if (!(var > 0.0f))
+            return false;
+        compliance_ = cov / var;
+
+        float pos_intercept = (positive_.deflection - compliance_ * positive_.torque) / positive_.weight;
+        float neg_intercept = (negative_.deflection - compliance_ * negative_.torque) / negative_.weight;
+        backlash_ = pos_intercept - neg_intercept;
+        offset_ = reference_ + 0.5f * (pos_intercept + neg_intercept);
+        return true;
+    }
+
+    Moments_t positive_ = {};
+    Moments_t negative_ = {};
+    float reference_ = 0.0f; // [turns]
+    bool has_reference_ = false;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cmath>
+
+/**
+ * @brief Second order IIR filter section in transposed direct form II, the
+ * same structure as arm_biquad_cascade_df2T_f32 from CMSIS-DSP.
+ *
+ * The coefficients are designed with the bilinear transform, prewarped to the
+ * specified frequency. They are normalized such that a0 = 1.
+ */
+class BiquadFilter {
+public:
+    // @brief Passes the input through unchanged.
+    void set_passthrough() {
+        set_coefficients(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    }
+
+    // @brief Second order low-pass filter with the specified corner
+    // frequency [Hz] and quality factor.
+    // @returns false if the parameters are invalid, in which case the filter
+    // passes the input through.
+    bool set_lowpass(float freq, float q, float sample_rate) {
+        if (!check_params(freq, q, sample_rate))
+            return set_passthrough(), false;
+        float w0 = 2.0f * (float)M_PI * freq / sample_rate;
+        float cos_w0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * q);
+        set_coefficients((1.0f - cos_w0) / 2.0f, 1.0f - cos_w0, (1.0f - cos_w0) / 2.0f,
+                         1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+        return true;
+    }
+
+    // @brief Notch filter at the specified frequency [Hz].
+    // @param q: quality factor, i.e. the center frequency divided by the
+    //        -3dB bandwidth of a full notch
+    // @param gain: gain at the center frequency, 0 for a full notch
+    // @returns false if the parameters are invalid, in which case the filter
+    // passes the input through.
+    bool set_notch(float freq, float q, float gain, float sample_rate) {
+        if (!check_params(freq, q, sample_rate) || !(gain >= 0.0f))
+            return set_passthrough(), false;
+        float w0 = 2.0f * (float)M_PI * freq / sample_rate;
+        float cos_w0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * q);
+        set_coefficients(1.0f + gain * alpha, -2.0f * cos_w0, 1.0f - gain * alpha,
+                         1.0f + alpha, -2.0f * cos_w0, 1.0f - alpha);
+        return true;
+    }
+
+    // @brief First order lead-lag filter (1 + s/wz) / (1 + s/wp) with unity
+    // gain at DC and its maximum phase shift at the specified frequency [Hz].
+    // @param gain: high frequency gain wp/wz, > 1 for lead, < 1 for lag
+    // @returns false if the parameters are invalid, in which case the filter
+    // passes the input through.
+    bool set_lead_lag(float freq, float gain, float sample_rate) {
+        if (!check_params(freq, 1.0f, sample_rate) || !(gain > 0.0f))
+            return set_passthrough(), false;
+        float w0 = 2.0f * (float)M_PI * freq / sample_rate;
+        float k = 1.0f / tanf(w0 / 2.0f); // bilinear transform prewarped to w0
+        float sqrt_gain = sqrtf(gain);
+        set_coefficients(1.0f + k * sqrt_gain, 1.0f - k * sqrt_gain, 0.0f,
+                         1.0f + k / sqrt_gain, 1.0f - k / sqrt_gain, 0.0f);
+        return true;
+    }
+
+    void reset() {
+        state_[0] = 0.0f;
+        state_[1] = 0.0f;
+    }
+
+    float update(float x) {
+        float y = b0_ * x + state_[0];
+        state_[0] = b1_ * x - a1_ * y + state_[1];
+        state_[1] = b2_ * x - a2_ * y;
+        return y;
+    }
+
+private:
+    static bool check_params(float freq, float q, float sample_rate) {
+        return freq > 0.0f && freq < 0.45f * sample_rate && q > 0.0f;
+    }
+
+    void set_coefficients(float b0, float b1, float b2, float a0, float a1, float a2) {
+        b0_ = b0 / a0;
+        b1_ = b1 / a0;
+        b2_ = b2 / a0;
+        a1_ = a1 / a0;
+        a2_ = a2 / a0;
+    }
+
+    float b0_ = 1.0f;
+    float b1_ = 0.0f;
+    float b2_ = 0.0f;
+    float a1_ = 0.0f;
+    float a2_ = 0.0f;
+    float state_[2] = {0.0f, 0.0f};
+};
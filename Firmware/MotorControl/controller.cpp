@@ -1,12 +1,19 @@
 
 #include "odrive_main.h"
 #include <algorithm>
-
-#include <algorithm>
+#include <atomic>
+#include <Drivers/STM32/stm32_table_storage.h>
+#include <fibre/crc.hpp>
 
 bool Controller::apply_config() {
     config_.parent = this;
+    for (TorqueFilterConfig_t& filter_config : config_.torque_filter)
+        filter_config.parent = this;
+    config_.update_divider = std::max<uint32_t>(config_.update_divider, 1);
+    period_ = current_meas_period * (float)config_.update_divider;
     update_filter_gains();
+    update_torque_filters();
+    update_input_shaper();
     return true;
 }
 
@@ -15,6 +22,13 @@ void Controller::reset() {
     vel_setpoint_ = 0.0f;
     vel_integrator_torque_ = 0.0f;
     torque_setpoint_ = 0.0f;
+    disturbance_torque_ = 0.0f;
+    disturbance_observer_active_ = false;
+    input_shaper_active_ = false;
+    for (BiquadFilter& filter : torque_filters_)
+        filter.reset();
+    pvt_running_ = false;
+    coordinated_moves.stop(axis_->axis_num_);
 }
 
 void Controller::set_error(Error error) {
@@ -33,9 +47,19 @@ bool Controller::select_encoder(size_t encoder_num) {
         pos_estimate_circular_src_ = &ax->encoder_.pos_circular_;
         pos_wrap_src_ = &config_.circular_setpoint_range;
         pos_estimate_linear_src_ = &ax->encoder_.pos_estimate_;
+        pos_estimate_encoder_ = &ax->encoder_;
         pos_estimate_valid_src_ = &ax->encoder_.pos_estimate_valid_;
         vel_estimate_src_ = &ax->encoder_.vel_estimate_;
         vel_estimate_valid_src_ = &ax->encoder_.vel_estimate_valid_;
+        if (config_.enable_dual_loop) {
+            // The velocity loop stays on the motor encoder, the position
+            // loop needs a separate one on the load side
+            if (ax == axis_ || !(config_.load_gear_ratio != 0.0f))
+                return set_error(Controller::ERROR_INVALID_LOAD_ENCODER), false;
+            vel_estimate_src_ = &dual_loop_vel_estimate_;
+            vel_estimate_valid_src_ = &axis_->encoder_.vel_estimate_valid_;
+            backlash_estimator_.reset();
+        }
         return true;
     } else {
         return set_error(Controller::ERROR_INVALID_LOAD_ENCODER), false;
@@ -43,14 +67,45 @@ bool Controller::select_encoder(size_t encoder_num) {
 }
 
 void Controller::move_to_pos(float goal_point) {
-    axis_->trap_traj_.planTrapezoidal(goal_point, pos_setpoint_, vel_setpoint_,
-                                 axis_->trap_traj_.config_.vel_limit,
-                                 axis_->trap_traj_.config_.accel_limit,
-                                 axis_->trap_traj_.config_.decel_limit);
+    // Falls back to the trapezoidal profile if the jerk limit is invalid
+    bool planned = (config_.input_mode == INPUT_MODE_SCURVE_TRAJ)
+            && axis_->trap_traj_.planSCurve(goal_point, pos_setpoint_, vel_setpoint_,
+                                            axis_->trap_traj_.config_.vel_limit,
+                                            axis_->trap_traj_.config_.accel_limit,
+                                            axis_->trap_traj_.config_.decel_limit,
+                                            axis_->trap_traj_.config_.jerk_limit);
+    if (!planned) {
+        axis_->trap_traj_.planTrapezoidal(goal_point, pos_setpoint_, vel_setpoint_,
+                                     axis_->trap_traj_.config_.vel_limit,
+                                     axis_->trap_traj_.config_.accel_limit,
+                                     axis_->trap_traj_.config_.decel_limit);
+    }
     axis_->trap_traj_.t_ = 0.0f;
     trajectory_done_ = false;
 }
 
+/*
+ * Appends a point to the PVT queue.
+ *
+ * Returns false if the queue is full or dt is not positive.
+ */
+bool Controller::push_pvt_point(float dt, float pos, float vel, float torque) {
+    uint32_t tail = pvt_queue_tail_;
+    if (!(dt > 0.0f) || tail - pvt_queue_head_ >= PVT_QUEUE_SIZE)
+        return false;
+    pvt_queue_[tail % PVT_QUEUE_SIZE] = {dt, pos, vel, torque};
+    std::atomic_thread_fence(std::memory_order_release); // publish the point before the index
+    pvt_queue_tail_ = tail + 1;
+    return true;
+}
+
+// @brief Discards all points in the PVT queue.
+// This relies on update() running at a higher priority than the caller, so
+// it can't run in between reading the tail and writing the head.
+void Controller::clear_pvt_queue() {
+    pvt_queue_head_ = pvt_queue_tail_;
+}
+
 void Controller::move_incremental(float displacement, bool from_input_pos = true){
     if(from_input_pos){
         input_pos_ += displacement;
@@ -61,11 +116,53 @@ void Controller::move_incremental(float displacement, bool from_input_pos = true
     input_pos_updated();
 }
 
-void Controller::start_anticogging_calibration() {
-    // Ensure the cogging map was correctly allocated earlier and that the motor is capable of calibrating
-    if (axis_->error_ == Axis::ERROR_NONE) {
-        config_.anticogging.calib_anticogging = true;
+bool Controller::start_anticogging_calibration() {
+    // Ensure that the motor is capable of calibrating
+    if (axis_->error_ != Axis::ERROR_NONE)
+        return false;
+
+    anticogging_valid_ = false;
+    anticogging_fitting_ = false;
+
+    // One map entry per encoder count, halved until it fits
+    uint32_t num_entries = (uint32_t)std::max(axis_->encoder_.config_.cpr, (int32_t)1);
+    while (num_entries > ANTICOGGING_MAX_ENTRIES)
+        num_entries /= 2;
+
+    // Allocate the map of the calibration. Only one axis at a time is
+    // expected to hold an unsaved map.
+    if (calib_map_size_ != num_entries) {
+        float* calib_map = calib_map_;
+        calib_map_ = nullptr;
+        vPortFree(calib_map);
+        calib_map = (float*)pvPortMalloc(num_entries * sizeof(float));
+        if (!calib_map) {
+            calib_map_size_ = 0;
+            return false;
+        }
+        calib_map_size_ = num_entries;
+        calib_map_ = calib_map;
     }
+    std::fill(calib_map_, calib_map_ + calib_map_size_, 0.0f);
+
+    // The sweep starts at the current position. The recorded revolution
+    // is aligned to the map entries and begins after a short lead-in.
+    int start_bin = (int)floorf((axis_->encoder_.pos_estimate_ + ANTICOGGING_SWEEP_LEAD) * (float)calib_map_size_) + 1;
+    sweep_start_ = (float)start_bin / (float)calib_map_size_;
+    sweep_start_bin_ = mod(start_bin, (int)calib_map_size_);
+    sweep_pos_ = sweep_start_ - ANTICOGGING_SWEEP_LEAD;
+    sweep_dir_ = 1.0f;
+    sweep_pass_ = 0;
+    sweep_bin_ = -1;
+    sweep_bin_sum_ = 0.0f;
+    sweep_bin_count_ = 0;
+    sweep_dev_sum_ = 0.0f;
+    sweep_dev_sq_sum_ = 0.0f;
+    sweep_dev_count_ = 0;
+    config_.anticogging.calib_residual = 0.0f;
+
+    config_.anticogging.calib_anticogging = true;
+    return true;
 }
 
 
@@ -80,11 +177,11 @@ bool Controller::anticogging_calibration(float pos_estimate, float vel_estimate)
     float pos_err = input_pos_ - pos_estimate;
     if (std::abs(pos_err) <= config_.anticogging.calib_pos_threshold / (float)axis_->encoder_.config_.cpr &&
         std::abs(vel_estimate) < config_.anticogging.calib_vel_threshold / (float)axis_->encoder_.config_.cpr) {
-        config_.anticogging.cogging_map[std::clamp<uint32_t>(config_.anticogging.index++, 0, 3600)] = vel_integrator_torque_;
+        calib_map_[std::clamp<uint32_t>(config_.anticogging.index++, 0, calib_map_size_ - 1)] = vel_integrator_torque_;
     }
-    if (config_.anticogging.index < 3600) {
+    if (config_.anticogging.index < calib_map_size_) {
         config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
-        input_pos_ = config_.anticogging.index * axis_->encoder_.getCoggingRatio();
+        input_pos_ = (float)config_.anticogging.index / (float)calib_map_size_;
         input_vel_ = 0.0f;
         input_torque_ = 0.0f;
         input_pos_updated();
@@ -96,14 +193,450 @@ bool Controller::anticogging_calibration(float pos_estimate, float vel_estimate)
         input_vel_ = 0.0f;
         input_torque_ = 0.0f;
         input_pos_updated();
-        anticogging_valid_ = true;
-        config_.anticogging.calib_anticogging = false;
+        start_anticogging_fit();
         return true;
     }
 }
 
+/*
+ * This anti-cogging calibration moves the axis back and forth at constant
+ * velocity and averages the torque command that was needed at each map entry.
+ * Each revolution is recorded in both directions the same number of times, so
+ * the friction torque cancels out in the average.
+ *
+ * Every map entry is passed once per revolution. The deviation of each
+ * revolution from the average of the previous ones is reported in
+ * calib_residual as a measure of the noise in the map. A constant offset
+ * (friction) is not counted.
+ *
+ * Must be called once per control cycle. Returns true when done.
+ */
+bool Controller::anticogging_sweep() {
+    Anticogging_t& ac = config_.anticogging;
+    // At least one sample per map entry
+    float max_vel = 1.0f / ((float)calib_map_size_ * period_);
+    float vel = std::clamp(std::abs(ac.calib_sweep_vel), 0.0f, max_vel);
+    uint32_t num_passes = 2 * std::max<uint32_t>(ac.calib_sweep_cycles, 1);
+
+    // Record the torque command of the last cycle under the setpoint of that cycle
+    float rel_pos = (sweep_pos_ - sweep_start_) * (float)calib_map_size_;
+    if (rel_pos >= 0.0f && rel_pos < (float)calib_map_size_) {
+        int bin = mod(sweep_start_bin_ + (int)rel_pos, (int)calib_map_size_);
+        if (bin != sweep_bin_) {
+            anticogging_sweep_finish_bin();
+            sweep_bin_ = bin;
+        }
+        sweep_bin_sum_ += torque_output_;
+        sweep_bin_count_++;
+    }
+
+    sweep_pos_ += sweep_dir_ * vel * period_;
+
+    // Reverse after the lead-out
+    float pass_end = sweep_dir_ > 0.0f ? sweep_start_ + 1.0f + ANTICOGGING_SWEEP_LEAD : sweep_start_ - ANTICOGGING_SWEEP_LEAD;
+    if (sweep_dir_ * (sweep_pos_ - pass_end) >= 0.0f) {
+        anticogging_sweep_finish_bin();
+        sweep_bin_ = -1;
+        if (sweep_dev_count_) {
+            float mean = sweep_dev_sum_ / (float)sweep_dev_count_;
+            float variance = sweep_dev_sq_sum_ / (float)sweep_dev_count_ - SQ(mean);
+            ac.calib_residual = sqrtf(std::max(variance, 0.0f));
+        }
+        sweep_dev_sum_ = 0.0f;
+        sweep_dev_sq_sum_ = 0.0f;
+        sweep_dev_count_ = 0;
+
+        sweep_pos_ = pass_end;
+        sweep_dir_ = -sweep_dir_;
+        sweep_pass_++;
+    }
+
+    config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
+    input_pos_ = sweep_pos_;
+    input_vel_ = sweep_pass_ < num_passes ? sweep_dir_ * vel : 0.0f;
+    input_torque_ = 0.0f;
+    input_pos_updated();
+
+    if (sweep_pass_ < num_passes)
+        return false;
+
+    start_anticogging_fit();
+    return true;
+}
+
+// @brief Adds the average of the samples of the current map entry to the
+// running average of the previous revolutions.
+void Controller::anticogging_sweep_finish_bin() {
+    if (sweep_bin_ < 0 || !sweep_bin_count_)
+        return;
+
+    float torque = sweep_bin_sum_ / (float)sweep_bin_count_;
+    float& entry = calib_map_[sweep_bin_];
+    if (sweep_pass_ == 0) {
+        entry = torque;
+    } else {
+        float deviation = torque - entry;
+        sweep_dev_sum_ += deviation;
+        sweep_dev_sq_sum_ += SQ(deviation);
+        sweep_dev_count_++;
+        entry += deviation / (float)(sweep_pass_ + 1);
+    }
+    sweep_bin_sum_ = 0.0f;
+    sweep_bin_count_ = 0;
+}
+
+void Controller::start_anticogging_fit() {
+    anticogging_fitting_ = true;
+    fit_order_ = 0;
+    fit_index_ = 0;
+    fit_acc_cos_ = 0.0f;
+    fit_acc_sin_ = 0.0f;
+    config_.anticogging.num_harmonics = 0;
+}
+
+/*
+ * Fits the harmonic model to the recorded cogging map.
+ *
+ * The Fourier coefficients of all orders up to the Nyquist limit of the map
+ * are computed and the ones with the largest magnitude are kept. This is too
+ * expensive for a single control period, so every call only processes a
+ * chunk of the map. A map of 4096 entries takes 2049 orders of 12 chunks each,
+ * which is about 3s at 8kHz.
+ *
+ * Returns true once the fit is complete.
+ */
+bool Controller::anticogging_fit_harmonics() {
+    constexpr uint32_t chunk_size = 360;
+    const uint32_t max_order = calib_map_size_ / 2;
+    Anticogging_t& ac = config_.anticogging;
+    uint32_t max_harmonics = std::min(ac.max_harmonics, ANTICOGGING_MAX_HARMONICS);
+
+    // The rotation is re-seeded at the beginning of each chunk so that
+    // rounding errors don't accumulate over the whole map.
+    float step = 2.0f * M_PI * (float)fit_order_ / (float)calib_map_size_;
+    float c = our_arm_cos_f32(step * (float)fit_index_);
+    float s = our_arm_sin_f32(step * (float)fit_index_);
+    float c_step = our_arm_cos_f32(step);
+    float s_step = our_arm_sin_f32(step);
+    uint32_t end = std::min(fit_index_ + chunk_size, calib_map_size_);
+    for (; fit_index_ < end; ++fit_index_) {
+        fit_acc_cos_ += calib_map_[fit_index_] * c;
+        fit_acc_sin_ += calib_map_[fit_index_] * s;
+        float c_next = c * c_step - s * s_step;
+        s = s * c_step + c * s_step;
+        c = c_next;
+    }
+    if (fit_index_ < calib_map_size_)
+        return false;
+
+    // The constant and the Nyquist term (if the map has an even size) have
+    // no counterpart at the negative frequency, so they aren't doubled.
+    bool real_only = fit_order_ == 0 || 2 * fit_order_ == calib_map_size_;
+    float scale = (real_only ? 1.0f : 2.0f) / (float)calib_map_size_;
+    float a = fit_acc_cos_ * scale;
+    float b = real_only ? 0.0f : fit_acc_sin_ * scale;
+
+    // Keep the largest harmonics. If the list is full, replace the smallest one.
+    uint32_t slot = ac.num_harmonics;
+    if (ac.num_harmonics >= max_harmonics) {
+        slot = 0;
+        for (uint32_t i = 1; i < ac.num_harmonics; ++i) {
+            if (SQ(ac.harmonic_cos[i]) + SQ(ac.harmonic_sin[i]) < SQ(ac.harmonic_cos[slot]) + SQ(ac.harmonic_sin[slot]))
+                slot = i;
+        }
+        if (SQ(a) + SQ(b) <= SQ(ac.harmonic_cos[slot]) + SQ(ac.harmonic_sin[slot]))
+            slot = max_harmonics; // smaller than all existing ones
+    } else {
+        ac.num_harmonics++;
+    }
+    if (slot < max_harmonics) {
+        ac.harmonic_order[slot] = (uint16_t)fit_order_;
+        ac.harmonic_cos[slot] = a;
+        ac.harmonic_sin[slot] = b;
+    }
+
+    fit_index_ = 0;
+    fit_acc_cos_ = 0.0f;
+    fit_acc_sin_ = 0.0f;
+    if (++fit_order_ <= max_order)
+        return false;
+
+    // Sort by order (insertion sort) for anticogging_harmonic_torque()
+    for (uint32_t i = 1; i < ac.num_harmonics; ++i) {
+        for (uint32_t j = i; j > 0 && ac.harmonic_order[j - 1] > ac.harmonic_order[j]; --j) {
+            std::swap(ac.harmonic_order[j - 1], ac.harmonic_order[j]);
+            std::swap(ac.harmonic_cos[j - 1], ac.harmonic_cos[j]);
+            std::swap(ac.harmonic_sin[j - 1], ac.harmonic_sin[j]);
+        }
+    }
+    return true;
+}
+
+/*
+ * Evaluates the harmonic anticogging model at the specified position [turns].
+ *
+ * Only one sin/cos pair is evaluated. The unit phasor of each harmonic is
+ * obtained from the one of the previous (lower) harmonic by rotating it by
+ * the difference in order, which is computed by repeated squaring.
+ */
+float Controller::anticogging_harmonic_torque(float pos) {
+    const Anticogging_t& ac = config_.anticogging;
+    float theta = 2.0f * M_PI * fmodf_pos(pos, 1.0f);
+    float c1 = our_arm_cos_f32(theta);
+    float s1 = our_arm_sin_f32(theta);
+
+    float torque = 0.0f;
+    float c = 1.0f, s = 0.0f; // phasor of the current order
+    uint32_t order = 0;
+    uint32_t num_harmonics = std::min(ac.num_harmonics, ANTICOGGING_MAX_HARMONICS);
+    for (uint32_t i = 0; i < num_harmonics; ++i) {
+        // Rotate by (harmonic_order[i] - order) * theta
+        uint32_t delta = ac.harmonic_order[i] - order;
+        float c_pow = c1, s_pow = s1;
+        while (delta) {
+            if (delta & 1) {
+                float c_next = c * c_pow - s * s_pow;
+                s = s * c_pow + c * s_pow;
+                c = c_next;
+            }
+            float c_sq = c_pow * c_pow - s_pow * s_pow;
+            s_pow = 2.0f * s_pow * c_pow;
+            c_pow = c_sq;
+            delta >>= 1;
+        }
+        order = ac.harmonic_order[i];
+        torque += ac.harmonic_cos[i] * c + ac.harmonic_sin[i] * s;
+    }
+    return torque;
+}
+
+/*
+ * Evaluates the anticogging map at the specified position [turns] with linear
+ * interpolation between the entries.
+ *
+ * The map of the last calibration is used until it was saved to flash. After
+ * that the map is read from flash in place.
+ */
+float Controller::anticogging_map_torque(float pos) {
+    const int16_t* entries = nullptr;
+    uint32_t num_entries;
+    if (calib_map_) {
+        num_entries = calib_map_size_;
+    } else if (anticogging_map_) {
+        entries = reinterpret_cast<const int16_t*>(anticogging_map_ + 1);
+        num_entries = anticogging_map_->num_entries;
+    } else {
+        return 0.0f;
+    }
+
+    float x = fmodf_pos(pos, 1.0f) * (float)num_entries;
+    uint32_t i = std::min((uint32_t)x, num_entries - 1);
+    uint32_t i_next = (i + 1 < num_entries) ? i + 1 : 0;
+    float frac = x - (float)i;
+    if (calib_map_) {
+        return calib_map_[i] + frac * (calib_map_[i_next] - calib_map_[i]);
+    } else {
+        float value = (float)entries[i] + frac * (float)(entries[i_next] - entries[i]);
+        return value * anticogging_map_->scale;
+    }
+}
+
+// @brief Looks for a valid anticogging map in the flash table of this axis.
+void Controller::load_anticogging_map() {
+    anticogging_map_ = nullptr;
+    size_t size = 0;
+    const uint8_t* table = TABLE_STORAGE_get(axis_->axis_num_, &size);
+    if (!table || size < sizeof(AnticoggingMapHeader_t))
+        return;
+
+    const AnticoggingMapHeader_t* header = reinterpret_cast<const AnticoggingMapHeader_t*>(table);
+    if (header->magic != ANTICOGGING_MAP_MAGIC || header->num_entries == 0
+            || header->num_entries > (size - sizeof(*header)) / sizeof(int16_t))
+        return;
+    uint16_t crc16 = calc_crc16<ANTICOGGING_MAP_CRC16_POLYNOMIAL>(ANTICOGGING_MAP_CRC16_INIT,
+            table + sizeof(*header), header->num_entries * sizeof(int16_t));
+    if (crc16 != header->crc16)
+        return;
+
+    anticogging_map_ = header;
+}
+
+/*
+ * Saves the map of the last anticogging calibration to the flash table of
+ * this axis. The values are stored as int16 with a common scale factor.
+ *
+ * Erasing the flash stalls the CPU, which would also stop the control loop
+ * of the other axis, so this is refused while any motor is armed.
+ *
+ * Returns true on success.
+ */
+bool Controller::save_anticogging_map() {
+    if (!calib_map_ || config_.anticogging.calib_anticogging)
+        return false;
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        if (axes[i].motor_.armed_state_ != Motor::ARMED_STATE_DISARMED)
+            return false;
+    }
+
+    size_t size = 0;
+    if (!TABLE_STORAGE_get(axis_->axis_num_, &size)
+            || sizeof(AnticoggingMapHeader_t) + calib_map_size_ * sizeof(int16_t) > size)
+        return false;
+
+    float max_abs = 0.0f;
+    for (uint32_t i = 0; i < calib_map_size_; ++i)
+        max_abs = std::max(max_abs, std::abs(calib_map_[i]));
+    float scale = max_abs > 0.0f ? max_abs / (float)INT16_MAX : 1.0f;
+
+    anticogging_map_ = nullptr;
+    if (TABLE_STORAGE_erase(axis_->axis_num_) != 0)
+        return false;
+
+    // Write the entries in chunks, then the header so that an interrupted
+    // write leaves no valid map behind.
+    uint16_t crc16 = ANTICOGGING_MAP_CRC16_INIT;
+    int16_t chunk[32];
+    for (uint32_t i = 0; i < calib_map_size_; i += 32) {
+        uint32_t n = std::min<uint32_t>(32, calib_map_size_ - i);
+        for (uint32_t k = 0; k < 32; ++k)
+            chunk[k] = k < n ? (int16_t)lroundf(calib_map_[i + k] / scale) : -1;
+        crc16 = calc_crc16<ANTICOGGING_MAP_CRC16_POLYNOMIAL>(crc16, reinterpret_cast<uint8_t*>(chunk), n * sizeof(int16_t));
+        size_t length = ((n * sizeof(int16_t)) + 3) & ~(size_t)3;
+        if (TABLE_STORAGE_write(axis_->axis_num_, sizeof(AnticoggingMapHeader_t) + i * sizeof(int16_t),
+                                reinterpret_cast<uint8_t*>(chunk), length) != 0)
+            return false;
+    }
+
+    AnticoggingMapHeader_t header = {
+        .magic = ANTICOGGING_MAP_MAGIC,
+        .num_entries = calib_map_size_,
+        .scale = scale,
+        .crc16 = crc16,
+        .reserved = 0xffff
+    };
+    if (TABLE_STORAGE_write(axis_->axis_num_, 0, reinterpret_cast<uint8_t*>(&header), sizeof(header)) != 0)
+        return false;
+
+    load_anticogging_map();
+    if (!anticogging_map_)
+        return false;
+
+    // From now on the map is read from flash
+    float* calib_map = calib_map_;
+    calib_map_ = nullptr;
+    calib_map_size_ = 0;
+    vPortFree(calib_map);
+    return true;
+}
+
+/*
+ * Interpolates the velocity based gain schedule linearly between its
+ * breakpoints. The table ends at the first breakpoint whose vel is not greater
+ * than the one before, so unused entries can be left at their defaults.
+ * Below the first and above the last breakpoint the scale of that breakpoint
+ * is used.
+ */
+void Controller::get_vel_gain_scale(float abs_vel, float* vel_gain_scale, float* vel_integrator_gain_scale) {
+    const GainSchedulePoint_t* schedule = config_.vel_gain_schedule;
+    size_t i = 0;
+    while (i + 1 < VEL_GAIN_SCHEDULE_SIZE && schedule[i + 1].vel > schedule[i].vel
+            && abs_vel >= schedule[i + 1].vel)
+        ++i;
+
+    const GainSchedulePoint_t& lo = schedule[i];
+    *vel_gain_scale = lo.vel_gain_scale;
+    *vel_integrator_gain_scale = lo.vel_integrator_gain_scale;
+    if (i + 1 < VEL_GAIN_SCHEDULE_SIZE && schedule[i + 1].vel > lo.vel && abs_vel > lo.vel) {
+        const GainSchedulePoint_t& hi = schedule[i + 1];
+        float frac = (abs_vel - lo.vel) / (hi.vel - lo.vel);
+        *vel_gain_scale += frac * (hi.vel_gain_scale - lo.vel_gain_scale);
+        *vel_integrator_gain_scale += frac * (hi.vel_integrator_gain_scale - lo.vel_integrator_gain_scale);
+    }
+}
+
+/*
+ * Estimates the load torque d from the motor torque T and the velocity v,
+ * based on the model
+ *   inertia * dv/dt = T - viscous_damping * v - coulomb_friction * sign(v) - d
+ *
+ * The observer integrates z = d + L * inertia * v instead of d, so that the
+ * velocity estimate does not need to be differentiated:
+ *   dz/dt = L * (T - viscous_damping * v - coulomb_friction * sign(v) - d)
+ * where L is the observer bandwidth.
+ */
+void Controller::update_disturbance_observer(float vel) {
+    Motor& motor = axis_->motor_;
+    float bandwidth = config_.disturbance_observer_bandwidth;
+    float bandwidth_inertia = bandwidth * config_.inertia;
+    if (!disturbance_observer_active_) {
+        disturbance_observer_state_ = bandwidth_inertia * vel;
+        disturbance_observer_active_ = true;
+    }
+
+    // Torque during the last control period
+    float motor_torque;
+    if (motor.config_.motor_type == Motor::MOTOR_TYPE_GIMBAL) {
+        motor_torque = torque_output_; // voltage controlled, no current measurement
+    } else {
+        motor_torque = motor.config_.direction * motor.current_control_.Iq_measured * motor.config_.torque_constant;
+        if (motor.config_.motor_type == Motor::MOTOR_TYPE_ACIM)
+            motor_torque *= fmax(motor.current_control_.acim_rotor_flux, motor.config_.acim_gain_min_flux);
+    }
+
+    float friction = config_.viscous_damping * vel;
+    if (vel != 0.0f)
+        friction += std::copysign(config_.coulomb_friction, vel);
+
+    disturbance_torque_ = disturbance_observer_state_ - bandwidth_inertia * vel;
+    disturbance_observer_state_ += (bandwidth * period_) * (motor_torque - friction - disturbance_torque_);
+}
+
+// @brief Computes the coefficients of the torque filters from their config.
+// Sections with invalid parameters pass the torque through.
+void Controller::update_torque_filters() {
+    for (size_t i = 0; i < TORQUE_FILTER_COUNT; ++i) {
+        const TorqueFilterConfig_t& filter_config = config_.torque_filter[i];
+        BiquadFilter& filter = torque_filters_[i];
+        switch (filter_config.type) {
+            case TORQUE_FILTER_TYPE_LOW_PASS: {
+                filter.set_lowpass(filter_config.freq, filter_config.q, 1.0f / period_);
+            } break;
+            case TORQUE_FILTER_TYPE_NOTCH: {
+                filter.set_notch(filter_config.freq, filter_config.q, filter_config.gain, 1.0f / period_);
+            } break;
+            case TORQUE_FILTER_TYPE_LEAD_LAG: {
+                filter.set_lead_lag(filter_config.freq, filter_config.gain, 1.0f / period_);
+            } break;
+            default: {
+                filter.set_passthrough();
+            } break;
+        }
+    }
+}
+
+// @brief Computes the impulses of the input shaper from its config.
+// Invalid parameters disable the shaping.
+void Controller::update_input_shaper() {
+    switch (config_.input_shaper_type) {
+        case INPUT_SHAPER_TYPE_ZV: {
+            input_shaper_.set_zv(config_.input_shaper_freq, config_.input_shaper_damping, 1.0f / period_);
+        } break;
+        case INPUT_SHAPER_TYPE_ZVD: {
+            input_shaper_.set_zvd(config_.input_shaper_freq, config_.input_shaper_damping, 1.0f / period_);
+        } break;
+        case INPUT_SHAPER_TYPE_EI: {
+            input_shaper_.set_ei(config_.input_shaper_freq, config_.input_shaper_damping, 1.0f / period_);
+        } break;
+        default: {
+            input_shaper_.set_passthrough();
+        } break;
+    }
+    // Restart from the current setpoint
+    input_shaper_active_ = false;
+}
+
 void Controller::update_filter_gains() {
-    float bandwidth = std::min(config_.input_filter_bandwidth, 0.25f * current_meas_hz);
+    float bandwidth = std::min(config_.input_filter_bandwidth, 0.25f / period_);
     input_filter_ki_ = 2.0f * bandwidth;  // basic conversion to discrete time
     input_filter_kp_ = 0.25f * (input_filter_ki_ * input_filter_ki_); // Critically damped
 }
@@ -115,6 +648,8 @@ static float limitVel(const float vel_limit, const float vel_estimate, const flo
 }
 
 bool Controller::update(float* torque_setpoint_output) {
+    CycleProfiler::Measurement measurement(axis_->profiler_.controller_update_);
+
     float* pos_estimate_linear = (pos_estimate_valid_src_ && *pos_estimate_valid_src_)
             ? pos_estimate_linear_src_ : nullptr;
     float* pos_estimate_circular = (pos_estimate_valid_src_ && *pos_estimate_valid_src_)
@@ -122,15 +657,35 @@ bool Controller::update(float* torque_setpoint_output) {
     float* vel_estimate_src = (vel_estimate_valid_src_ && *vel_estimate_valid_src_)
             ? vel_estimate_src_ : nullptr;
 
+    // Dual loop control: the position comes from the load encoder, the
+    // velocity from the motor encoder, scaled to the load side
+    if (vel_estimate_src_ == &dual_loop_vel_estimate_) {
+        dual_loop_vel_estimate_ = axis_->encoder_.vel_estimate_ / config_.load_gear_ratio;
+        if (pos_estimate_linear && axis_->encoder_.pos_estimate_valid_) {
+            load_deflection_ = axis_->encoder_.pos_estimate_ / config_.load_gear_ratio - *pos_estimate_linear;
+            backlash_estimator_.update(torque_output_, load_deflection_, period_ / config_.backlash_estimator_time);
+        }
+    }
+
     // Calib_anticogging is only true when calibration is occurring, so we can't block anticogging_pos
-    float anticogging_pos = axis_->encoder_.pos_estimate_ / axis_->encoder_.getCoggingRatio();
+    float anticogging_pos = axis_->encoder_.pos_estimate_; // [turns]
     if (config_.anticogging.calib_anticogging) {
         if (!axis_->encoder_.pos_estimate_valid_ || !axis_->encoder_.vel_estimate_valid_) {
             set_error(ERROR_INVALID_ESTIMATE);
             return false;
         }
         // non-blocking
-        anticogging_calibration(axis_->encoder_.pos_estimate_, axis_->encoder_.vel_estimate_);
+        if (anticogging_fitting_) {
+            if (anticogging_fit_harmonics()) {
+                anticogging_fitting_ = false;
+                anticogging_valid_ = true;
+                config_.anticogging.calib_anticogging = false;
+            }
+        } else if (config_.anticogging.calib_sweep) {
+            anticogging_sweep();
+        } else {
+            anticogging_calibration(axis_->encoder_.pos_estimate_, axis_->encoder_.vel_estimate_);
+        }
     }
 
     // TODO also enable circular deltas for 2nd order filter, etc.
@@ -139,6 +694,24 @@ bool Controller::update(float* torque_setpoint_output) {
         input_pos_ = fmodf_pos(input_pos_, config_.circular_setpoint_range);
     }
 
+    // PVT paths and coordinated moves restart from the current setpoint after
+    // leaving their mode
+    if (config_.input_mode != INPUT_MODE_PVT)
+        pvt_running_ = false;
+    if (config_.input_mode != INPUT_MODE_COORDINATED_TRAJ)
+        coordinated_moves.stop(axis_->axis_num_);
+
+    // Input shaping of the trajectory and position filter modes
+    bool shape_input = config_.input_shaper_type != INPUT_SHAPER_TYPE_NONE
+            && (config_.input_mode == INPUT_MODE_POS_FILTER
+                || config_.input_mode == INPUT_MODE_TRAP_TRAJ
+                || config_.input_mode == INPUT_MODE_SCURVE_TRAJ);
+    if (shape_input && input_shaper_active_) {
+        pos_setpoint_ = unshaped_setpoint_.pos;
+        vel_setpoint_ = unshaped_setpoint_.vel;
+        torque_setpoint_ = unshaped_setpoint_.torque;
+    }
+
     // Update inputs
     switch (config_.input_mode) {
         case INPUT_MODE_INACTIVE: {
@@ -150,15 +723,15 @@ bool Controller::update(float* torque_setpoint_output) {
             torque_setpoint_ = input_torque_; 
         } break;
         case INPUT_MODE_VEL_RAMP: {
-            float max_step_size = std::abs(current_meas_period * config_.vel_ramp_rate);
+            float max_step_size = std::abs(period_ * config_.vel_ramp_rate);
             float full_step = input_vel_ - vel_setpoint_;
             float step = std::clamp(full_step, -max_step_size, max_step_size);
 
             vel_setpoint_ += step;
-            torque_setpoint_ = (step / current_meas_period) * config_.inertia;
+            torque_setpoint_ = (step / period_) * config_.inertia;
         } break;
         case INPUT_MODE_TORQUE_RAMP: {
-            float max_step_size = std::abs(current_meas_period * config_.torque_ramp_rate);
+            float max_step_size = std::abs(period_ * config_.torque_ramp_rate);
             float full_step = input_torque_ - torque_setpoint_;
             float step = std::clamp(full_step, -max_step_size, max_step_size);
 
@@ -170,8 +743,8 @@ bool Controller::update(float* torque_setpoint_output) {
             float delta_vel = input_vel_ - vel_setpoint_; // Vel error
             float accel = input_filter_kp_*delta_pos + input_filter_ki_*delta_vel; // Feedback
             torque_setpoint_ = accel * config_.inertia; // Accel
-            vel_setpoint_ += current_meas_period * accel; // delta vel
-            pos_setpoint_ += current_meas_period * vel_setpoint_; // Delta pos
+            vel_setpoint_ += period_ * accel; // delta vel
+            pos_setpoint_ += period_ * vel_setpoint_; // Delta pos
         } break;
         case INPUT_MODE_MIRROR: {
             if (config_.axis_to_mirror < AXIS_COUNT) {
@@ -185,7 +758,8 @@ bool Controller::update(float* torque_setpoint_output) {
         // case INPUT_MODE_MIX_CHANNELS: {
         //     // NOT YET IMPLEMENTED
         // } break;
-        case INPUT_MODE_TRAP_TRAJ: {
+        case INPUT_MODE_TRAP_TRAJ:
+        case INPUT_MODE_SCURVE_TRAJ: {
             if(input_pos_updated_){
                 move_to_pos(input_pos_);
                 input_pos_updated_ = false;
@@ -206,10 +780,69 @@ bool Controller::update(float* torque_setpoint_output) {
                 pos_setpoint_ = traj_step.Y;
                 vel_setpoint_ = traj_step.Yd;
                 torque_setpoint_ = traj_step.Ydd * config_.inertia;
-                axis_->trap_traj_.t_ += current_meas_period;
+                axis_->trap_traj_.t_ += period_;
             }
             anticogging_pos = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
         } break;
+        case INPUT_MODE_PVT: {
+            if (!pvt_running_) {
+                // The first segment starts at the current setpoint
+                pvt_prev_ = {0.0f, pos_setpoint_, vel_setpoint_, 0.0f};
+                pvt_t_ = 0.0f;
+                pvt_running_ = true;
+            }
+
+            // Drop the points that were passed
+            uint32_t head = pvt_queue_head_;
+            uint32_t tail = pvt_queue_tail_;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            while (head != tail && pvt_t_ >= pvt_queue_[head % PVT_QUEUE_SIZE].dt) {
+                pvt_prev_ = pvt_queue_[head % PVT_QUEUE_SIZE];
+                pvt_t_ -= pvt_prev_.dt;
+                head++;
+            }
+            pvt_queue_head_ = head;
+
+            if (head == tail) {
+                // The queue must not run empty while moving
+                if (pvt_prev_.vel != 0.0f) {
+                    set_error(ERROR_PVT_QUEUE_UNDERRUN);
+                    return false;
+                }
+                // End of the path: hold the last point. The next segment
+                // starts when the next point arrives.
+                pos_setpoint_ = pvt_prev_.pos;
+                vel_setpoint_ = 0.0f;
+                torque_setpoint_ = pvt_prev_.torque;
+                pvt_t_ = 0.0f;
+            } else {
+                // Cubic Hermite interpolation between pvt_prev_ and the next point
+                const PvtPoint_t& next = pvt_queue_[head % PVT_QUEUE_SIZE];
+                float h = next.dt;
+                float s = pvt_t_ / h;
+                float dp = next.pos - pvt_prev_.pos;
+                float m0 = h * pvt_prev_.vel;
+                float m1 = h * next.vel;
+                // pos = pvt_prev_.pos + m0*s + c2*s^2 + c3*s^3
+                float c2 = 3.0f * dp - 2.0f * m0 - m1;
+                float c3 = m0 + m1 - 2.0f * dp;
+                pos_setpoint_ = pvt_prev_.pos + s * (m0 + s * (c2 + s * c3));
+                vel_setpoint_ = (m0 + s * (2.0f * c2 + 3.0f * s * c3)) / h;
+                float accel = (2.0f * c2 + 6.0f * s * c3) / SQ(h);
+                torque_setpoint_ = pvt_prev_.torque + s * (next.torque - pvt_prev_.torque) + accel * config_.inertia;
+                pvt_t_ += period_;
+            }
+            anticogging_pos = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
+        } break;
+        case INPUT_MODE_COORDINATED_TRAJ: {
+            if (!coordinated_moves.is_active(axis_->axis_num_))
+                coordinated_moves.start(axis_->axis_num_, pos_setpoint_);
+            TrapezoidalTrajectory::Step_t traj_step = coordinated_moves.update(axis_->axis_num_, period_);
+            pos_setpoint_ = traj_step.Y;
+            vel_setpoint_ = traj_step.Yd;
+            torque_setpoint_ = traj_step.Ydd * config_.inertia;
+            anticogging_pos = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
+        } break;
         default: {
             set_error(ERROR_INVALID_INPUT_MODE);
             return false;
@@ -217,6 +850,22 @@ bool Controller::update(float* torque_setpoint_output) {
         
     }
 
+    if (shape_input) {
+        unshaped_setpoint_ = {pos_setpoint_, vel_setpoint_, torque_setpoint_};
+        if (!input_shaper_active_) {
+            input_shaper_.reset(unshaped_setpoint_);
+            input_shaper_active_ = true;
+        }
+        InputShaper::Sample_t shaped = input_shaper_.update(unshaped_setpoint_);
+        pos_setpoint_ = shaped.pos;
+        vel_setpoint_ = shaped.vel;
+        torque_setpoint_ = shaped.torque;
+        if (config_.input_mode != INPUT_MODE_POS_FILTER)
+            anticogging_pos = pos_setpoint_;
+    } else {
+        input_shaper_active_ = false;
+    }
+
     // Position control
     // TODO Decide if we want to use encoder or pll position here
     float gain_scheduling_multiplier = 1.0f;
@@ -239,7 +888,10 @@ bool Controller::update(float* torque_setpoint_output) {
                 set_error(ERROR_INVALID_ESTIMATE);
                 return false;
             }
-            pos_err = pos_setpoint_ - *pos_estimate_linear;
+            // The encoder computes the error in fixed-point, which doesn't
+            // lose resolution at large positions
+            pos_err = pos_estimate_encoder_ ? pos_estimate_encoder_->pos_error(pos_setpoint_)
+                                            : pos_setpoint_ - *pos_estimate_linear;
         }
 
         vel_des += config_.pos_gain * pos_err;
@@ -283,14 +935,43 @@ bool Controller::update(float* torque_setpoint_output) {
         // (or again just do control in torque units)
     }
 
+    // Gain scheduling based on velocity
+    if (config_.enable_vel_gain_schedule && vel_estimate_src) {
+        float vel_gain_scale, vel_integrator_gain_scale;
+        get_vel_gain_scale(std::abs(*vel_estimate_src), &vel_gain_scale, &vel_integrator_gain_scale);
+        vel_gain *= vel_gain_scale;
+        vel_integrator_gain *= vel_integrator_gain_scale;
+    }
+
     // Velocity control
     float torque = torque_setpoint_;
 
+    // Friction feedforward
+    if (config_.control_mode >= CONTROL_MODE_VELOCITY_CONTROL) {
+        torque += config_.viscous_damping * vel_setpoint_;
+        if (vel_setpoint_ != 0.0f)
+            torque += std::copysign(config_.coulomb_friction, vel_setpoint_);
+    }
+
+    // Load torque feedforward
+    if (config_.enable_disturbance_observer && config_.control_mode >= CONTROL_MODE_VELOCITY_CONTROL
+            && vel_estimate_src && config_.inertia > 0.0f) {
+        update_disturbance_observer(*vel_estimate_src);
+        torque += disturbance_torque_;
+    } else {
+        disturbance_torque_ = 0.0f;
+        disturbance_observer_active_ = false;
+    }
+
     // Anti-cogging is enabled after calibration
     // We get the current position and apply a current feed-forward
     // ensuring that we handle negative encoder positions properly (-1 == motor->encoder.encoder_cpr - 1)
     if (anticogging_valid_ && config_.anticogging.anticogging_enabled) {
-        torque += config_.anticogging.cogging_map[std::clamp(mod((int)anticogging_pos, 3600), 0, 3600)];
+        if (config_.anticogging.use_harmonic_model) {
+            torque += anticogging_harmonic_torque(anticogging_pos);
+        } else {
+            torque += anticogging_map_torque(anticogging_pos);
+        }
     }
 
     float v_err = 0.0f;
@@ -316,6 +997,12 @@ bool Controller::update(float* torque_setpoint_output) {
         torque = limitVel(config_.vel_limit, *vel_estimate_src, vel_gain, torque);
     }
 
+    // Filter chain, e.g. to notch out mechanical resonances
+    for (size_t i = 0; i < TORQUE_FILTER_COUNT; ++i) {
+        if (config_.torque_filter[i].type != TORQUE_FILTER_TYPE_NONE)
+            torque = torque_filters_[i].update(torque);
+    }
+
     // Torque limiting
     bool limited = false;
     float Tlim = axis_->motor_.max_available_torque();
@@ -337,10 +1024,11 @@ bool Controller::update(float* torque_setpoint_output) {
             // TODO make decayfactor configurable
             vel_integrator_torque_ *= 0.99f;
         } else {
-            vel_integrator_torque_ += ((vel_integrator_gain * gain_scheduling_multiplier) * current_meas_period) * v_err;
+            vel_integrator_torque_ += ((vel_integrator_gain * gain_scheduling_multiplier) * period_) * v_err;
         }
     }
 
+    torque_output_ = torque;
     if (torque_setpoint_output) *torque_setpoint_output = torque;
     return true;
 }
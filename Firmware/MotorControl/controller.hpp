@@ -3,17 +3,70 @@
 
 class Controller : public ODriveIntf::ControllerIntf {
 public:
+    static constexpr uint32_t ANTICOGGING_MAX_ENTRIES = 4096; // maximum size of the anticogging map
+    static constexpr uint32_t ANTICOGGING_MAX_HARMONICS = 24;
+    static constexpr float ANTICOGGING_SWEEP_LEAD = 0.05f; // [turns] travel before recording starts after a reversal
+    static constexpr uint32_t PVT_QUEUE_SIZE = 64; // must be a power of 2
+    static constexpr size_t VEL_GAIN_SCHEDULE_SIZE = 8;
+    static constexpr size_t TORQUE_FILTER_COUNT = 4;
+
+    // Point of a PVT (position, velocity, time) trajectory
+    struct PvtPoint_t {
+        float dt;     // [s] time since the previous point
+        float pos;    // [turns]
+        float vel;    // [turn/s]
+        float torque; // [Nm] feedforward torque
+    };
+
     typedef struct {
         uint32_t index = 0;
-        float cogging_map[3600];
         bool pre_calibrated = false;
         bool calib_anticogging = false;
         float calib_pos_threshold = 1.0f;
         float calib_vel_threshold = 1.0f;
         float cogging_ratio = 1.0f;
         bool anticogging_enabled = true;
+
+        // Sweep calibration: the axis turns back and forth at constant velocity
+        // while the torque command is averaged per map entry.
+        bool calib_sweep = true; // false: step through each map entry and wait for it to settle
+        float calib_sweep_vel = 0.2f; // [turn/s]
+        uint32_t calib_sweep_cycles = 2; // number of forward/backward revolution pairs
+        float calib_residual = 0.0f; // [Nm] RMS deviation of the last revolution from the previous ones
+
+        // Harmonic model: torque = sum(harmonic_cos[i] * cos(harmonic_order[i] * theta)
+        //                            + harmonic_sin[i] * sin(harmonic_order[i] * theta))
+        // where theta is the mechanical angle. Sorted by ascending order.
+        bool use_harmonic_model = true;
+        uint32_t max_harmonics = ANTICOGGING_MAX_HARMONICS; // number of harmonics to keep on calibration
+        uint32_t num_harmonics = 0; // number of valid harmonics
+        uint16_t harmonic_order[ANTICOGGING_MAX_HARMONICS] = {0}; // [cycles/turn]
+        float harmonic_cos[ANTICOGGING_MAX_HARMONICS] = {0.0f}; // [Nm]
+        float harmonic_sin[ANTICOGGING_MAX_HARMONICS] = {0.0f}; // [Nm]
     } Anticogging_t;
 
+    // Breakpoint of the velocity based gain schedule
+    struct GainSchedulePoint_t {
+        float vel = 0.0f;                       // [turn/s] absolute velocity estimate
+        float vel_gain_scale = 1.0f;            // multiplies vel_gain
+        float vel_integrator_gain_scale = 1.0f; // multiplies vel_integrator_gain
+    };
+
+    // Section of the filter chain on the torque command
+    struct TorqueFilterConfig_t {
+        TorqueFilterType type = TORQUE_FILTER_TYPE_NONE;
+        float freq = 100.0f;  // [Hz]
+        float q = 0.707f;
+        float gain = 0.0f;    // notch: gain at freq, lead-lag: high frequency gain
+
+        // custom setters
+        Controller* parent = nullptr;
+        void set_type(TorqueFilterType value) { type = value; parent->update_torque_filters(); }
+        void set_freq(float value) { freq = value; parent->update_torque_filters(); }
+        void set_q(float value) { q = value; parent->update_torque_filters(); }
+        void set_gain(float value) { gain = value; parent->update_torque_filters(); }
+    };
+
     struct Config_t {
         ControlMode control_mode = CONTROL_MODE_POSITION_CONTROL;  //see: ControlMode_t
         InputMode input_mode = INPUT_MODE_PASSTHROUGH;             //see: InputMode_t
@@ -28,21 +81,39 @@ public:
         bool circular_setpoints = false;
         float circular_setpoint_range = 1.0f; // Circular range when circular_setpoints is true. [turn]
         float inertia = 0.0f;                 // [Nm/(turn/s^2)]
+        float viscous_damping = 0.0f;         // [Nm/(turn/s)]
+        float coulomb_friction = 0.0f;        // [Nm]
+        bool enable_disturbance_observer = false;
+        float disturbance_observer_bandwidth = 300.0f; // [rad/s]
+        TorqueFilterConfig_t torque_filter[TORQUE_FILTER_COUNT];
         float input_filter_bandwidth = 2.0f;  // [1/s]
+        InputShaperType input_shaper_type = INPUT_SHAPER_TYPE_NONE;
+        float input_shaper_freq = 10.0f;      // [Hz] natural frequency of the resonance
+        float input_shaper_damping = 0.0f;    // damping ratio of the resonance
         float homing_speed = 0.25f;           // [turn/s]
         Anticogging_t anticogging;
         float gain_scheduling_width = 10.0f;
         bool enable_gain_scheduling = false;
+        bool enable_vel_gain_schedule = false;
+        GainSchedulePoint_t vel_gain_schedule[VEL_GAIN_SCHEDULE_SIZE]; // ends at the first non-ascending vel
         bool enable_vel_limit = true;
         bool enable_overspeed_error = true;
         bool enable_current_mode_vel_limit = true;  // enable velocity limit in current control mode (requires a valid velocity estimator)
         uint8_t axis_to_mirror = -1;
         float mirror_ratio = 1.0f;
         uint8_t load_encoder_axis = -1;  // default depends on Axis number and is set in load_configuration()
+        bool enable_dual_loop = false; // position from load_encoder_axis, velocity from the own encoder
+        float load_gear_ratio = 1.0f; // [motor turns / load turn]
+        float backlash_estimator_time = 2.0f; // [s]
+        uint32_t update_divider = 1; // runs every update_divider-th current control cycle
 
         // custom setters
         Controller* parent;
         void set_input_filter_bandwidth(float value) { input_filter_bandwidth = value; parent->update_filter_gains(); }
+        void set_input_shaper_type(InputShaperType value) { input_shaper_type = value; parent->update_input_shaper(); }
+        void set_input_shaper_freq(float value) { input_shaper_freq = value; parent->update_input_shaper(); }
+        void set_input_shaper_damping(float value) { input_shaper_damping = value; parent->update_input_shaper(); }
+        void set_update_divider(uint32_t value) { update_divider = std::max<uint32_t>(value, 1); parent->apply_config(); }
     };
 
     Controller() {}
@@ -62,11 +133,41 @@ public:
     void move_to_pos(float goal_point);
     void move_incremental(float displacement, bool from_goal_point);
     
+    // Header of the anticogging map in flash. It is followed by num_entries
+    // int16 values that are spaced evenly over one turn.
+    struct AnticoggingMapHeader_t {
+        uint32_t magic;
+        uint32_t num_entries;
+        float scale; // [Nm/LSB]
+        uint16_t crc16; // CRC of the entries
+        uint16_t reserved;
+    };
+    static constexpr uint32_t ANTICOGGING_MAP_MAGIC = 0x414d4331; // "AMC1"
+    static constexpr uint16_t ANTICOGGING_MAP_CRC16_INIT = 0xabcd;
+    static constexpr uint16_t ANTICOGGING_MAP_CRC16_POLYNOMIAL = 0x3d65;
+
     // TODO: make this more similar to other calibration loops
-    void start_anticogging_calibration();
+    bool start_anticogging_calibration();
     bool anticogging_calibration(float pos_estimate, float vel_estimate);
+    bool anticogging_sweep();
+    void anticogging_sweep_finish_bin();
+    void start_anticogging_fit();
+    bool anticogging_fit_harmonics();
+    float anticogging_harmonic_torque(float pos);
+    float anticogging_map_torque(float pos);
+    void load_anticogging_map();
+    bool save_anticogging_map();
+
+    // PVT queue (INPUT_MODE_PVT)
+    bool push_pvt_point(float dt, float pos, float vel, float torque);
+    void clear_pvt_queue();
+    uint32_t get_pvt_queue_fill() { return pvt_queue_tail_ - pvt_queue_head_; }
 
     void update_filter_gains();
+    void update_torque_filters();
+    void update_input_shaper();
+    void get_vel_gain_scale(float abs_vel, float* vel_gain_scale, float* vel_integrator_gain_scale);
+    void update_disturbance_observer(float vel);
     bool update(float* torque_setpoint);
 
     Config_t config_;
@@ -74,12 +175,17 @@ public:
 
     Error error_ = ERROR_NONE;
 
+    // Period of update(). The axis holds the torque setpoint in the current
+    // control cycles in between.
+    float period_ = current_meas_period; // [s]
+
     float* pos_estimate_linear_src_ = nullptr;
     float* pos_estimate_circular_src_ = nullptr;
     bool* pos_estimate_valid_src_ = nullptr;
     float* vel_estimate_src_ = nullptr;
     bool* vel_estimate_valid_src_ = nullptr;
     float* pos_wrap_src_ = nullptr; 
+    Encoder* pos_estimate_encoder_ = nullptr; // encoder behind pos_estimate_linear_src_, if any
 
 
     float pos_setpoint_ = 0.0f; // [turns]
@@ -87,6 +193,9 @@ public:
     // float vel_setpoint = 800.0f; <sensorless example>
     float vel_integrator_torque_ = 0.0f;    // [Nm]
     float torque_setpoint_ = 0.0f;  // [Nm]
+    float disturbance_torque_ = 0.0f;  // [Nm] load torque estimated by the disturbance observer
+    float dual_loop_vel_estimate_ = 0.0f; // [turn/s] load side velocity from the motor encoder
+    float load_deflection_ = 0.0f; // [turns] motor side minus load side position
 
     float input_pos_ = 0.0f;     // [turns]
     float input_vel_ = 0.0f;     // [turn/s]
@@ -98,8 +207,65 @@ public:
     
     bool trajectory_done_ = true;
 
+    // PVT queue. It is filled by push_pvt_point() from the communication
+    // thread and consumed by update(). The indices run freely and are wrapped
+    // on access.
+    PvtPoint_t pvt_queue_[PVT_QUEUE_SIZE];
+    volatile uint32_t pvt_queue_head_ = 0; // next point to be consumed
+    volatile uint32_t pvt_queue_tail_ = 0; // next free slot
+    PvtPoint_t pvt_prev_ = {}; // start of the current segment
+    float pvt_t_ = 0.0f; // [s] time since pvt_prev_
+    bool pvt_running_ = false;
+
     bool anticogging_valid_ = false;
 
+    BiquadFilter torque_filters_[TORQUE_FILTER_COUNT];
+
+    // The input shaper filters the setpoints of the trajectory and position
+    // filter input modes. These modes continue from the unshaped setpoints of
+    // the last cycle.
+    InputShaper input_shaper_;
+    InputShaper::Sample_t unshaped_setpoint_ = {0.0f, 0.0f, 0.0f};
+    bool input_shaper_active_ = false;
+
+    // Disturbance observer state: disturbance_torque_ + bandwidth * inertia * vel
+    float disturbance_observer_state_ = 0.0f; // [Nm]
+    bool disturbance_observer_active_ = false;
+
+    // Backlash and compliance between the motor and the load encoder in dual
+    // loop control
+    BacklashEstimator backlash_estimator_;
+
+    // Anticogging map in flash (nullptr if there is no valid map)
+    const AnticoggingMapHeader_t* anticogging_map_ = nullptr;
+
+    // Anticogging map recorded by the last calibration. It is allocated on
+    // the heap when the calibration starts and freed once it was saved to
+    // flash.
+    float* calib_map_ = nullptr;
+    uint32_t calib_map_size_ = 0;
+
+    // State of the sweep calibration
+    float sweep_start_ = 0.0f; // [turns] start of the recorded revolution
+    int sweep_start_bin_ = 0;
+    float sweep_pos_ = 0.0f; // [turns]
+    float sweep_dir_ = 1.0f;
+    uint32_t sweep_pass_ = 0; // number of completed revolutions
+    int sweep_bin_ = -1; // map entry that is currently being recorded
+    float sweep_bin_sum_ = 0.0f;
+    uint32_t sweep_bin_count_ = 0;
+    float sweep_dev_sum_ = 0.0f;
+    float sweep_dev_sq_sum_ = 0.0f;
+    uint32_t sweep_dev_count_ = 0;
+    float torque_output_ = 0.0f; // [Nm] torque command of the last control cycle
+
+    // State of the harmonic fit that runs after the map was recorded
+    bool anticogging_fitting_ = false;
+    uint32_t fit_order_ = 0;
+    uint32_t fit_index_ = 0;
+    float fit_acc_cos_ = 0.0f;
+    float fit_acc_sin_ = 0.0f;
+
     // custom setters
     void set_input_pos(float value) { input_pos_ = value; input_pos_updated(); }
 
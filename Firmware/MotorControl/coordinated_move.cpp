@@ -0,0 +1,166 @@
+#include "odrive_main.h"
+#include <Drivers/STM32/stm32_system.h>
+#include "move_blend.hpp"
+#include <atomic>
+
+/*
+ * Queues a move of all axes to the specified goal positions [turns].
+ *
+ * Returns false if the queue is full or an axis is not in
+ * INPUT_MODE_COORDINATED_TRAJ.
+ */
+bool CoordinatedMoveQueue::push(const float goals[AXIS_COUNT]) {
+    uint32_t tail = tail_;
+    if (get_fill() >= QUEUE_SIZE)
+        return false;
+
+    // A control loop that (re)starts an axis resets its end position, so
+    // this must not be interrupted between reading and writing end_.
+    CRITICAL_SECTION() {
+        // Limits of the path parameter
+        float vel_limit = INFINITY;
+        float accel_limit = INFINITY;
+        float decel_limit = INFINITY;
+        for (size_t i = 0; i < AXIS_COUNT; ++i) {
+            if (!is_active(i))
+                return false;
+            float distance = std::abs(goals[i] - end_[i]);
+            if (distance > 0.0f) {
+                vel_limit = std::min(vel_limit, axes[i].trap_traj_.config_.vel_limit / distance);
+                accel_limit = std::min(accel_limit, axes[i].trap_traj_.config_.accel_limit / distance);
+                decel_limit = std::min(decel_limit, axes[i].trap_traj_.config_.decel_limit / distance);
+            }
+        }
+        if (vel_limit == INFINITY)
+            return true; // already there
+
+        Move_t& move = moves_[tail % QUEUE_SIZE];
+        move.path.planTrapezoidal(1.0f, 0.0f, 0.0f, vel_limit, accel_limit, decel_limit);
+        for (size_t i = 0; i < AXIS_COUNT; ++i) {
+            move.start[i] = end_[i];
+            move.delta[i] = goals[i] - end_[i];
+            end_[i] = goals[i];
+        }
+        std::atomic_thread_fence(std::memory_order_release); // publish the move before the index
+        tail_ = tail + 1;
+    }
+    return true;
+}
+
+// @brief Starts consuming moves on the specified axis, which is at pos [turns].
+// Moves that were queued before are skipped on this axis.
+void CoordinatedMoveQueue::start(size_t axis, float pos) {
+    CRITICAL_SECTION() {
+        bool any_active = false;
+        for (size_t i = 0; i < AXIS_COUNT; ++i)
+            any_active = any_active || is_active(i);
+        if (!any_active)
+            cursor_ = {tail_, 0.0f, -1.0f};
+
+        AxisState_t& state = axis_states_[axis];
+        state.first = tail_;
+        state.hold_pos = pos;
+        end_[axis] = pos;
+        state.active = true;
+    }
+}
+
+// @brief Returns the number of moves that were not completed yet.
+uint32_t CoordinatedMoveQueue::get_fill() {
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        if (is_active(i))
+            return tail_ - cursor_.head;
+    }
+    return 0;
+}
+
+// @brief Returns true if the specified axis advances the shared cursor.
+// This is the first active axis whose motor is armed, such that the moves
+// continue if an axis stops running its controller.
+bool CoordinatedMoveQueue::is_pacer(size_t axis) {
+    for (size_t i = 0; i < axis; ++i) {
+        if (is_active(i) && axes[i].motor_.armed_state_ == Motor::ARMED_STATE_ARMED)
+            return false;
+    }
+    return true;
+}
+
+// @brief Advances the shared cursor by dt [s].
+// If the queue runs empty, the next move starts as soon as it arrives.
+void CoordinatedMoveQueue::advance(uint32_t tail, float dt) {
+    if (cursor_.head == tail) {
+        cursor_.t = 0.0f;
+        return;
+    }
+
+    // Blend into the next move once this one decelerates, as far as the
+    // summed profiles stay within the limits of all axes
+    const Move_t& move = moves_[cursor_.head % QUEUE_SIZE];
+    bool has_next = cursor_.head + 1 != tail;
+    if (has_next && cursor_.next_start < 0.0f) {
+        const Move_t& next = moves_[(cursor_.head + 1) % QUEUE_SIZE];
+        TrapezoidalTrajectory::Config_t limits[AXIS_COUNT];
+        for (size_t i = 0; i < AXIS_COUNT; ++i)
+            limits[i] = axes[i].trap_traj_.config_;
+        cursor_.next_start = blend_start(move.path, move.delta, next.path, next.delta,
+                                         limits, AXIS_COUNT, cursor_.t);
+    }
+
+    cursor_.t += dt;
+    if (cursor_.t > move.path.Tf_) {
+        // Continue with the next move
+        for (size_t i = 0; i < AXIS_COUNT; ++i) {
+            if (has_started(i, cursor_.head))
+                axis_states_[i].hold_pos = move.start[i] + move.delta[i];
+        }
+        cursor_.t = has_next ? cursor_.t - cursor_.next_start : 0.0f;
+        cursor_.next_start = -1.0f;
+        cursor_.head = cursor_.head + 1;
+    }
+}
+
+/*
+ * Returns the setpoints of the specified axis at the shared cursor. If this
+ * axis is the pacer, the cursor is then advanced by dt [s].
+ *
+ * If the queue runs empty, the axis holds the end of the last move.
+ */
+TrapezoidalTrajectory::Step_t CoordinatedMoveQueue::update(size_t axis, float dt) {
+    uint32_t tail;
+    Cursor_t cursor;
+    float hold_pos;
+    CRITICAL_SECTION() {
+        tail = tail_;
+        cursor = cursor_;
+        hold_pos = axis_states_[axis].hold_pos;
+        if (is_pacer(axis))
+            advance(tail, dt);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    TrapezoidalTrajectory::Step_t step = {hold_pos, 0.0f, 0.0f};
+    if (cursor.head == tail)
+        return step;
+
+    Move_t& move = moves_[cursor.head % QUEUE_SIZE];
+    if (has_started(axis, cursor.head)) {
+        TrapezoidalTrajectory::Step_t path_step = move.path.eval(cursor.t);
+        step = {
+            move.start[axis] + move.delta[axis] * path_step.Y,
+            move.delta[axis] * path_step.Yd,
+            move.delta[axis] * path_step.Ydd
+        };
+    }
+
+    bool has_next = cursor.head + 1 != tail;
+    if (has_next && cursor.next_start >= 0.0f && cursor.t >= cursor.next_start
+            && has_started(axis, cursor.head + 1)) {
+        Move_t& next = moves_[(cursor.head + 1) % QUEUE_SIZE];
+        TrapezoidalTrajectory::Step_t next_step = next.path.eval(cursor.t - cursor.next_start);
+        step.Y += next.delta[axis] * next_step.Y;
+        step.Yd += next.delta[axis] * next_step.Yd;
+        step.Ydd += next.delta[axis] * next_step.Ydd;
+    }
+
+    return step;
+}
@@ -0,0 +1,72 @@
+#ifndef __COORDINATED_MOVE_HPP
+#define __COORDINATED_MOVE_HPP
+
+/**
+ * @brief Queue of straight-line moves that are executed by all axes together
+ * (INPUT_MODE_COORDINATED_TRAJ).
+ *
+ * Each move is planned as a single trapezoidal profile of a path parameter
+ * that goes from 0 to 1. Its limits are chosen such that no axis exceeds its
+ * own trap_traj limits. All axes follow the same profile, scaled by their
+ * distance, so they start and finish together and the path is a straight
+ * line.
+ *
+ * A queued move starts as soon as the previous one starts to decelerate. The
+ * two profiles are superimposed, which rounds the corner instead of stopping
+ * there. The start is delayed as far as needed to keep the summed velocity
+ * and acceleration of every axis within its limits, so a move that reverses
+ * the previous one only starts when that one has stopped.
+ *
+ * Moves are pushed from the communication thread and consumed by the control
+ * loops of the axes. All axes follow one shared cursor, so they stay in step
+ * even after the queue ran empty. The cursor is advanced by the first active
+ * axis whose motor is armed, the others evaluate the moves at the same time.
+ */
+class CoordinatedMoveQueue {
+public:
+    static constexpr uint32_t QUEUE_SIZE = 8; // must be a power of 2
+
+    struct Move_t {
+        TrapezoidalTrajectory path;  // path parameter from 0 to 1
+        float start[AXIS_COUNT];     // [turns]
+        float delta[AXIS_COUNT];     // [turns]
+    };
+
+    bool push(const float goals[AXIS_COUNT]);
+    void start(size_t axis, float pos);
+    void stop(size_t axis) { axis_states_[axis].active = false; }
+    bool is_active(size_t axis) { return axis_states_[axis].active; }
+    TrapezoidalTrajectory::Step_t update(size_t axis, float dt);
+    uint32_t get_fill();
+
+private:
+    // Read position in the queue, shared by all axes
+    struct Cursor_t {
+        uint32_t head = 0;          // current move
+        float t = 0.0f;             // [s] time since the start of the current move
+        float next_start = -1.0f;   // [s] start time of the next move, negative if not yet started
+    };
+
+    struct AxisState_t {
+        volatile bool active = false;
+        uint32_t first = 0;         // first move that was queued after the axis started
+        float hold_pos = 0.0f;      // [turns] end of the last completed move
+    };
+
+    bool is_pacer(size_t axis);
+    bool has_started(size_t axis, uint32_t index) { return (int32_t)(index - axis_states_[axis].first) >= 0; }
+    void advance(uint32_t tail, float dt);
+
+    Move_t moves_[QUEUE_SIZE];
+    volatile uint32_t tail_ = 0;
+
+    // The following are shared between the communication thread and the
+    // control loops and only accessed in a critical section.
+    float end_[AXIS_COUNT] = {0.0f}; // [turns] end of the last queued move
+    Cursor_t cursor_;
+    AxisState_t axis_states_[AXIS_COUNT];
+};
+
+extern CoordinatedMoveQueue coordinated_moves; // defined in main.cpp
+
+#endif // __COORDINATED_MOVE_HPP
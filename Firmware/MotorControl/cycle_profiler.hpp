@@ -0,0 +1,92 @@
+#ifndef __CYCLE_PROFILER_HPP
+#define __CYCLE_PROFILER_HPP
+
+#include <board.h>
+#include <autogen/interfaces.hpp>
+
+// Number of CPU cycles per control loop iteration
+#define CYCLES_PER_CONTROL_PERIOD (2 * pwm_period_clocks * (pwm_rcr + 1))
+
+/**
+ * @brief Collects statistics about the number of CPU cycles spent in each
+ * stage of the control loop.
+ *
+ * The cycles are counted with the DWT cycle counter. Stages can be nested, in
+ * which case the outer stage includes the cycles of the inner stage.
+ *
+ * Each stage keeps a histogram of its samples. The buckets divide one control
+ * period into CycleProfiler::Stage::NUM_BUCKETS equal parts, with the last
+ * bucket also catching everything that took longer than one period.
+ */
+class CycleProfiler : public ODriveIntf::CycleProfilerIntf {
+public:
+    class Stage : public ODriveIntf::CycleProfilerIntf::StageIntf {
+    public:
+        static constexpr size_t NUM_BUCKETS = 16;
+
+        // The control period is configurable, so this is only known at runtime
+        static uint32_t bucket_width() { return CYCLES_PER_CONTROL_PERIOD / NUM_BUCKETS; }
+
+        void record(uint32_t cycles) {
+            if (cycles < min_)
+                min_ = cycles;
+            if (cycles > max_)
+                max_ = cycles;
+            sum_ += cycles;
+            count_++;
+            size_t bucket = cycles / bucket_width();
+            histogram_[bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1]++;
+        }
+
+        void reset() {
+            *this = Stage{};
+        }
+
+        float get_mean() {
+            return count_ ? (float)sum_ / (float)count_ : 0.0f;
+        }
+
+        uint32_t get_histogram(uint32_t bucket) override {
+            return bucket < NUM_BUCKETS ? histogram_[bucket] : 0;
+        }
+
+        uint32_t count_ = 0;
+        uint32_t min_ = UINT32_MAX;
+        uint32_t max_ = 0;
+        uint64_t sum_ = 0;
+        uint32_t histogram_[NUM_BUCKETS] = {0};
+    };
+
+    // @brief Measures the CPU cycles from construction to destruction of this
+    // object and records them in the specified stage.
+    class Measurement {
+    public:
+        Measurement(Stage& stage) : stage_(stage), start_(cpu_get_cycles()) {}
+        ~Measurement() { stage_.record(cpu_get_cycles() - start_); }
+    private:
+        Stage& stage_;
+        uint32_t start_;
+    };
+
+    void reset() override {
+        for (Stage* stage : {&adc_cb_, &foc_current_, &enqueue_modulation_timings_,
+                             &do_checks_, &do_updates_, &encoder_update_,
+                             &controller_update_, &update_handler_, &wait_for_current_meas_}) {
+            stage->reset();
+        }
+    }
+
+    uint32_t get_bucket_width() { return Stage::bucket_width(); }
+
+    Stage adc_cb_; // current measurement interrupt (pwm_trig_adc_cb)
+    Stage foc_current_;
+    Stage enqueue_modulation_timings_;
+    Stage do_checks_;
+    Stage do_updates_;
+    Stage encoder_update_;
+    Stage controller_update_;
+    Stage update_handler_;
+    Stage wait_for_current_meas_;
+};
+
+#endif // __CYCLE_PROFILER_HPP
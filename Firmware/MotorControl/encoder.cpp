@@ -101,6 +101,30 @@ void Encoder::enc_index_cb() {
     index_gpio_.unsubscribe();
 }
 
+// Triggered by the capture unit of the encoder timer on the first rising edge
+// of A after each sample (see sample_now()). This must run at the same
+// priority as sample_now().
+void Encoder::enc_edge_cb() {
+    uint32_t cycles = cpu_get_cycles();
+
+    // One edge per sample is enough. This also bounds the interrupt rate at
+    // high speed.
+    __HAL_TIM_DISABLE_IT(timer_, TIM_IT_CC1);
+    __HAL_TIM_CLEAR_IT(timer_, TIM_IT_CC1);
+
+    // The capture register holds the count right after the edge. When
+    // counting down, the edge lies at the upper end of that count.
+    int16_t count = (int16_t)timer_->Instance->CCR1;
+    bool down = timer_->Instance->CR1 & TIM_CR1_DIR;
+    if (down)
+        count++;
+
+    edge_count_ = count;
+    edge_cycles_ = cycles;
+    edge_down_ = down;
+    edge_captured_ = true;
+}
+
 void Encoder::set_idx_subscribe(bool override_enable) {
     if (config_.use_index && (override_enable || !config_.find_idx_on_lockin_only)) {
         if (!index_gpio_.subscribe(true, false, enc_index_cb_wrapper, this)) {
@@ -112,11 +136,8 @@ void Encoder::set_idx_subscribe(bool override_enable) {
 }
 
 void Encoder::update_pll_gains() {
-    pll_kp_ = 2.0f * config_.bandwidth;  // basic conversion to discrete time
-    pll_ki_ = 0.25f * (pll_kp_ * pll_kp_); // Critically damped
-
     // Check that we don't get problems with discrete time approximation
-    if (!(current_meas_period * pll_kp_ < 1.0f)) {
+    if (!pll_.set_bandwidth(config_.bandwidth, current_meas_period)) {
         set_error(ERROR_UNSTABLE_GAIN);
     }
 }
@@ -136,8 +157,13 @@ void Encoder::set_linear_count(int32_t count) {
 
     // Update states
     shadow_count_ = count;
+    pll_.phase_ = (int64_t)count << 32;
     pos_estimate_counts_ = (float)count;
     tim_cnt_sample_ = count;
+    // Captured edges refer to the old count
+    edge_captured_ = false;
+    edge_sampled_ = false;
+    last_edge_valid_ = false;
 
     //Write hardware last
     timer_->Instance->CNT = count;
@@ -208,7 +234,7 @@ bool Encoder::run_direction_find() {
 // TODO: Do the scan with current, not voltage!
 bool Encoder::run_offset_calibration() {
     const float start_lock_duration = 1.0f;
-    const int num_steps = (int)(config_.calib_scan_distance / config_.calib_scan_omega * (float)current_meas_hz);
+    const int num_steps = (int)(config_.calib_scan_distance / config_.calib_scan_omega * current_meas_hz);
 
     // Require index found if enabled
     if (config_.use_index && !index_found_) {
@@ -233,7 +259,6 @@ bool Encoder::run_offset_calibration() {
     axis_->run_control_loop([&](){
         if (!axis_->motor_.enqueue_voltage_timings(voltage_magnitude, 0.0f))
             return false; // error set inside enqueue_voltage_timings
-        axis_->motor_.log_timing(TIMING_LOG_ENC_CALIB);
         return ++i < start_lock_duration * current_meas_hz;
     });
     if (axis_->error_ != Axis::ERROR_NONE)
@@ -250,7 +275,6 @@ bool Encoder::run_offset_calibration() {
         float v_beta = voltage_magnitude * our_arm_sin_f32(phase);
         if (!axis_->motor_.enqueue_voltage_timings(v_alpha, v_beta))
             return false; // error set inside enqueue_voltage_timings
-        axis_->motor_.log_timing(TIMING_LOG_ENC_CALIB);
 
         encvaluesum += shadow_count_;
         
@@ -290,7 +314,6 @@ bool Encoder::run_offset_calibration() {
         float v_beta = voltage_magnitude * our_arm_sin_f32(phase);
         if (!axis_->motor_.enqueue_voltage_timings(v_alpha, v_beta))
             return false; // error set inside enqueue_voltage_timings
-        axis_->motor_.log_timing(TIMING_LOG_ENC_CALIB);
 
         encvaluesum += shadow_count_;
         
@@ -323,6 +346,25 @@ void Encoder::sample_now() {
     switch (mode_) {
         case MODE_INCREMENTAL: {
             tim_cnt_sample_ = (int16_t)timer_->Instance->CNT;
+            tim_cnt_sample_cycles_ = cpu_get_cycles();
+
+            if (config_.enable_edge_timing) {
+                // Hand the edge of the last period to update() and re-arm
+                // the capture
+                if (edge_captured_) {
+                    edge_sample_count_ = edge_count_;
+                    edge_sample_cycles_ = edge_cycles_;
+                    edge_sample_down_ = edge_down_;
+                    edge_sampled_ = true;
+                    edge_captured_ = false;
+                }
+                if (!(timer_->Instance->DIER & TIM_IT_CC1)) {
+                    __HAL_TIM_CLEAR_IT(timer_, TIM_IT_CC1);
+                    __HAL_TIM_ENABLE_IT(timer_, TIM_IT_CC1);
+                }
+            } else {
+                __HAL_TIM_DISABLE_IT(timer_, TIM_IT_CC1);
+            }
         } break;
 
         case MODE_HALL: {
@@ -339,7 +381,6 @@ void Encoder::sample_now() {
         case MODE_SPI_ABS_AEAT:
         case MODE_SPI_ABS_RLS:
         {
-            axis_->motor_.log_timing(TIMING_LOG_SAMPLE_NOW);
             // Do nothing
         } break;
 
@@ -370,8 +411,6 @@ void Encoder::decode_hall_samples() {
 
 bool Encoder::abs_spi_start_transaction(){
     if (mode_ & MODE_FLAG_ABS){
-        axis_->motor_.log_timing(TIMING_LOG_SPI_START);
-        
         if (Stm32SpiArbiter::acquire_task(&spi_task_)) {
             spi_task_.ncs_gpio = abs_spi_cs_gpio_;
             spi_task_.tx_buf = (uint8_t*)abs_spi_dma_tx_;
@@ -411,8 +450,6 @@ void Encoder::abs_spi_cb(bool success) {
         goto done;
     }
 
-    axis_->motor_.log_timing(TIMING_LOG_SPI_END);
-
     switch (mode_) {
         case MODE_SPI_ABS_AMS: {
             uint16_t rawVal = abs_spi_dma_rx_[0];
@@ -462,7 +499,67 @@ void Encoder::abs_spi_cs_pin_init(){
     abs_spi_cs_gpio_.write(true);
 }
 
+/*
+ * Estimates the position inside the current count from the time of the last
+ * captured edge of A (M/T method).
+ *
+ * The velocity is the distance between the last two captured edges divided by
+ * the time between them. The position at the time of the sample is
+ * extrapolated from the last edge with that velocity, limited such that it
+ * stays inside the current count. This also lets the velocity decay to zero
+ * when the next edge doesn't arrive.
+ *
+ * @param interpolation: position inside the current count, in [0, 1]
+ * @returns false if there is no recent edge
+ */
+bool Encoder::update_edge_timing(float* interpolation) {
+    const float seconds_per_cycle = 1.0f / (float)TIM_1_8_CLOCK_HZ; // the CPU runs at the timer clock
+
+    if (edge_sampled_) {
+        edge_sampled_ = false;
+        int32_t edge_pos = shadow_count_ + (int16_t)(edge_sample_count_ - tim_cnt_sample_);
+        if (last_edge_valid_) {
+            float dt = (float)(edge_sample_cycles_ - last_edge_cycles_) * seconds_per_cycle;
+            // Edges in different directions mean that the axis reversed in
+            // between
+            bool reversed = edge_sample_down_ != last_edge_down_;
+            edge_vel_ = (reversed || !(dt > 0.0f)) ? 0.0f : (float)(edge_pos - last_edge_pos_) / dt;
+        }
+        last_edge_pos_ = edge_pos;
+        last_edge_cycles_ = edge_sample_cycles_;
+        last_edge_down_ = edge_sample_down_;
+        last_edge_valid_ = true;
+    }
+
+    float time_since_edge = (float)(tim_cnt_sample_cycles_ - last_edge_cycles_) * seconds_per_cycle;
+    if (!last_edge_valid_ || time_since_edge > EDGE_TIMEOUT) {
+        last_edge_valid_ = false;
+        edge_vel_ = 0.0f;
+        return false;
+    }
+
+    // If the count is back behind the last edge, the axis reversed since then
+    // and the edge says nothing about the current count
+    if (last_edge_down_ ? (shadow_count_ >= last_edge_pos_) : (shadow_count_ < last_edge_pos_)) {
+        edge_vel_ = 0.0f;
+        return false;
+    }
+
+    // The axis moved at least to the start of the current count and not yet
+    // past its end since the edge, which bounds the velocity
+    if (time_since_edge > 0.0f) {
+        float min_vel = (float)(shadow_count_ - last_edge_pos_) / time_since_edge;
+        float max_vel = (float)(shadow_count_ + 1 - last_edge_pos_) / time_since_edge;
+        edge_vel_ = std::clamp(edge_vel_, min_vel, max_vel);
+    }
+    float pos = (float)(last_edge_pos_ - shadow_count_) + edge_vel_ * time_since_edge;
+    *interpolation = std::clamp(pos, 0.0f, 1.0f);
+    return true;
+}
+
 bool Encoder::update() {
+    CycleProfiler::Measurement measurement(axis_->profiler_.encoder_update_);
+
     // update internal encoder state.
     int32_t delta_enc = 0;
     int32_t pos_abs_latched = pos_abs_; //LATCH
@@ -539,24 +636,43 @@ bool Encoder::update() {
     // Memory for pos_circular
     float pos_cpr_counts_last = pos_cpr_counts_;
 
-    //// run pll (for now pll is in units of encoder counts)
+    //// run pll (in units of encoder counts)
     // Predict current pos
-    pos_estimate_counts_ += current_meas_period * vel_estimate_counts_;
-    pos_cpr_counts_      += current_meas_period * vel_estimate_counts_;
+    pll_.predict(current_meas_period);
+    // With edge timing the position inside the count is known as well
+    float edge_interpolation = 0.0f;
+    bool edge_timing = false;
+    if (mode_ == MODE_INCREMENTAL && config_.enable_edge_timing) {
+        edge_timing = update_edge_timing(&edge_interpolation);
+    } else {
+        last_edge_valid_ = false;
+    }
     // discrete phase detector
-    float delta_pos_counts = (float)(shadow_count_ - (int32_t)std::floor(pos_estimate_counts_));
-    float delta_pos_cpr_counts = (float)(count_in_cpr_ - (int32_t)std::floor(pos_cpr_counts_));
-    delta_pos_cpr_counts = wrap_pm(delta_pos_cpr_counts, 0.5f * (float)(config_.cpr));
+    int64_t count_start = (int64_t)shadow_count_ << 32;
+    float delta_pos_counts;
+    if (edge_timing) {
+        delta_pos_counts = pll_.error(count_start + Pll<int64_t>::from_float(edge_interpolation));
+    } else {
+        delta_pos_counts = (float)(shadow_count_ - (int32_t)(pll_.phase_ >> 32)); // floor of the estimate
+    }
     // pll feedback
-    pos_estimate_counts_ += current_meas_period * pll_kp_ * delta_pos_counts;
-    pos_cpr_counts_ += current_meas_period * pll_kp_ * delta_pos_cpr_counts;
-    pos_cpr_counts_ = fmodf_pos(pos_cpr_counts_, (float)(config_.cpr));
-    vel_estimate_counts_ += current_meas_period * pll_ki_ * delta_pos_cpr_counts;
+    pll_.correct(delta_pos_counts, current_meas_period);
     bool snap_to_zero_vel = false;
-    if (std::abs(vel_estimate_counts_) < 0.5f * current_meas_period * pll_ki_) {
-        vel_estimate_counts_ = 0.0f;  //align delta-sigma on zero to prevent jitter
+    // With edge timing the phase detector is not quantized, so there is no
+    // delta-sigma jitter to suppress
+    if (!edge_timing && std::abs(pll_.vel_) < 0.5f * current_meas_period * pll_.ki()) {
+        pll_.vel_ = 0.0f;  //align delta-sigma on zero to prevent jitter
         snap_to_zero_vel = true;
     }
+    vel_estimate_counts_ = pll_.vel_;
+    pos_estimate_counts_ = Pll<int64_t>::to_float(pll_.phase_);
+    // The circular estimate keeps the same distance to count_in_cpr_ as the
+    // linear one to shadow_count_
+    pos_cpr_counts_ = (float)count_in_cpr_ + Pll<int64_t>::to_float(pll_.phase_ - count_start);
+    if (pos_cpr_counts_ < 0.0f)
+        pos_cpr_counts_ += (float)config_.cpr;
+    else if (pos_cpr_counts_ >= (float)config_.cpr)
+        pos_cpr_counts_ -= (float)config_.cpr;
 
     // Outputs from Encoder for Controller
     pos_estimate_ = pos_estimate_counts_ / (float)config_.cpr;
@@ -566,8 +682,10 @@ bool Encoder::update() {
 
     //// run encoder count interpolation
     int32_t corrected_enc = count_in_cpr_ - config_.offset;
+    if (edge_timing && config_.enable_phase_interpolation) {
+        interpolation_ = edge_interpolation;
     // if we are stopped, make sure we don't randomly drift
-    if (snap_to_zero_vel || !config_.enable_phase_interpolation) {
+    } else if (snap_to_zero_vel || !config_.enable_phase_interpolation) {
         interpolation_ = 0.5f;
     // reset interpolation if encoder edge comes
     // TODO: This isn't correct. At high velocities the first phase in this count may very well not be at the edge.
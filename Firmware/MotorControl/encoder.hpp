@@ -4,12 +4,14 @@
 #include <arm_math.h>
 #include <Drivers/STM32/stm32_spi_arbiter.hpp>
 #include "utils.hpp"
+#include "pll.hpp"
 #include <autogen/interfaces.hpp>
 
 
 class Encoder : public ODriveIntf::EncoderIntf {
 public:
     static constexpr uint32_t MODE_FLAG_ABS = 0x100;
+    static constexpr float EDGE_TIMEOUT = 1.0f; // [s] edges older than this are not used for edge timing
 
     struct Config_t {
         Mode mode = MODE_INCREMENTAL;
@@ -24,6 +26,7 @@ public:
         int32_t offset = 0;        // Offset between encoder count and rotor electrical phase
         float offset_float = 0.0f; // Sub-count phase alignment offset
         bool enable_phase_interpolation = true; // Use velocity to interpolate inside the count state
+        bool enable_edge_timing = false; // Incremental only: measure the time of the A edges for sub-count position and velocity
         float calib_range = 0.02f; // Accuracy required to pass encoder cpr check
         float calib_scan_distance = 16.0f * M_PI; // rad electrical
         float calib_scan_omega = 4.0f * M_PI; // rad/s electrical
@@ -54,6 +57,7 @@ public:
     bool do_checks();
 
     void enc_index_cb();
+    void enc_edge_cb();
     void set_idx_subscribe(bool override_enable = false);
     void update_pll_gains();
     void check_pre_calibrated();
@@ -68,8 +72,18 @@ public:
     void sample_now();
     bool read_sampled_gpio(Stm32Gpio gpio);
     void decode_hall_samples();
+    bool update_edge_timing(float* interpolation);
     bool update();
 
+    // @brief Returns pos [turn] minus the linear position estimate [turn].
+    // The difference is taken on the fixed-point phase of the PLL, so the
+    // estimate doesn't add the rounding of pos_estimate_. The float setpoint
+    // itself still loses resolution far away from zero.
+    float pos_error(float pos) const {
+        float cpr = (float)config_.cpr;
+        return Pll<int64_t>::to_float(Pll<int64_t>::from_float(pos * cpr) - pll_.phase_) / cpr;
+    }
+
     TIM_HandleTypeDef* timer_;
     Stm32Gpio index_gpio_;
     Stm32Gpio hallA_gpio_;
@@ -90,8 +104,7 @@ public:
     float pos_estimate_counts_ = 0.0f;  // [count]
     float pos_cpr_counts_ = 0.0f;  // [count]
     float vel_estimate_counts_ = 0.0f;  // [count/s]
-    float pll_kp_ = 0.0f;   // [count/s / count]
-    float pll_ki_ = 0.0f;   // [(count/s^2) / count]
+    Pll<int64_t> pll_;          // [count]
     float calib_scan_response_ = 0.0f; // debug report from offset calib
     int32_t pos_abs_ = 0;
     float spi_error_rate_ = 0.0f;
@@ -104,6 +117,25 @@ public:
     bool vel_estimate_valid_ = false;
 
     int16_t tim_cnt_sample_ = 0; // 
+    uint32_t tim_cnt_sample_cycles_ = 0; // CPU cycle counter when tim_cnt_sample_ was taken
+
+    // Edge timing: the capture interrupt records the first rising edge of A
+    // after each sample. Written by enc_edge_cb().
+    volatile bool edge_captured_ = false;
+    volatile int16_t edge_count_ = 0; // [count] position of the edge in timer counts
+    volatile uint32_t edge_cycles_ = 0; // CPU cycle counter at the edge
+    volatile bool edge_down_ = false; // the edge was passed counting down
+    // Edge that was captured before the last sample. Written by sample_now().
+    bool edge_sampled_ = false;
+    int16_t edge_sample_count_ = 0;
+    uint32_t edge_sample_cycles_ = 0;
+    bool edge_sample_down_ = false;
+    // Last two edges, processed by update()
+    bool last_edge_valid_ = false;
+    int32_t last_edge_pos_ = 0; // [count] linear position
+    uint32_t last_edge_cycles_ = 0;
+    bool last_edge_down_ = false;
+    float edge_vel_ = 0.0f; // [count/s] average velocity between the last two edges
     static const constexpr GPIO_TypeDef* ports_to_sample[] = { GPIOA, GPIOB, GPIOC };
     uint16_t port_samples_[sizeof(ports_to_sample) / sizeof(ports_to_sample[0])];
     // Updated by low_level pwm_adc_cb
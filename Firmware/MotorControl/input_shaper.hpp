@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Convolves a stream of position, velocity and torque setpoints with a
+ * short sequence of impulses, such that the shaped setpoints don't excite a
+ * resonance at the specified frequency.
+ *
+ * The impulses are spread over up to one damped period of the resonance. To
+ * cover long periods with little memory, the input is recorded only every
+ * decimation_ samples. The setpoints in between are interpolated: the
+ * position with a cubic Hermite spline (using the recorded velocity), the
+ * velocity and torque linearly.
+ */
+class InputShaper {
+public:
+    static constexpr size_t MAX_IMPULSES = 3;
+    static constexpr size_t HISTORY_SIZE = 128; // must be a power of 2
+    static constexpr float EI_TOLERANCE = 0.05f; // residual vibration the EI shaper allows at the nominal frequency
+
+    struct Sample_t {
+        float pos;    // [turns]
+        float vel;    // [turn/s]
+        float torque; // [Nm]
+    };
+
+    // @brief Passes the input through unchanged.
+    void set_passthrough() {
+        const float amplitudes[] = {1.0f};
+        const float delays[] = {0.0f};
+        set_impulses(amplitudes, delays, 1, 1.0f);
+    }
+
+    // @brief Zero vibration shaper: two impulses over half a period.
+    // @param freq: undamped natural frequency of the resonance [Hz]
+    // @param damping: damping ratio of the resonance, 0 <= damping < 1
+    // @returns false if the parameters are invalid, in which case the input
+    // is passed through.
+    bool set_zv(float freq, float damping, float sample_rate) {
+        float k, half_period;
+        if (!get_resonance(freq, damping, sample_rate, &k, &half_period))
+            return set_passthrough(), false;
+        const float amplitudes[] = {1.0f, k};
+        const float delays[] = {0.0f, half_period};
+        set_impulses(amplitudes, delays, 2, sample_rate);
+        return true;
+    }
+
+    // @brief Zero vibration and derivative shaper: three impulses over one
+    // period. Less sensitive to errors in the frequency than ZV.
+    // @returns false if the parameters are invalid, in which case the input
+    // is passed through.
+    bool set_zvd(float freq, float damping, float sample_rate) {
+        float k, half_period;
+        if (!get_resonance(freq, damping, sample_rate, &k, &half_period))
+            return set_passthrough(), false;
+        const float amplitudes[] = {1.0f, 2.0f * k, k * k};
+        const float delays[] = {0.0f, half_period, 2.0f * half_period};
+        set_impulses(amplitudes, delays, 3, sample_rate);
+        return true;
+    }
+
+    // @brief Extra insensitive shaper: three impulses over one period that
+    // allow EI_TOLERANCE of the vibration at the nominal frequency in
+    // exchange for a wider band of suppression than ZVD.
+    // @returns false if the parameters are invalid, in which case the input
+    // is passed through.
+    bool set_ei(float freq, float damping, float sample_rate) {
+        float k, half_period;
+        if (!get_resonance(freq, damping, sample_rate, &k, &half_period))
+            return set_passthrough(), false;
+        float a1 = 0.25f * (1.0f + EI_TOLERANCE);
+        const float amplitudes[] = {a1, 0.5f * (1.0f - EI_TOLERANCE) * k, a1 * k * k};
+        const float delays[] = {0.0f, half_period, 2.0f * half_period};
+        set_impulses(amplitudes, delays, 3, sample_rate);
+        return true;
+    }
+
+    // @brief Fills the history with the specified sample, so that the output
+    // starts there without a transient.
+    void reset(const Sample_t& sample) {
+        std::fill(history_, history_ + HISTORY_SIZE, sample);
+        head_ = 0;
+        cycles_since_record_ = 0;
+    }
+
+    Sample_t update(const Sample_t& input) {
+        if (++cycles_since_record_ >= decimation_) {
+            head_ = (head_ + 1) % HISTORY_SIZE;
+            history_[head_] = input;
+            cycles_since_record_ = 0;
+        }
+
+        Sample_t output = {0.0f, 0.0f, 0.0f};
+        for (size_t i = 0; i < num_impulses_; ++i) {
+            Sample_t delayed = get_delayed(input, delays_[i]);
+            output.pos += amplitudes_[i] * delayed.pos;
+            output.vel += amplitudes_[i] * delayed.vel;
+            output.torque += amplitudes_[i] * delayed.torque;
+        }
+        return output;
+    }
+
+private:
+    // @brief Computes the amplitude ratio k of consecutive impulses and half
+    // of the damped period [s] of the resonance.
+    static bool get_resonance(float freq, float damping, float sample_rate, float* k, float* half_period) {
+        if (!(freq > 0.0f) || !(damping >= 0.0f) || !(damping < 1.0f) || !(sample_rate > 0.0f))
+            return false;
+        float damped_ratio = sqrtf(1.0f - damping * damping);
+        *k = expf(-damping * (float)M_PI / damped_ratio);
+        *half_period = 0.5f / (freq * damped_ratio);
+        return true;
+    }
+
+    // @param delays: [s], ascending, delays[0] must be 0
+    void set_impulses(const float* amplitudes, const float* delays, size_t num_impulses, float sample_rate) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < num_impulses; ++i)
+            sum += amplitudes[i];
+        for (size_t i = 0; i < num_impulses; ++i) {
+            amplitudes_[i] = amplitudes[i] / sum;
+            delays_[i] = delays[i] * sample_rate;
+        }
+        num_impulses_ = num_impulses;
+        period_ = 1.0f / sample_rate;
+
+        // The oldest record must reach back to the longest delay
+        float max_delay = delays_[num_impulses - 1];
+        uint32_t decimation = std::max(1, (int)ceilf(max_delay / (float)(HISTORY_SIZE - 1)));
+        if (decimation != decimation_) {
+            // The recorded samples are no longer spaced correctly
+            decimation_ = decimation;
+            reset(history_[head_]);
+        }
+    }
+
+    // @brief Returns the input as it was the specified number of samples ago.
+    Sample_t get_delayed(const Sample_t& input, float delay) {
+        if (delay <= 0.0f)
+            return input;
+
+        // Find the two samples around the delay. The current input counts as
+        // the newest one.
+        const Sample_t* newer;
+        const Sample_t* older;
+        float interval; // [samples] between newer and older
+        float frac;     // of the interval from older to the delayed sample
+        if (delay <= (float)cycles_since_record_) {
+            newer = &input;
+            older = &history_[head_];
+            interval = (float)cycles_since_record_;
+            frac = 1.0f - delay / interval;
+        } else {
+            float pos = (delay - (float)cycles_since_record_) / (float)decimation_;
+            size_t index = std::min((size_t)pos, HISTORY_SIZE - 2);
+            newer = &history_[(head_ - index) % HISTORY_SIZE];
+            older = &history_[(head_ - index - 1) % HISTORY_SIZE];
+            interval = (float)decimation_;
+            frac = 1.0f - (pos - (float)index);
+        }
+
+        // Cubic Hermite interpolation of the position, linear of the rest
+        float h = interval * period_;
+        float dp = newer->pos - older->pos;
+        float m0 = h * older->vel;
+        float m1 = h * newer->vel;
+        float c2 = 3.0f * dp - 2.0f * m0 - m1;
+        float c3 = m0 + m1 - 2.0f * dp;
+        return {
+            older->pos + frac * (m0 + frac * (c2 + frac * c3)),
+            older->vel + frac * (newer->vel - older->vel),
+            older->torque + frac * (newer->torque - older->torque)
+        };
+    }
+
+    float amplitudes_[MAX_IMPULSES] = {1.0f};
+    float delays_[MAX_IMPULSES] = {0.0f}; // [samples]
+    size_t num_impulses_ = 1;
+    float period_ = 1.0f; // [s]
+
+    Sample_t history_[HISTORY_SIZE] = {};
+    size_t head_ = 0; // index of the newest record
+    uint32_t decimation_ = 1; // samples per record
+    uint32_t cycles_since_record_ = 0;
+};
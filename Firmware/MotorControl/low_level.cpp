@@ -27,6 +27,14 @@ constexpr float adc_full_scale = static_cast<float>(1UL << 12UL);
 constexpr float adc_ref_voltage = 3.3f;
 /* Global variables ----------------------------------------------------------*/
 
+// Set by apply_pwm_config(). The defaults must be constant expressions,
+// because the statically constructed objects can already use them.
+uint32_t pwm_period_clocks = TIM_1_8_PERIOD_CLOCKS;
+uint32_t pwm_deadtime_clocks = TIM_1_8_DEADTIME_CLOCKS;
+uint32_t pwm_rcr = TIM_1_8_RCR;
+float current_meas_period = (float)(2 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1)) / (float)TIM_1_8_CLOCK_HZ;
+float current_meas_hz = (float)TIM_1_8_CLOCK_HZ / (float)(2 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1));
+
 // This value is updated by the DC-bus reading ADC.
 // Arbitrary non-zero inital value to avoid division by zero if ADC reading is late
 float vbus_voltage = 12.0f;
@@ -187,6 +195,43 @@ void safety_critical_apply_brake_resistor_timings(uint32_t low_off, uint32_t hig
 
 /* Function implementations --------------------------------------------------*/
 
+// @brief Derives the PWM and control timing from the config. This must run
+// before the timers are initialized and before the axes are configured,
+// since they derive their gains and filters from current_meas_period.
+// @returns false if the config is out of range, in which case the defaults
+// are used.
+bool apply_pwm_config() {
+    const BoardConfig_t& config = odrv.config_;
+    float period_clocks = roundf((float)TIM_1_8_CLOCK_HZ / (2.0f * config.pwm_freq));
+    float deadtime_clocks = roundf(config.pwm_dead_time * (float)TIM_1_8_CLOCK_HZ);
+
+    // The control loop runs every odd number of PWM periods, such that the
+    // timer update events alternate between the bottom (current
+    // measurement) and the top (DC calibration) of the counter. At least 3
+    // periods are needed to leave the control loop of one motor time to
+    // run before its timings are loaded in the interrupt of the other one.
+    float pwm_cycles = std::max(ceilf(config.pwm_freq / config.control_freq), 3.0f);
+    if (fmodf(pwm_cycles, 2.0f) == 0.0f)
+        pwm_cycles += 1.0f;
+
+    bool valid = period_clocks >= 1000.0f && period_clocks <= 65535.0f // 1.3kHz to 84kHz
+              && deadtime_clocks >= 1.0f && deadtime_clocks <= 127.0f // DTG with 1 clock resolution
+              && config.control_freq > 0.0f && pwm_cycles <= 256.0f; // 8 bit repetition counter
+
+    if (valid) {
+        pwm_period_clocks = (uint32_t)period_clocks;
+        pwm_deadtime_clocks = (uint32_t)deadtime_clocks;
+        pwm_rcr = (uint32_t)pwm_cycles - 1;
+    } else {
+        pwm_period_clocks = TIM_1_8_PERIOD_CLOCKS;
+        pwm_deadtime_clocks = TIM_1_8_DEADTIME_CLOCKS;
+        pwm_rcr = TIM_1_8_RCR;
+    }
+    current_meas_period = (float)(2 * pwm_period_clocks * (pwm_rcr + 1)) / (float)TIM_1_8_CLOCK_HZ;
+    current_meas_hz = (float)TIM_1_8_CLOCK_HZ / (float)(2 * pwm_period_clocks * (pwm_rcr + 1));
+    return valid;
+}
+
 void start_adc_pwm() {
     // Disarm motors
     for (size_t i = 0; i < AXIS_COUNT; ++i) {
@@ -195,7 +240,7 @@ void start_adc_pwm() {
 
     for (Motor& motor: motors) {
         // Init PWM
-        int half_load = TIM_1_8_PERIOD_CLOCKS / 2;
+        int half_load = pwm_period_clocks / 2;
         motor.timer_->Instance->CCR1 = half_load;
         motor.timer_->Instance->CCR2 = half_load;
         motor.timer_->Instance->CCR3 = half_load;
@@ -383,7 +428,7 @@ void vbus_sense_adc_cb(ADC_HandleTypeDef* hadc, bool injected) {
 // TODO: Document how the phasing is done, link to timing diagram
 void pwm_trig_adc_cb(ADC_HandleTypeDef* hadc, bool injected) {
 #define calib_tau 0.2f  //@TOTO make more easily configurable
-    constexpr float calib_filter_k = CURRENT_MEAS_PERIOD / calib_tau;
+    const float calib_filter_k = current_meas_period / calib_tau;
 
     // Ensure ADCs are expected ones to simplify the logic below
     if (!(hadc == &hadc2 || hadc == &hadc3)) {
@@ -401,11 +446,7 @@ void pwm_trig_adc_cb(ADC_HandleTypeDef* hadc, bool injected) {
     bool counting_down = axis.motor_.timer_->Instance->CR1 & TIM_CR1_DIR;
     bool current_meas_not_DC_CAL = !counting_down;
 
-    // Check the timing of the sequencing
-    if (current_meas_not_DC_CAL)
-        axis.motor_.log_timing(TIMING_LOG_ADC_CB_I);
-    else
-        axis.motor_.log_timing(TIMING_LOG_ADC_CB_DC);
+    CycleProfiler::Measurement measurement(axis.profiler_.adc_cb_);
 
     bool update_timings = false;
     if (hadc == &hadc2) {
@@ -471,10 +512,15 @@ void pwm_trig_adc_cb(ADC_HandleTypeDef* hadc, bool injected) {
         axis.signal_current_meas();
     } else {
         // DC_CAL measurement
+        // A leg that is clamped to the low side for the whole period (see
+        // Motor::clamp_pwm_timings) carries its current through the shunt
+        // at this point, so the offset is only updated from the others.
         if (hadc == &hadc2) {
-            axis.motor_.DC_calib_.phB += (current - axis.motor_.DC_calib_.phB) * calib_filter_k;
+            if (axis.motor_.timer_->Instance->CCR2 < pwm_period_clocks)
+                axis.motor_.DC_calib_.phB += (current - axis.motor_.DC_calib_.phB) * calib_filter_k;
         } else {
-            axis.motor_.DC_calib_.phC += (current - axis.motor_.DC_calib_.phC) * calib_filter_k;
+            if (axis.motor_.timer_->Instance->CCR3 < pwm_period_clocks)
+                axis.motor_.DC_calib_.phC += (current - axis.motor_.DC_calib_.phC) * calib_filter_k;
         }
     }
 }
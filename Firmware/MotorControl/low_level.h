@@ -40,6 +40,7 @@ void pwm_in_cb(TIM_HandleTypeDef *htim);
 }
 
 // Initalisation
+bool apply_pwm_config();
 void start_adc_pwm();
 void start_pwm(TIM_HandleTypeDef* htim);
 void sync_timers(TIM_HandleTypeDef* htim_a, TIM_HandleTypeDef* htim_b,
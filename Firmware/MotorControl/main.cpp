@@ -33,6 +33,7 @@ extern char _estack; // provided by the linker script
 ODriveCAN::Config_t can_config;
 ODriveCAN *odCAN = nullptr;
 ODrive odrv{};
+CoordinatedMoveQueue coordinated_moves;
 
 
 ConfigManager config_manager;
@@ -49,6 +50,7 @@ static bool config_read_all() {
                   config_manager.read(&axes[i].min_endstop_.config_) &&
                   config_manager.read(&axes[i].max_endstop_.config_) &&
                   config_manager.read(&axes[i].mechanical_brake_.config_) &&
+                  config_manager.read(&axes[i].autotuner_.config_) &&
                   config_manager.read(&motors[i].config_) &&
                   config_manager.read(&fet_thermistors[i].config_) &&
                   config_manager.read(&axes[i].motor_thermistor_.config_) &&
@@ -69,6 +71,7 @@ static bool config_write_all() {
                   config_manager.write(&axes[i].min_endstop_.config_) &&
                   config_manager.write(&axes[i].max_endstop_.config_) &&
                   config_manager.write(&axes[i].mechanical_brake_.config_) &&
+                  config_manager.write(&axes[i].autotuner_.config_) &&
                   config_manager.write(&motors[i].config_) &&
                   config_manager.write(&fet_thermistors[i].config_) &&
                   config_manager.write(&axes[i].motor_thermistor_.config_) &&
@@ -89,6 +92,7 @@ static void config_clear_all() {
         axes[i].min_endstop_.config_ = {};
         axes[i].max_endstop_.config_ = {};
         axes[i].mechanical_brake_.config_ = {};
+        axes[i].autotuner_.config_ = {};
         motors[i].config_ = {};
         fet_thermistors[i].config_ = {};
         axes[i].motor_thermistor_.config_ = {};
@@ -97,6 +101,9 @@ static void config_clear_all() {
 }
 
 static bool config_apply_all() {
+    // The PWM timing goes first, the axes derive their gains and filters
+    // from current_meas_period.
+    odrv.misconfigured_ = !apply_pwm_config();
     bool success = true;
     for (size_t i = 0; (i < AXIS_COUNT) && success; ++i) {
         success = encoders[i].apply_config(motors[i].config_.motor_type)
@@ -124,6 +131,12 @@ void ODrive::save_configuration(void) {
     }
 }
 
+bool ODrive::move_coordinated(float pos0, float pos1) {
+    static_assert(AXIS_COUNT == 2, "move_coordinated() takes one position per axis");
+    float goals[AXIS_COUNT] = {pos0, pos1};
+    return coordinated_moves.push(goals);
+}
+
 void ODrive::erase_configuration(void) {
     NVM_erase();
 
@@ -137,7 +150,7 @@ void ODrive::erase_configuration(void) {
 
 void ODrive::enter_dfu_mode() {
     if ((hw_version_major_ == 3) && (hw_version_minor_ >= 5)) {
-        __asm volatile ("CPSID I\n\t":::"memory"); // disable interrupts
+        __disable_irq();
         _reboot_cookie = 0xDEADBEEF;
         NVIC_SystemReset();
     } else {
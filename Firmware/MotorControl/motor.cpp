@@ -149,15 +149,6 @@ float Motor::max_available_torque() {
     }
 }
 
-void Motor::log_timing(TimingLog_t log_idx) {
-    static const uint16_t clocks_per_cnt = (uint16_t)((float)TIM_1_8_CLOCK_HZ / (float)TIM_APB1_CLOCK_HZ);
-    uint16_t timing = clocks_per_cnt * htim13.Instance->CNT; // TODO: Use a hw_config
-
-    if (log_idx < TIMING_LOG_NUM_SLOTS) {
-        timing_log_[log_idx] = timing;
-    }
-}
-
 float Motor::phase_current_from_adcval(uint32_t ADCValue) {
     int adcval_bal = (int)ADCValue - (1 << 11);
     float amp_out_volt = (3.3f / (float)(1 << 12)) * (float)adcval_bal;
@@ -173,7 +164,7 @@ float Motor::phase_current_from_adcval(uint32_t ADCValue) {
 // TODO check Ibeta balance to verify good motor connection
 bool Motor::measure_phase_resistance(float test_current, float max_voltage) {
     static const float kI = 10.0f;                                 // [(V/s)/A]
-    static const int num_test_cycles = (int)(3.0f / CURRENT_MEAS_PERIOD); // Test runs for 3s
+    const int num_test_cycles = (int)(3.0f / current_meas_period); // Test runs for 3s
     float test_voltage = 0.0f;
     
     size_t i = 0;
@@ -186,7 +177,6 @@ bool Motor::measure_phase_resistance(float test_current, float max_voltage) {
         // Test voltage along phase A
         if (!enqueue_voltage_timings(test_voltage, 0.0f))
             return false; // error set inside enqueue_voltage_timings
-        log_timing(TIMING_LOG_MEAS_R);
 
         return ++i < num_test_cycles;
     });
@@ -202,6 +192,33 @@ bool Motor::measure_phase_resistance(float test_current, float max_voltage) {
     return true; // if we ran to completion that means success
 }
 
+// @brief Measures the phase resistance at the test current and at half of
+// it to separate the resistance from the voltage that the dead time of the
+// inverter costs. The dead time shows up as a constant voltage in the
+// direction of the current, i.e. as a resistance that falls with the current.
+// The on-resistance of the FETs is part of the phase resistance.
+bool Motor::measure_dead_time(float test_current, float max_voltage) {
+    if (!measure_phase_resistance(0.5f * test_current, max_voltage))
+        return false;
+    float voltage_low = config_.phase_resistance * 0.5f * test_current;
+    if (!measure_phase_resistance(test_current, max_voltage))
+        return false;
+    float voltage_high = config_.phase_resistance * test_current;
+
+    float R = (voltage_high - voltage_low) / (0.5f * test_current);
+    if (!(R > 0.0f))
+        return set_error(ERROR_PHASE_RESISTANCE_OUT_OF_RANGE), false;
+    config_.phase_resistance = R;
+
+    // Along phase A, the test current returns through phases B and C, which
+    // lose the dead time voltage in the other direction. In the alpha axis
+    // this adds up to 4/3 of the voltage of one phase.
+    float dead_time_voltage = 0.75f * (voltage_high - R * test_current);
+    float pwm_freq = (float)TIM_1_8_CLOCK_HZ / (float)(2 * pwm_period_clocks);
+    config_.dead_time = std::max(dead_time_voltage / (vbus_voltage * pwm_freq), 0.0f);
+    return true;
+}
+
 bool Motor::measure_phase_inductance(float voltage_low, float voltage_high) {
     float test_voltages[2] = {voltage_low, voltage_high};
     float Ialphas[2] = {0.0f};
@@ -215,7 +232,6 @@ bool Motor::measure_phase_inductance(float voltage_low, float voltage_high) {
         // Test voltage along phase A
         if (!enqueue_voltage_timings(test_voltages[i], 0.0f))
             return false; // error set inside enqueue_voltage_timings
-        log_timing(TIMING_LOG_MEAS_L);
 
         return ++t < (num_cycles << 1);
     });
@@ -239,13 +255,118 @@ bool Motor::measure_phase_inductance(float voltage_low, float voltage_high) {
     return true;
 }
 
+// @brief Spins the motor open-loop and measures the back-EMF to find the
+// permanent magnet flux linkage. The result is written to the sensorless
+// estimator and to the torque constant.
+//
+// The current vector is turned at the specified electrical velocity and the
+// rotor follows it. In the frame of the current vector, the voltage that
+// the current controller needs is V = R*I + j*w*L*I + E, where the back-EMF
+// E has magnitude w * flux_linkage regardless of the load angle.
+bool Motor::measure_flux_linkage(float test_current, float vel, float accel) {
+    static const float kAlignTime = 0.2f;   // [s] current ramp at standstill
+    static const float kSettleTime = 0.2f;  // [s] at constant speed before measuring
+    static const float kMeasureTime = 0.5f; // [s]
+
+    float phase = 0.0f;     // [rad]
+    float phase_vel = 0.0f; // [rad/s]
+    float E_d = 0.0f;       // [V]
+    float E_q = 0.0f;       // [V]
+    uint32_t num_samples = 0;
+
+    // Runs one cycle with the current vector at phase
+    auto spin = [&](float current, bool measure) {
+        phase = wrap_pm_pi(phase + phase_vel * current_meas_period);
+        float pwm_phase = phase + 1.5f * current_meas_period * phase_vel;
+        if (!FOC_current(current, 0.0f, phase, pwm_phase, phase_vel))
+            return false; // error set inside FOC_current
+
+        if (measure) {
+            float c_p = our_arm_cos_f32(pwm_phase);
+            float s_p = our_arm_sin_f32(pwm_phase);
+            float Vd = c_p * current_control_.final_v_alpha + s_p * current_control_.final_v_beta;
+            float Vq = c_p * current_control_.final_v_beta - s_p * current_control_.final_v_alpha;
+            float Ialpha = -current_meas_.phB - current_meas_.phC;
+            float Ibeta = one_by_sqrt3 * (current_meas_.phB - current_meas_.phC);
+            float c_I = our_arm_cos_f32(phase);
+            float s_I = our_arm_sin_f32(phase);
+            float Id = c_I * Ialpha + s_I * Ibeta;
+            float Iq = c_I * Ibeta - s_I * Ialpha;
+            float wL = phase_vel * config_.phase_inductance;
+            E_d += Vd - config_.phase_resistance * Id + wL * Iq;
+            E_q += Vq - config_.phase_resistance * Iq - wL * Id;
+            ++num_samples;
+        }
+        return true;
+    };
+
+    reset_current_control();
+
+    // Align the rotor with the current vector
+    uint32_t i = 0;
+    const uint32_t align_cycles = (uint32_t)(kAlignTime * current_meas_hz);
+    axis_->run_control_loop([&](){
+        if (!spin(test_current * (float)i / (float)align_cycles, false))
+            return false;
+        return ++i < align_cycles;
+    });
+    if (i < align_cycles)
+        return false; // aborted or failed
+
+    // Accelerate
+    axis_->run_control_loop([&](){
+        phase_vel = std::min(phase_vel + accel * current_meas_period, vel);
+        if (!spin(test_current, false))
+            return false;
+        return phase_vel < vel;
+    });
+    if (phase_vel < vel)
+        return false;
+
+    // Settle and measure
+    i = 0;
+    const uint32_t settle_cycles = (uint32_t)(kSettleTime * current_meas_hz);
+    const uint32_t measure_cycles = (uint32_t)(kMeasureTime * current_meas_hz);
+    axis_->run_control_loop([&](){
+        if (!spin(test_current, i >= settle_cycles))
+            return false;
+        return ++i < settle_cycles + measure_cycles;
+    });
+    if (i < settle_cycles + measure_cycles)
+        return false;
+
+    // Decelerate
+    axis_->run_control_loop([&](){
+        phase_vel = std::max(phase_vel - accel * current_meas_period, 0.0f);
+        if (!spin(test_current, false))
+            return false;
+        return phase_vel > 0.0f;
+    });
+    if (phase_vel > 0.0f)
+        return false;
+
+    float flux_linkage = sqrtf(E_d * E_d + E_q * E_q) / ((float)num_samples * vel);
+    float torque_constant = 1.5f * (float)config_.pole_pairs * flux_linkage;
+    // Plausible for motors between 10 and 10000 rpm/V
+    if (!(torque_constant >= 8.27f / 10000.0f && torque_constant <= 8.27f / 10.0f))
+        return set_error(ERROR_FLUX_LINKAGE_OUT_OF_RANGE), false;
+
+    axis_->sensorless_estimator_.config_.pm_flux_linkage = flux_linkage;
+    config_.torque_constant = torque_constant;
+    return true;
+}
 
 bool Motor::run_calibration() {
     float R_calib_max_voltage = config_.resistance_calib_max_voltage;
     if (config_.motor_type == MOTOR_TYPE_HIGH_CURRENT
         || config_.motor_type == MOTOR_TYPE_ACIM) {
-        if (!measure_phase_resistance(config_.calibration_current, R_calib_max_voltage))
-            return false;
+        if (config_.enable_dead_time_compensation) {
+            if (!measure_dead_time(config_.calibration_current, R_calib_max_voltage))
+                return false;
+        } else {
+            if (!measure_phase_resistance(config_.calibration_current, R_calib_max_voltage))
+                return false;
+        }
         if (!measure_phase_inductance(-R_calib_max_voltage, R_calib_max_voltage))
             return false;
     } else if (config_.motor_type == MOTOR_TYPE_GIMBAL) {
@@ -255,20 +376,67 @@ bool Motor::run_calibration() {
     }
 
     update_current_controller_gains();
+
+    if (config_.calibrate_flux_linkage && config_.motor_type == MOTOR_TYPE_HIGH_CURRENT) {
+        if (!measure_flux_linkage(config_.calibration_current, config_.flux_linkage_calib_vel, config_.flux_linkage_calib_accel))
+            return false;
+    }
     
     is_calibrated_ = true;
     return true;
 }
 
+// @brief Shifts the common mode of the timings such that one leg doesn't
+// switch for the whole PWM period (discontinuous PWM). The line to line
+// voltages stay the same.
+// The timings are the fraction of the period that the low side is on. The
+// leg that carries the most current is clamped, because that is where the
+// switching losses are highest. However the current is measured by the low
+// side shunts of phase B and C, in the middle of the low side on-time. So
+// only phase A may be clamped to the high side, and only if B and C keep
+// enough low side on-time for the measurement. Otherwise the leg with the
+// lowest voltage is clamped to the low side.
+void Motor::clamp_pwm_timings(float* tA, float* tB, float* tC) {
+    constexpr float min_sample_window = 0.1f; // [fraction of the PWM period]
+    float* t[3] = {tA, tB, tC};
+    float I_phase[3] = {
+        -current_meas_.phB - current_meas_.phC,
+        current_meas_.phB,
+        current_meas_.phC};
+
+    // Legs with the highest and the lowest voltage
+    size_t high = 0;
+    size_t low = 0;
+    for (size_t i = 1; i < 3; ++i) {
+        if (*t[i] < *t[high])
+            high = i;
+        if (*t[i] > *t[low])
+            low = i;
+    }
+
+    bool clamp_high = high == 0
+                   && fabsf(I_phase[0]) > fabsf(I_phase[low])
+                   && std::min(*tB, *tC) - *tA >= min_sample_window;
+    size_t clamped = clamp_high ? high : low;
+    float shift = (clamp_high ? 0.0f : 1.0f) - *t[clamped];
+    for (size_t i = 0; i < 3; ++i)
+        *t[i] = std::clamp(*t[i] + shift, 0.0f, 1.0f);
+    *t[clamped] = clamp_high ? 0.0f : 1.0f; // exactly, so that the leg doesn't switch
+}
+
 bool Motor::enqueue_modulation_timings(float mod_alpha, float mod_beta) {
+    CycleProfiler::Measurement measurement(axis_->profiler_.enqueue_modulation_timings_);
+
     if (std::isnan(mod_alpha) || std::isnan(mod_alpha))
         return set_error(ERROR_MODULATION_IS_NAN), false;
     float tA, tB, tC;
     if (SVM(mod_alpha, mod_beta, &tA, &tB, &tC) != 0)
         return set_error(ERROR_MODULATION_MAGNITUDE), false;
-    next_timings_[0] = (uint16_t)(tA * (float)TIM_1_8_PERIOD_CLOCKS);
-    next_timings_[1] = (uint16_t)(tB * (float)TIM_1_8_PERIOD_CLOCKS);
-    next_timings_[2] = (uint16_t)(tC * (float)TIM_1_8_PERIOD_CLOCKS);
+    if (config_.pwm_mode == PWM_MODE_DISCONTINUOUS)
+        clamp_pwm_timings(&tA, &tB, &tC);
+    next_timings_[0] = (uint16_t)(tA * (float)pwm_period_clocks);
+    next_timings_[1] = (uint16_t)(tB * (float)pwm_period_clocks);
+    next_timings_[2] = (uint16_t)(tC * (float)pwm_period_clocks);
     next_timings_valid_ = true;
     return true;
 }
@@ -279,7 +447,6 @@ bool Motor::enqueue_voltage_timings(float v_alpha, float v_beta) {
     float mod_beta = vfactor * v_beta;
     if (!enqueue_modulation_timings(mod_alpha, mod_beta))
         return false;
-    log_timing(TIMING_LOG_FOC_VOLTAGE);
     return true;
 }
 
@@ -293,6 +460,8 @@ bool Motor::FOC_voltage(float v_d, float v_q, float pwm_phase) {
 }
 
 bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_phase, float phase_vel) {
+    CycleProfiler::Measurement measurement(axis_->profiler_.foc_current_);
+
     // Syntactic sugar
     CurrentControl_t& ictrl = current_control_;
 
@@ -309,6 +478,20 @@ bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_pha
     float Ialpha = -current_meas_.phB - current_meas_.phC;
     float Ibeta = one_by_sqrt3 * (current_meas_.phB - current_meas_.phC);
 
+    // The high frequency injection of the sensorless estimator alternates
+    // every cycle, so the average of the last two measurements is the
+    // fundamental current. The current controller must not fight the
+    // injection.
+    float hfi_voltage = axis_->sensorless_estimator_.hfi_voltage_;
+    float Ialpha_prev = I_alpha_beta_prev_[0];
+    float Ibeta_prev = I_alpha_beta_prev_[1];
+    I_alpha_beta_prev_[0] = Ialpha;
+    I_alpha_beta_prev_[1] = Ibeta;
+    if (hfi_voltage != 0.0f) {
+        Ialpha = 0.5f * (Ialpha + Ialpha_prev);
+        Ibeta = 0.5f * (Ibeta + Ibeta_prev);
+    }
+
     // Park transform
     float c_I = our_arm_cos_f32(I_phase);
     float s_I = our_arm_sin_f32(I_phase);
@@ -333,7 +516,7 @@ bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_pha
     float Vq = ictrl.v_current_control_integral_q + Ierr_q * ictrl.p_gain;
 
     if (config_.R_wL_FF_enable) {
-        Vd -= phase_vel * config_.phase_inductance * Iq_des;
+        Vd -= phase_vel * phase_inductance_q() * Iq_des;
         Vq += phase_vel * config_.phase_inductance * Id_des;
         Vd += config_.phase_resistance * Id_des;
         Vq += config_.phase_resistance * Iq_des;
@@ -343,14 +526,16 @@ bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_pha
         Vq += phase_vel * (2.0f/3.0f) * (config_.torque_constant / config_.pole_pairs);
     }
 
+    Vd += hfi_voltage;
+
     float mod_to_V = (2.0f / 3.0f) * vbus_voltage;
     float V_to_mod = 1.0f / mod_to_V;
     float mod_d = V_to_mod * Vd;
     float mod_q = V_to_mod * Vq;
 
     // Vector modulation saturation, lock integrator if saturated
-    // TODO make maximum modulation configurable
-    float mod_scalefactor = 0.80f * sqrt3_by_2 * 1.0f / sqrtf(mod_d * mod_d + mod_q * mod_q);
+    float max_modulation = std::clamp(config_.max_modulation, 0.0f, 1.0f);
+    float mod_scalefactor = max_modulation * sqrt3_by_2 * 1.0f / sqrtf(mod_d * mod_d + mod_q * mod_q);
     if (mod_scalefactor < 1.0f) {
         mod_d *= mod_scalefactor;
         mod_q *= mod_scalefactor;
@@ -375,10 +560,38 @@ bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_pha
     ictrl.final_v_alpha = mod_to_V * mod_alpha;
     ictrl.final_v_beta = mod_to_V * mod_beta;
 
+    // Dead time compensation. During the dead time the current flows
+    // through a body diode, so each phase loses dead_time * PWM frequency of
+    // vbus in the direction of its current. Adding it back makes the applied
+    // voltage match final_v_alpha/beta. Near zero the direction of the
+    // current is uncertain, so the correction fades out linearly.
+    if (config_.enable_dead_time_compensation && config_.dead_time > 0.0f) {
+        float pwm_freq = (float)TIM_1_8_CLOCK_HZ / (float)(2 * pwm_period_clocks);
+        float dead_time_mod = 1.5f * config_.dead_time * pwm_freq; // [modulation] per phase
+        float I_alpha_des = c_p * Id_des - s_p * Iq_des;
+        float I_beta_des = c_p * Iq_des + s_p * Id_des;
+        float I_phase[3] = {
+            I_alpha_des,
+            -0.5f * I_alpha_des + sqrt3_by_2 * I_beta_des,
+            -0.5f * I_alpha_des - sqrt3_by_2 * I_beta_des};
+        float band = std::max(config_.dead_time_current_band, 1e-3f);
+        float comp[3];
+        for (size_t i = 0; i < 3; ++i)
+            comp[i] = dead_time_mod * std::clamp(I_phase[i] / band, -1.0f, 1.0f);
+        mod_alpha += (2.0f / 3.0f) * (comp[0] - 0.5f * comp[1] - 0.5f * comp[2]);
+        mod_beta += one_by_sqrt3 * (comp[1] - comp[2]);
+
+        // Stay in the linear range of the SVM
+        float mod_scalefactor = sqrt3_by_2 / sqrtf(mod_alpha * mod_alpha + mod_beta * mod_beta);
+        if (mod_scalefactor < 1.0f) {
+            mod_alpha *= mod_scalefactor;
+            mod_beta *= mod_scalefactor;
+        }
+    }
+
     // Apply SVM
     if (!enqueue_modulation_timings(mod_alpha, mod_beta))
         return false; // error set inside enqueue_modulation_timings
-    log_timing(TIMING_LOG_FOC_CURRENT);
 
     if (axis_->axis_num_ == 0) {
 
@@ -408,6 +621,88 @@ bool Motor::FOC_current(float Id_des, float Iq_des, float I_phase, float pwm_pha
     return true;
 }
 
+// @brief Splits a torque setpoint of a PM motor into d and q axis currents.
+//
+// The torque of a motor with Ld != Lq is
+//   1.5 * pole_pairs * (flux_linkage + (Ld - Lq) * id) * iq
+// With MTPA, id is chosen for the smallest current for the torque. With
+// field weakening, id is lowered further where the steady state voltage
+//   Vd = R * id - w * Lq * iq
+//   Vq = R * iq + w * (Ld * id + flux_linkage)
+// would exceed field_weakening_margin of the maximum voltage at the
+// measured bus voltage. If the current limit doesn't allow both, the torque
+// is reduced to what can be reached at this speed.
+// @param id: in: d-axis current offset (Id_setpoint), out: d-axis current [A]
+// @param iq: in: torque / torque_constant, out: q-axis current [A]
+void Motor::get_current_reference(float torque, float phase_vel, float ilim, float* id, float* iq) {
+    const float Ld = config_.phase_inductance;
+    const float Lq = phase_inductance_q();
+    const float R = config_.phase_resistance;
+    const float flux_linkage = config_.torque_constant / (1.5f * (float)config_.pole_pairs); // [V/(rad/s)]
+    const bool reluctance = config_.enable_mtpa && Lq > Ld;
+
+    // Current for the torque with the reluctance term at the specified id
+    auto torque_current = [&](float d) {
+        float flux = flux_linkage + (Ld - Lq) * d;
+        return (flux > 0.0f) ? torque / (1.5f * (float)config_.pole_pairs * flux) : *iq;
+    };
+
+    float id_ref = *id;
+    float iq_ref = *iq;
+    if (reluctance) {
+        // The MTPA id depends on iq, which depends on id. A few fixed point
+        // iterations converge for any practical saliency.
+        float a = flux_linkage / (2.0f * (Lq - Ld));
+        for (int i = 0; i < 3; ++i) {
+            id_ref = *id + a - sqrtf(a * a + iq_ref * iq_ref);
+            iq_ref = torque_current(id_ref);
+        }
+    }
+
+    if (config_.enable_field_weakening) {
+        float max_modulation = std::clamp(config_.max_modulation, 0.0f, 1.0f);
+        float v_max_sq = SQ(config_.field_weakening_margin * max_modulation * sqrt3_by_2 * (2.0f / 3.0f) * vbus_voltage);
+        auto v_sq = [&](float d, float q) {
+            return SQ(R * d - phase_vel * Lq * q) + SQ(R * q + phase_vel * (Ld * d + flux_linkage));
+        };
+
+        // |V|^2 = a * id^2 + 2 * b * id + c at the requested iq
+        float vd0 = -phase_vel * Lq * iq_ref;
+        float vq0 = R * iq_ref + phase_vel * flux_linkage;
+        float a = R * R + SQ(phase_vel * Ld);
+        float b = R * vd0 + phase_vel * Ld * vq0;
+        float c = SQ(vd0) + SQ(vq0) - v_max_sq;
+        float discriminant = b * b - a * c;
+        float id_fw = (discriminant >= 0.0f && a > 0.0f) ? (-b + sqrtf(discriminant)) / a : -ilim;
+        if (id_fw < id_ref) {
+            id_ref = id_fw;
+            if (reluctance)
+                iq_ref = torque_current(id_ref);
+
+            if (SQ(id_ref) + SQ(iq_ref) > SQ(ilim)) {
+                // Find the highest iq on the current limit that stays
+                // within the voltage limit. For Lq >= Ld, the voltage rises
+                // with id along the current limit.
+                float lo = -ilim;
+                float hi = std::clamp(*id, -ilim, 0.0f);
+                for (int i = 0; i < 10; ++i) {
+                    float mid = 0.5f * (lo + hi);
+                    float q = std::copysign(sqrtf(SQ(ilim) - SQ(mid)), iq_ref);
+                    if (v_sq(mid, q) > v_max_sq)
+                        hi = mid;
+                    else
+                        lo = mid;
+                }
+                id_ref = lo;
+            }
+        }
+    }
+
+    *id = std::clamp(id_ref, -ilim, ilim);
+    float iq_lim = sqrtf(std::max(SQ(ilim) - SQ(*id), 0.0f));
+    *iq = std::clamp(iq_ref, -iq_lim, iq_lim);
+}
+
 // torque_setpoint [Nm]
 // phase [rad electrical]
 // phase_vel [rad/s electrical]
@@ -426,8 +721,15 @@ bool Motor::update(float torque_setpoint, float phase, float phase_vel) {
 
     // TODO: 2-norm vs independent clamping (current could be sqrt(2) bigger)
     float ilim = effective_current_lim_;
-    float id = std::clamp(current_control_.Id_setpoint, -ilim, ilim);
-    float iq = std::clamp(current_setpoint, -ilim, ilim);
+    float id, iq;
+    if (config_.motor_type == MOTOR_TYPE_HIGH_CURRENT && (config_.enable_mtpa || config_.enable_field_weakening)) {
+        id = current_control_.Id_setpoint;
+        iq = current_setpoint;
+        get_current_reference(torque_setpoint * config_.direction, phase_vel, ilim, &id, &iq);
+    } else {
+        id = std::clamp(current_control_.Id_setpoint, -ilim, ilim);
+        iq = std::clamp(current_setpoint, -ilim, ilim);
+    }
 
     if (config_.motor_type == MOTOR_TYPE_ACIM) {
         // Note that the effect of the current commands on the real currents is actually 1.5 PWM cycles later
@@ -447,7 +749,7 @@ bool Motor::update(float torque_setpoint, float phase, float phase_vel) {
         current_control_.acim_rotor_flux += dflux_by_dt * current_meas_period;
         float slip_velocity = config_.acim_slip_velocity * (iq / current_control_.acim_rotor_flux);
         // Check for issues with small denominator. Polarity of check to catch NaN too
-        bool acceptable_vel = fabsf(slip_velocity) <= 0.1f * (float)current_meas_hz;
+        bool acceptable_vel = fabsf(slip_velocity) <= 0.1f * current_meas_hz;
         if (!acceptable_vel)
             slip_velocity = 0.0f;
         phase_vel += slip_velocity;
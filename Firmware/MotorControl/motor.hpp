@@ -8,22 +8,6 @@ class Motor;
 
 #include <autogen/interfaces.hpp>
 
-enum TimingLog_t {
-    TIMING_LOG_GENERAL,
-    TIMING_LOG_ADC_CB_I,
-    TIMING_LOG_ADC_CB_DC,
-    TIMING_LOG_MEAS_R,
-    TIMING_LOG_MEAS_L,
-    TIMING_LOG_ENC_CALIB,
-    TIMING_LOG_IDX_SEARCH,
-    TIMING_LOG_FOC_VOLTAGE,
-    TIMING_LOG_FOC_CURRENT,
-    TIMING_LOG_SPI_START,
-    TIMING_LOG_SAMPLE_NOW,
-    TIMING_LOG_SPI_END,
-    TIMING_LOG_NUM_SLOTS
-};
-
 class Motor : public ODriveIntf::MotorIntf {
 public:
     struct Iph_BC_t {
@@ -61,6 +45,7 @@ public:
         float calibration_current = 10.0f;    // [A]
         float resistance_calib_max_voltage = 2.0f; // [V] - You may need to increase this if this voltage isn't sufficient to drive calibration_current through the motor.
         float phase_inductance = 0.0f;        // to be set by measure_phase_inductance
+        float phase_inductance_q = 0.0f;      // [H] 0 means the same as phase_inductance (non-salient motor)
         float phase_resistance = 0.0f;        // to be set by measure_phase_resistance
         float torque_constant = 0.04f;         // [Nm/A] for PM motors, [Nm/A^2] for induction motors. Equal to 8.27/Kv of the motor
         int32_t direction = 0;                // 1 or -1 (0 = unspecified)
@@ -83,6 +68,17 @@ public:
         float acim_autoflux_decay_gain = 1.0f;
         bool R_wL_FF_enable = false; // Enable feedforwards for R*I and w*L*I terms
         bool bEMF_FF_enable = false; // Enable feedforward for bEMF
+        float max_modulation = 0.80f; // fraction of the linear modulation range
+        bool enable_mtpa = false; // use the reluctance torque of salient motors
+        bool enable_field_weakening = false;
+        float field_weakening_margin = 0.9f; // fraction of the maximum voltage that the field weakening aims for
+        bool enable_dead_time_compensation = false;
+        float dead_time = 0.0f; // [s] effective dead time of the inverter, to be set by measure_dead_time
+        float dead_time_current_band = 0.5f; // [A] the compensation fades out below this current
+        PwmMode pwm_mode = PWM_MODE_CONTINUOUS;
+        bool calibrate_flux_linkage = false; // Spin the motor during calibration to measure the flux linkage
+        float flux_linkage_calib_vel = 400.0f; // [rad/s electrical]
+        float flux_linkage_calib_accel = 200.0f; // [rad/s^2 electrical]
 
         // custom property setters
         Motor* parent = nullptr;
@@ -112,11 +108,15 @@ public:
     bool do_checks();
     float effective_current_lim();
     float max_available_torque();
-    void log_timing(TimingLog_t log_idx);
+    float phase_inductance_q() { return (config_.phase_inductance_q > 0.0f) ? config_.phase_inductance_q : config_.phase_inductance; }
+    void get_current_reference(float torque, float phase_vel, float ilim, float* id, float* iq);
     float phase_current_from_adcval(uint32_t ADCValue);
     bool measure_phase_resistance(float test_current, float max_voltage);
+    bool measure_dead_time(float test_current, float max_voltage);
     bool measure_phase_inductance(float voltage_low, float voltage_high);
+    bool measure_flux_linkage(float test_current, float vel, float accel);
     bool run_calibration();
+    void clamp_pwm_timings(float* tA, float* tB, float* tC);
     bool enqueue_modulation_timings(float mod_alpha, float mod_beta);
     bool enqueue_voltage_timings(float v_alpha, float v_beta);
     bool FOC_voltage(float v_d, float v_q, float pwm_phase);
@@ -137,18 +137,11 @@ public:
 //private:
 
     uint16_t next_timings_[3] = {
-        TIM_1_8_PERIOD_CLOCKS / 2,
-        TIM_1_8_PERIOD_CLOCKS / 2,
-        TIM_1_8_PERIOD_CLOCKS / 2
+        (uint16_t)(pwm_period_clocks / 2),
+        (uint16_t)(pwm_period_clocks / 2),
+        (uint16_t)(pwm_period_clocks / 2)
     };
     bool next_timings_valid_ = false;
-    uint16_t last_cpu_time_ = 0;
-    int timing_log_index_ = 0;
-    struct {
-        uint16_t& operator[](size_t idx) { return content[idx]; }
-        uint16_t& get(size_t idx) { return content[idx]; }
-        uint16_t content[TIMING_LOG_NUM_SLOTS];
-    } timing_log_;
 
     // variables exposed on protocol
     Error error_ = ERROR_NONE;
@@ -159,6 +152,7 @@ public:
     Iph_BC_t current_meas_ = {0.0f, 0.0f};
     Iph_BC_t DC_calib_ = {0.0f, 0.0f};
     float phase_current_rev_gain_ = 0.0f; // Reverse gain for ADC to Amps (to be set by DRV8301_setup)
+    float I_alpha_beta_prev_[2] = {0.0f, 0.0f}; // [A] measured in the last FOC_current call
     CurrentControl_t current_control_ = {
         .p_gain = 0.0f,        // [V/A] should be auto set after resistance and inductance measurement
         .i_gain = 0.0f,        // [V/As] should be auto set after resistance and inductance measurement
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * @brief Finds when the next of two straight-line moves of several axes can
+ * start, such that no axis exceeds its limits while the moves overlap.
+ *
+ * Both moves are trapezoidal profiles of a path parameter from 0 to 1 that
+ * start at rest, as planned by TrapezoidalTrajectory::planTrapezoidal(). Each
+ * axis follows the path scaled by its distance. While the moves overlap, the
+ * velocities and accelerations of both moves add up. A reversal sums the
+ * deceleration of the first move and the acceleration of the second one, and
+ * a second move that accelerates faster than the first one decelerates
+ * overshoots the velocity limit.
+ *
+ * TPath must have the members Ta_, Tv_, Tf_, Vr_, Ar_ and Dr_ of
+ * TrapezoidalTrajectory, TLimits the members vel_limit, accel_limit and
+ * decel_limit of TrapezoidalTrajectory::Config_t.
+ */
+
+// @brief Velocity of a path at time t [1/s].
+template<typename TPath>
+float blend_path_vel(const TPath& path, float t) {
+    if (t <= 0.0f || t >= path.Tf_)
+        return 0.0f;
+    if (t < path.Ta_)
+        return path.Ar_ * t;
+    if (t < path.Ta_ + path.Tv_)
+        return path.Vr_;
+    return path.Dr_ * (t - path.Tf_);
+}
+
+// @brief Acceleration of a path at time t [1/s^2].
+template<typename TPath>
+float blend_path_accel(const TPath& path, float t) {
+    if (t <= 0.0f || t >= path.Tf_)
+        return 0.0f;
+    if (t < path.Ta_)
+        return path.Ar_;
+    if (t < path.Ta_ + path.Tv_)
+        return 0.0f;
+    return path.Dr_;
+}
+
+// @brief Returns true if next can start at time start [s] after the start
+// of move without exceeding the limits of any axis.
+template<typename TPath, typename TLimits>
+bool blend_is_within_limits(const TPath& move, const float* move_delta,
+                            const TPath& next, const float* next_delta,
+                            const TLimits* limits, size_t n_axes, float start) {
+    // Velocities are piecewise linear and accelerations piecewise constant
+    // between these points, so checking them is sufficient.
+    float points[] = {
+        start,
+        start + next.Ta_,
+        start + next.Ta_ + next.Tv_,
+        start + next.Tf_,
+        move.Tf_
+    };
+    const size_t n_points = sizeof(points) / sizeof(points[0]);
+    for (size_t i = 0; i < n_points; ++i)
+        points[i] = std::min(points[i], move.Tf_);
+    std::sort(points, points + n_points);
+
+    const float tolerance = 1.0001f; // rounding of the path limits
+    for (size_t i = 0; i + 1 < n_points; ++i) {
+        float t0 = points[i];
+        float t1 = points[i + 1];
+        if (!(t1 > t0))
+            continue;
+        float t_mid = 0.5f * (t0 + t1);
+        for (size_t j = 0; j < n_axes; ++j) {
+            float v0 = move_delta[j] * blend_path_vel(move, t0) + next_delta[j] * blend_path_vel(next, t0 - start);
+            float v1 = move_delta[j] * blend_path_vel(move, t1) + next_delta[j] * blend_path_vel(next, t1 - start);
+            float a = move_delta[j] * blend_path_accel(move, t_mid) + next_delta[j] * blend_path_accel(next, t_mid - start);
+            float vel_limit = tolerance * limits[j].vel_limit;
+            if (std::abs(v0) > vel_limit || std::abs(v1) > vel_limit)
+                return false;
+            // Speeding up is limited by accel_limit, slowing down by decel_limit
+            bool speeds_up = a * v0 > 0.0f || a * v1 > 0.0f;
+            bool slows_down = a * v0 < 0.0f || a * v1 < 0.0f;
+            if (speeds_up && std::abs(a) > tolerance * limits[j].accel_limit)
+                return false;
+            if (slows_down && std::abs(a) > tolerance * limits[j].decel_limit)
+                return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns the earliest start time [s] of next after the start of move, no
+ * earlier than earliest [s] and than the deceleration of move. If the moves
+ * can't overlap within the limits, next starts when move ends.
+ *
+ * The start time is searched in STEPS steps over the deceleration of move.
+ */
+template<typename TPath, typename TLimits>
+float blend_start(const TPath& move, const float* move_delta,
+                  const TPath& next, const float* next_delta,
+                  const TLimits* limits, size_t n_axes, float earliest) {
+    const int STEPS = 16;
+    float decel_start = move.Ta_ + move.Tv_;
+    float first = std::max(earliest, decel_start);
+    if (!(first < move.Tf_))
+        return first;
+    for (int i = 0; i < STEPS; ++i) {
+        float start = std::max(first, decel_start + (move.Tf_ - decel_start) * (float)i / (float)STEPS);
+        if (blend_is_within_limits(move, move_delta, next, next_delta, limits, n_axes, start))
+            return start;
+    }
+    return move.Tf_;
+}
@@ -99,6 +99,9 @@ struct BoardConfig_t {
                                                                     //!< Must be larger than `dc_bus_overvoltage_ramp_start`,
                                                                     //!< otherwise the ramp feature is disabled.
 
+    float pwm_freq = (float)TIM_1_8_CLOCK_HZ / (float)(2 * TIM_1_8_PERIOD_CLOCKS); // [Hz] takes effect after a reboot
+    float pwm_dead_time = (float)TIM_1_8_DEADTIME_CLOCKS / (float)TIM_1_8_CLOCK_HZ; // [s] takes effect after a reboot
+    float control_freq = (float)TIM_1_8_CLOCK_HZ / (float)(2 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1)); // [Hz] upper limit, takes effect after a reboot
     float dc_max_positive_current = INFINITY; // Max current [A] the power supply can source
     float dc_max_negative_current = -0.000001f; // Max current [A] the power supply can sink. You most likely want a non-positive value here. Set to -INFINITY to disable.
     PWMMapping_t pwm_mappings[4];
@@ -137,12 +140,18 @@ inline ENUMTYPE operator ~ (ENUMTYPE a) { return static_cast<ENUMTYPE>(~static_c
 #include <low_level.h>
 #include <encoder.hpp>
 #include <sensorless_estimator.hpp>
+#include <biquad_filter.hpp>
+#include <input_shaper.hpp>
+#include <backlash_estimator.hpp>
 #include <controller.hpp>
 #include <current_limiter.hpp>
 #include <thermistor.hpp>
 #include <trapTraj.hpp>
+#include <coordinated_move.hpp>
 #include <endstop.hpp>
 #include <mechanical_brake.hpp>
+#include <cycle_profiler.hpp>
+#include <autotuner.hpp>
 #include <axis.hpp>
 #include <communication/communication.h>
 
@@ -165,6 +174,8 @@ public:
     void erase_configuration() override;
     void reboot() override { NVIC_SystemReset(); }
     void enter_dfu_mode() override;
+    bool move_coordinated(float pos0, float pos1) override;
+    uint32_t get_coordinated_move_fill() { return coordinated_moves.get_fill(); }
 
     float get_oscilloscope_val(uint32_t index) override {
         return oscilloscope[index];
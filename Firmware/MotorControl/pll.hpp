@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief Second order phase locked loop that tracks a measured phase or
+ * position with a fixed-point state.
+ *
+ * The phase is stored with 32 fractional bits of a cycle, where a cycle is
+ * whatever unit the measurement comes in (e.g. one encoder count or one
+ * electrical revolution):
+ *  - Pll<uint32_t> keeps a binary angle that wraps around at one cycle.
+ *    Differences are taken modulo one cycle, so no explicit wrapping is needed.
+ *  - Pll<int64_t> keeps an unwrapped position of 32 integer bits plus the
+ *    fraction. The resolution of the phase doesn't degrade with the distance
+ *    travelled, unlike a float accumulator. Phases converted from float
+ *    saturate at +-2^31 cycles.
+ *
+ * The velocity is kept as float in [cycle/s].
+ */
+template<typename T>
+class Pll {
+    static_assert(std::is_same<T, uint32_t>::value || std::is_same<T, int64_t>::value,
+                  "only uint32_t (wrapping) and int64_t (unwrapped) phases are supported");
+
+public:
+    using Diff = std::make_signed_t<T>;
+
+    static constexpr float ONE = 4294967296.0f; // one cycle in fixed-point [2^-32 cycle]
+    static constexpr float MAX_CYCLES = 2147483520.0f; // largest float below 2^31
+
+    // @brief Converts cycles to fixed-point. Out of range values and NaN
+    // saturate, since converting them to int64_t would be undefined.
+    static T from_float(float cycles) {
+        cycles = cycles < MAX_CYCLES ? cycles : MAX_CYCLES;
+        cycles = cycles > -MAX_CYCLES ? cycles : -MAX_CYCLES;
+        return (T)(int64_t)(cycles * ONE);
+    }
+    static float to_float(Diff phase) { return (float)phase * (1.0f / ONE); }
+
+    // @brief Critically damped gains for the specified bandwidth [rad/s].
+    // @returns false if the bandwidth is too high for the sample period, in
+    // which case the discrete time approximation doesn't hold.
+    bool set_bandwidth(float bandwidth, float period) {
+        kp_ = 2.0f * bandwidth;
+        ki_ = 0.25f * (kp_ * kp_);
+        return period * kp_ < 1.0f;
+    }
+
+    void reset(T phase, float vel = 0.0f) {
+        phase_ = phase;
+        vel_ = vel;
+    }
+
+    // @brief Predicts the phase from the velocity.
+    void predict(float period) {
+        phase_ += from_float(period * vel_);
+    }
+
+    // @brief Corrects the phase and velocity with the error between the
+    // measured and the predicted phase.
+    // @param delta: measured phase minus phase [cycle]
+    void correct(float delta, float period) {
+        phase_ += from_float(period * kp_ * delta);
+        vel_ += period * ki_ * delta;
+    }
+
+    // @brief Predicts the phase and corrects it with a measurement.
+    // @returns the phase error before the correction [cycle]
+    float update(T measured, float period) {
+        predict(period);
+        float delta = error(measured);
+        correct(delta, period);
+        return delta;
+    }
+
+    // @brief Returns measured minus current phase [cycle]. For the wrapping
+    // phase the result is in [-0.5, 0.5).
+    float error(T measured) const { return to_float((Diff)(measured - phase_)); }
+
+    float kp() const { return kp_; } // [(cycle/s) / cycle]
+    float ki() const { return ki_; } // [(cycle/s^2) / cycle]
+
+    T phase_ = 0;        // [2^-32 cycle]
+    float vel_ = 0.0f;   // [cycle/s]
+
+private:
+    float kp_ = 0.0f;
+    float ki_ = 0.0f;
+};
@@ -1,6 +1,11 @@
 
 #include "odrive_main.h"
 
+void SensorlessEstimator::set_error(Error error) {
+    error_ |= error;
+    axis_->error_ |= Axis::ERROR_SENSORLESS_ESTIMATOR_FAILED;
+}
+
 bool SensorlessEstimator::update() {
     // Algorithm based on paper: Sensorless Control of Surface-Mount Permanent-Magnet Synchronous Motors Based on a Nonlinear Observer
     // http://cas.ensmp.fr/~praly/Telechargement/Journaux/2010-IEEE_TPEL-Lee-Hong-Nam-Ortega-Praly-Astolfi.pdf
@@ -53,29 +58,249 @@ bool SensorlessEstimator::update() {
     V_alpha_beta_memory_[1] = axis_->motor_.current_control_.final_v_beta * axis_->motor_.config_.direction;
 
     // PLL
-    // TODO: the PLL part has some code duplication with the encoder PLL
-    // Pll gains as a function of bandwidth
-    float pll_kp = 2.0f * config_.pll_bandwidth;
-    // Critically damped
-    float pll_ki = 0.25f * (pll_kp * pll_kp);
     // Check that we don't get problems with discrete time approximation
-    if (!(current_meas_period * pll_kp < 1.0f)) {
+    if (!pll_.set_bandwidth(config_.pll_bandwidth, current_meas_period)
+        || (hfi_state_ != HFI_STATE_OFF && !hfi_pll_.set_bandwidth(config_.hfi_bandwidth, current_meas_period))) {
         error_ |= ERROR_UNSTABLE_GAIN;
         vel_estimate_valid_ = false;
+        hfi_voltage_ = 0.0f;
         return false;
     }
 
-    // predict PLL phase with velocity
-    pll_pos_ = wrap_pm_pi(pll_pos_ + current_meas_period * vel_estimate_erad_);
-    // update PLL phase with observer permanent magnet phase
-    phase_ = fast_atan2(eta[1], eta[0]);
-    float delta_phase = wrap_pm_pi(phase_ - pll_pos_);
-    pll_pos_ = wrap_pm_pi(pll_pos_ + current_meas_period * pll_kp * delta_phase);
-    // update PLL velocity
-    vel_estimate_erad_ += current_meas_period * pll_ki * delta_phase;
+    // update PLL with observer permanent magnet phase. The phase is a binary
+    // angle, so it wraps around by itself.
+    float observer_phase = fast_atan2(eta[1], eta[0]);
+    pll_.update(Pll<uint32_t>::from_float(observer_phase * (0.5f / M_PI)), current_meas_period);
+
+    // phase_ still holds the phase that the last injection was applied at
+    if (hfi_state_ != HFI_STATE_OFF)
+        update_hfi(I_alpha_beta);
+
+    if (hfi_state_ == HFI_STATE_STARTUP) {
+        // phase_ is set by run_hfi_startup
+        vel_estimate_erad_ = 0.0f;
+    } else {
+        const Pll<uint32_t>& pll = (hfi_state_ == HFI_STATE_TRACKING) ? hfi_pll_ : pll_;
+        pll_pos_ = 2.0f * M_PI * Pll<uint32_t>::to_float((int32_t)pll.phase_);
+        phase_ = (hfi_state_ == HFI_STATE_TRACKING) ? pll_pos_ : observer_phase;
+        vel_estimate_erad_ = 2.0f * M_PI * pll.vel_;
+    }
     // convert to mechanical turns/s for controller usage.
     vel_estimate_ = vel_estimate_erad_ / (std::max((float)axis_->motor_.config_.pole_pairs, 1.0f) * 2.0f * M_PI);
 
     vel_estimate_valid_ = true;
     return true;
 };
+
+// @brief Demodulates the response to the high frequency injection and
+// decides on the injection for this cycle.
+//
+// The d-axis voltage alternates in sign every cycle. The current step it
+// causes in the same frame is
+//   d: V * T * (1/Ld + 1/Lq) / 2 + hfi_saliency_ * cos(2 * phase error)
+//   q: hfi_saliency_ * sin(2 * phase error)
+// where hfi_saliency_ = V * T * (1/Ld - 1/Lq) / 2 is positive for a motor
+// with Ld < Lq. The slowly varying fundamental current cancels
+// out because of the alternating sign.
+void SensorlessEstimator::update_hfi(const float I_alpha_beta[2]) {
+    float dI_alpha = I_alpha_beta[0] - hfi_I_alpha_beta_prev_[0];
+    float dI_beta = I_alpha_beta[1] - hfi_I_alpha_beta_prev_[1];
+    hfi_I_alpha_beta_prev_[0] = I_alpha_beta[0];
+    hfi_I_alpha_beta_prev_[1] = I_alpha_beta[1];
+
+    // Depending on the PWM timing the response shows up one or two cycles
+    // after the injection. Since the injection alternates, this only flips
+    // the sign, which run_hfi_startup determines as hfi_response_sign_.
+    if (hfi_voltage_ != 0.0f) {
+        float sign = (hfi_voltage_ > 0.0f) ? hfi_response_sign_ : -hfi_response_sign_;
+        float c = our_arm_cos_f32(phase_);
+        float s = our_arm_sin_f32(phase_);
+        hfi_response_[0] = sign * (c * dI_alpha + s * dI_beta);
+        hfi_response_[1] = sign * (c * dI_beta - s * dI_alpha);
+    } else {
+        hfi_response_[0] = 0.0f;
+        hfi_response_[1] = 0.0f;
+    }
+
+    float handover_vel = config_.hfi_handover_vel * (0.5f / M_PI); // [electrical revolution/s]
+    if (hfi_state_ == HFI_STATE_TRACKING) {
+        float delta = hfi_response_[1] / (2.0f * hfi_saliency_); // [rad] for small errors
+        hfi_pll_.predict(current_meas_period);
+        hfi_pll_.correct(delta * (0.5f / M_PI), current_meas_period);
+
+        if (std::abs(hfi_pll_.vel_) > handover_vel) {
+            // Hand over to the flux observer. Start it at the phase and
+            // velocity of the injection so that it doesn't have to converge.
+            float phase = 2.0f * M_PI * Pll<uint32_t>::to_float((int32_t)hfi_pll_.phase_);
+            flux_state_[0] = config_.pm_flux_linkage * our_arm_cos_f32(phase) + axis_->motor_.config_.phase_inductance * I_alpha_beta[0];
+            flux_state_[1] = config_.pm_flux_linkage * our_arm_sin_f32(phase) + axis_->motor_.config_.phase_inductance * I_alpha_beta[1];
+            pll_.reset(hfi_pll_.phase_, hfi_pll_.vel_);
+            hfi_state_ = HFI_STATE_OBSERVER;
+        }
+    } else if (hfi_state_ == HFI_STATE_OBSERVER) {
+        if (std::abs(pll_.vel_) < HFI_HYSTERESIS * handover_vel) {
+            hfi_pll_.reset(pll_.phase_, pll_.vel_);
+            hfi_state_ = HFI_STATE_TRACKING;
+        }
+    }
+
+    if (hfi_state_ == HFI_STATE_OBSERVER) {
+        hfi_voltage_ = 0.0f;
+    } else {
+        float voltage = config_.hfi_current * axis_->motor_.config_.phase_inductance / current_meas_period;
+        hfi_voltage_ = (hfi_voltage_ > 0.0f) ? -voltage : voltage;
+    }
+}
+
+// @brief Finds the rotor phase at standstill with the high frequency
+// injection and starts tracking it.
+//
+// The injection is first turned once around the motor to find the d-axis,
+// where the response is largest, and the saliency. This leaves the polarity
+// of the magnet open. A positive d-axis current saturates the iron and
+// increases the response, so a positive and a negative current pulse along
+// the d-axis tell the polarity. On success the injection keeps tracking the
+// phase.
+bool SensorlessEstimator::run_hfi_startup() {
+    Motor& motor = axis_->motor_;
+    hfi_state_ = HFI_STATE_STARTUP;
+    hfi_response_sign_ = 1.0f;
+
+    // Sweep
+    const uint32_t sweep_cycles = (uint32_t)(HFI_SWEEP_TIME * current_meas_hz);
+    float sum = 0.0f;
+    float sum_cos = 0.0f;
+    float sum_sin = 0.0f;
+    uint32_t i = 0;
+    axis_->run_control_loop([&](){
+        // The response to the previous cycle's injection. Skip the first
+        // ones, which have no injection before them.
+        if (i >= 2) {
+            sum += hfi_response_[0];
+            sum_cos += hfi_response_[0] * our_arm_cos_f32(2.0f * phase_);
+            sum_sin += hfi_response_[0] * our_arm_sin_f32(2.0f * phase_);
+        }
+        phase_ = wrap_pm_pi(2.0f * M_PI * (float)i / (float)sweep_cycles);
+        if (!motor.update(0.0f, phase_, 0.0f))
+            return false;
+        return ++i < sweep_cycles + 2;
+    });
+    if (i < sweep_cycles + 2)
+        return false; // aborted
+
+    // The d-axis response of an inductance is positive
+    if (sum < 0.0f) {
+        hfi_response_sign_ = -1.0f;
+        sum = -sum;
+        sum_cos = -sum_cos;
+        sum_sin = -sum_sin;
+    }
+    float n = (float)sweep_cycles;
+    hfi_saliency_ = (2.0f / n) * sqrtf(sum_cos * sum_cos + sum_sin * sum_sin);
+    if (!(hfi_saliency_ >= HFI_MIN_SALIENCY * (sum / n)))
+        return set_error(ERROR_LOW_SALIENCY), false;
+    float phase = 0.5f * fast_atan2(sum_sin, sum_cos);
+
+    // Polarity. The injection keeps tracking the phase during the pulses.
+    // Otherwise the rotor could start to turn away from the unstable
+    // equilibrium of the current that opposes the magnet.
+    hfi_pll_.reset(Pll<uint32_t>::from_float(phase * (0.5f / M_PI)));
+    phase_ = phase;
+    hfi_state_ = HFI_STATE_TRACKING;
+    const uint32_t polarity_cycles = (uint32_t)(HFI_POLARITY_TIME * current_meas_hz);
+    float polarity_response[2] = {0.0f, 0.0f};
+    float Id_setpoint = motor.current_control_.Id_setpoint;
+    i = 0;
+    axis_->run_control_loop([&](){
+        // Positive current first, then negative. Only the second half of each
+        // pulse is used, after the current settled.
+        size_t pulse = i / polarity_cycles;
+        if (i % polarity_cycles >= polarity_cycles / 2)
+            polarity_response[pulse] += hfi_response_[0];
+        motor.current_control_.Id_setpoint = (pulse == 0) ? config_.hfi_polarity_current : -config_.hfi_polarity_current;
+        if (!motor.update(0.0f, phase_, 0.0f))
+            return false;
+        return ++i < 2 * polarity_cycles;
+    });
+    motor.current_control_.Id_setpoint = Id_setpoint;
+    if (i < 2 * polarity_cycles)
+        return false; // aborted
+
+    float contrast = (polarity_response[0] - polarity_response[1]) / (polarity_response[0] + polarity_response[1]);
+    if (!(std::abs(contrast) >= HFI_MIN_POLARITY_CONTRAST))
+        return set_error(ERROR_UNKNOWN_POLARITY), false;
+    if (contrast < 0.0f) {
+        hfi_pll_.phase_ += Pll<uint32_t>::from_float(0.5f);
+        phase_ = wrap_pm_pi(phase_ + M_PI);
+    }
+    return true;
+}
+
+// @brief Picks up a rotor that is already turning, e.g. a fan that coasts.
+//
+// The current is held at zero for flying_start_time. The current controller
+// then applies the back-EMF, so the flux observer and the PLL converge on the
+// rotor phase and velocity like in normal operation, but without a torque
+// transient.
+// Building up the back-EMF voltage in the integrator of the current
+// controller would take many cycles, in which a large current flows.
+// Instead, the back-EMF is calculated from the voltage equation every cycle
+// and loaded into the integrator. The remaining transient is about the
+// current that the back-EMF drives through the inductance within the control
+// delay.
+// @param spinning: set to true if the estimate is good enough to continue
+// with closed loop control. If false, the rotor is too slow and needs the
+// normal startup.
+// @returns false if aborted or on error.
+bool SensorlessEstimator::run_flying_start(bool* spinning) {
+    Motor& motor = axis_->motor_;
+    *spinning = false;
+    flux_state_[0] = 0.0f;
+    flux_state_[1] = 0.0f;
+    pll_.reset(0);
+
+    // Judge the convergence on the second half of the hold
+    const uint32_t hold_cycles = (uint32_t)(config_.flying_start_time * current_meas_hz);
+    float max_phase_error = 0.0f;
+    float I_alpha_beta_prev[2] = {0.0f, 0.0f}; // [A]
+    float V_alpha_beta_memory[2][2] = {}; // [V] computed one and two cycles ago
+    uint32_t i = 0;
+    axis_->run_control_loop([&](){
+        if (i >= hold_cycles / 2)
+            max_phase_error = std::max(max_phase_error, std::abs(wrap_pm_pi(phase_ - pll_pos_)));
+
+        // Back-EMF over the last period. Like in update(), the voltage that
+        // was applied is the one computed two cycles ago.
+        float I_alpha_beta[2] = {
+            -motor.current_meas_.phB - motor.current_meas_.phC,
+            one_by_sqrt3 * (motor.current_meas_.phB - motor.current_meas_.phC)};
+        if (i == 0) {
+            I_alpha_beta_prev[0] = I_alpha_beta[0];
+            I_alpha_beta_prev[1] = I_alpha_beta[1];
+        }
+        float bemf[2];
+        for (int j = 0; j <= 1; ++j) {
+            bemf[j] = V_alpha_beta_memory[1][j] - motor.config_.phase_resistance * I_alpha_beta[j]
+                    - motor.config_.phase_inductance * (I_alpha_beta[j] - I_alpha_beta_prev[j]) * current_meas_hz;
+            I_alpha_beta_prev[j] = I_alpha_beta[j];
+            V_alpha_beta_memory[1][j] = V_alpha_beta_memory[0][j];
+        }
+        float pwm_phase = motor.config_.direction * (phase_ + 1.5f * current_meas_period * vel_estimate_erad_);
+        float c = our_arm_cos_f32(pwm_phase);
+        float s = our_arm_sin_f32(pwm_phase);
+        motor.current_control_.v_current_control_integral_d = c * bemf[0] + s * bemf[1];
+        motor.current_control_.v_current_control_integral_q = c * bemf[1] - s * bemf[0];
+
+        if (!motor.update(0.0f, phase_, vel_estimate_erad_))
+            return false;
+        V_alpha_beta_memory[0][0] = motor.current_control_.final_v_alpha;
+        V_alpha_beta_memory[0][1] = motor.current_control_.final_v_beta;
+        return ++i < hold_cycles;
+    });
+    if (i < hold_cycles)
+        return false; // aborted
+
+    *spinning = std::abs(vel_estimate_erad_) >= config_.flying_start_min_vel
+             && max_phase_error <= FLYING_START_MAX_PHASE_ERROR;
+    return true;
+}
@@ -1,15 +1,44 @@
 #ifndef __SENSORLESS_ESTIMATOR_HPP
 #define __SENSORLESS_ESTIMATOR_HPP
 
+#include "pll.hpp"
+
 class SensorlessEstimator : public ODriveIntf::SensorlessEstimatorIntf {
 public:
+    static constexpr float HFI_SWEEP_TIME = 0.25f; // [s] to turn the injection once around
+    static constexpr float HFI_POLARITY_TIME = 0.02f; // [s] per polarity pulse
+    static constexpr float HFI_MIN_SALIENCY = 0.05f; // minimum (1/Ld - 1/Lq) / (1/Ld + 1/Lq)
+    static constexpr float HFI_MIN_POLARITY_CONTRAST = 0.01f; // minimum relative change of the d-axis response between the polarity pulses
+    static constexpr float HFI_HYSTERESIS = 0.8f; // injection restarts below this fraction of hfi_handover_vel
+    static constexpr float FLYING_START_MAX_PHASE_ERROR = 0.2f; // [rad] between the observer and the PLL at the end of the flying start
+
+    enum HfiState {
+        HFI_STATE_OFF,
+        HFI_STATE_STARTUP,  // injecting, driven by run_hfi_startup
+        HFI_STATE_TRACKING, // injecting, the phase comes from the injection
+        HFI_STATE_OBSERVER, // not injecting, the phase comes from the flux observer
+    };
+
     struct Config_t {
         float observer_gain = 1000.0f; // [rad/s]
         float pll_bandwidth = 1000.0f;  // [rad/s]
         float pm_flux_linkage = 1.58e-3f; // [V / (rad/s)]  { 5.51328895422 / (<pole pairs> * <rpm/v>) }
+        bool enable_hfi = false;
+        float hfi_current = 2.0f; // [A] current step that the injection causes in one period
+        float hfi_bandwidth = 200.0f; // [rad/s]
+        float hfi_handover_vel = 400.0f; // [rad/s] electrical
+        float hfi_polarity_current = 10.0f; // [A]
+        bool enable_flying_start = false;
+        float flying_start_time = 0.02f; // [s] to let the observer converge at zero current
+        float flying_start_min_vel = 200.0f; // [rad/s] electrical
     };
 
+    void set_error(Error error);
     bool update();
+    void update_hfi(const float I_alpha_beta[2]);
+    bool run_hfi_startup();
+    bool run_flying_start(bool* spinning);
+    void stop_hfi() { hfi_state_ = HFI_STATE_OFF; hfi_voltage_ = 0.0f; }
 
     Axis* axis_ = nullptr; // set by Axis constructor
     Config_t config_;
@@ -21,11 +50,18 @@ public:
     float vel_estimate_ = 0.0f;                      // [turn/s]
     float vel_estimate_erad_ = 0.0f;                 // [rad/s]
     bool vel_estimate_valid_ = false;
-    // float pll_kp_ = 0.0f;                       // [rad/s / rad]
-    // float pll_ki_ = 0.0f;                       // [(rad/s^2) / rad]
+    Pll<uint32_t> pll_;                         // [electrical revolution]
     float flux_state_[2] = {0.0f, 0.0f};        // [Vs]
     float V_alpha_beta_memory_[2] = {0.0f, 0.0f}; // [V]
     bool estimator_good_ = false;
+
+    HfiState hfi_state_ = HFI_STATE_OFF;
+    float hfi_voltage_ = 0.0f;                  // [V] injected on the d-axis in this cycle, alternates in sign
+    float hfi_response_[2] = {0.0f, 0.0f};      // [A] d and q current step due to the last injection
+    float hfi_response_sign_ = 1.0f;            // aligns the response with the injection
+    float hfi_saliency_ = 0.0f;                 // [A] half the d-axis response difference between d and q alignment
+    Pll<uint32_t> hfi_pll_;                     // [electrical revolution]
+    float hfi_I_alpha_beta_prev_[2] = {0.0f, 0.0f}; // [A]
 };
 
 #endif /* __SENSORLESS_ESTIMATOR_HPP */
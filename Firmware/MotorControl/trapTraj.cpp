@@ -57,6 +57,117 @@ bool TrapezoidalTrajectory::planTrapezoidal(float Xf, float Xi, float Vi,
     Xf_ = Xf;
     Vi_ = Vi;
     yAccel_ = Xi + Vi*Ta_ + 0.5f*Ar_*SQ(Ta_); // pos at end of accel phase
+    jerk_limited_ = false;
+
+    return true;
+}
+
+// Jerk limited change of velocity by dv >= 0: the acceleration ramps up to at
+// most A during Tj, stays constant during Tc and ramps down during Tj.
+static void plan_jerk_ramp(float dv, float A, float J, float* Tj, float* Tc) {
+    if (dv * J > SQ(A)) {
+        *Tj = A / J;
+        *Tc = dv / A - *Tj;
+    } else {
+        *Tj = sqrtf(dv / J);
+        *Tc = 0.0f;
+    }
+}
+
+// Evaluates a jerk ramp that starts at (X0, V0) and ends at (X1, V1) with
+// zero acceleration at both ends. J is the (signed) jerk of the first phase.
+static TrapezoidalTrajectory::Step_t eval_jerk_ramp(float t, float Tj, float Tc, float J,
+                                                    float X0, float V0, float X1, float V1) {
+    TrapezoidalTrajectory::Step_t trajStep;
+    if (t < Tj) {  // Acceleration ramping up
+        trajStep.Y   = X0 + V0*t + J*t*t*t / 6.0f;
+        trajStep.Yd  = V0 + 0.5f*J*SQ(t);
+        trajStep.Ydd = J*t;
+    } else if (t < Tj + Tc) {  // Constant acceleration
+        float A      = J*Tj;
+        float tc     = t - Tj;
+        float Vj     = V0 + 0.5f*A*Tj;
+        trajStep.Y   = X0 + V0*Tj + A*SQ(Tj) / 6.0f + Vj*tc + 0.5f*A*SQ(tc);
+        trajStep.Yd  = Vj + A*tc;
+        trajStep.Ydd = A;
+    } else {  // Acceleration ramping down
+        float td     = 2.0f*Tj + Tc - t;
+        trajStep.Y   = X1 - V1*td + J*td*td*td / 6.0f;
+        trajStep.Yd  = V1 - 0.5f*J*SQ(td);
+        trajStep.Ydd = J*td;
+    }
+    return trajStep;
+}
+
+// Plans a seven segment S-curve profile: a jerk limited accel stage from Vi
+// to the peak velocity Vr, a coasting stage and a jerk limited decel stage to
+// standstill at Xf. The initial acceleration is assumed to be zero.
+//
+// The peak velocity of short moves is found by bisection on the total
+// displacement.
+//
+// Returns false if the jerk limit is not positive.
+bool TrapezoidalTrajectory::planSCurve(float Xf, float Xi, float Vi,
+                                       float Vmax, float Amax, float Dmax, float Jmax) {
+    if (!(Jmax > 0.0f))
+        return false;
+
+    float Tj_stop, Tc_stop;
+    plan_jerk_ramp(std::abs(Vi), Dmax, Jmax, &Tj_stop, &Tc_stop);
+    float dX = Xf - Xi;  // Distance to travel
+    float stop_dist = 0.5f * std::abs(Vi) * (2.0f*Tj_stop + Tc_stop); // Minimum stopping distance
+    float dXstop = std::copysign(stop_dist, Vi); // Minimum stopping displacement
+    float s = sign_hard(dX - dXstop); // Sign of coast velocity (if any)
+
+    // Work with positive values in the direction of travel.
+    // Braking from the opposite direction and slowing down from over-speed
+    // are limited by Dmax.
+    float vi = s * Vi;
+    float dx = s * dX;
+    auto displacement = [&](float vp) {
+        float Tj, Tc;
+        plan_jerk_ramp(std::abs(vp - vi), (vi < 0.0f || vp < vi) ? Dmax : Amax, Jmax, &Tj, &Tc);
+        float dx_accel = 0.5f * (vi + vp) * (2.0f*Tj + Tc);
+        plan_jerk_ramp(vp, Dmax, Jmax, &Tj, &Tc);
+        return dx_accel + 0.5f * vp * (2.0f*Tj + Tc);
+    };
+
+    float vp = Vmax;
+    if (displacement(vp) > dx) {
+        // Short move: the peak velocity lies between Vmax, which overshoots,
+        // and the lowest possible peak velocity, which doesn't.
+        float v_over = Vmax;
+        float v_fit = (vi > Vmax) ? vi : std::max(vi, 0.0f);
+        for (int i = 0; i < 24; ++i) {
+            float mid = 0.5f * (v_over + v_fit);
+            if (displacement(mid) > dx) {
+                v_over = mid;
+            } else {
+                v_fit = mid;
+            }
+        }
+        vp = v_fit;
+    }
+
+    float ja = (vi < 0.0f || vp < vi) ? Dmax : Amax;
+    plan_jerk_ramp(std::abs(vp - vi), ja, Jmax, &Tja_, &Tca_);
+    plan_jerk_ramp(vp, Dmax, Jmax, &Tjd_, &Tcd_);
+    Ja_ = (vp < vi) ? -s * Jmax : s * Jmax;
+    Jd_ = -s * Jmax;
+    Ta_ = 2.0f*Tja_ + Tca_;
+    Td_ = 2.0f*Tjd_ + Tcd_;
+    Tv_ = (vp > 0.0f) ? std::max(0.0f, (dx - displacement(vp)) / vp) : 0.0f;
+
+    // Fill in the rest of the values used at evaluation-time
+    Vr_ = s * vp;
+    Ar_ = Ja_ * Tja_; // Peak acceleration
+    Dr_ = Jd_ * Tjd_; // Peak deceleration
+    Tf_ = Ta_ + Tv_ + Td_;
+    Xi_ = Xi;
+    Xf_ = Xf;
+    Vi_ = Vi;
+    yAccel_ = Xi + 0.5f*(Vi + Vr_)*Ta_; // pos at end of accel phase
+    jerk_limited_ = true;
 
     return true;
 }
@@ -67,6 +178,8 @@ TrapezoidalTrajectory::Step_t TrapezoidalTrajectory::eval(float t) {
         trajStep.Y   = Xi_;
         trajStep.Yd  = Vi_;
         trajStep.Ydd = 0.0f;
+    } else if (t < Ta_ && jerk_limited_) {  // Accelerating (S-curve)
+        trajStep = eval_jerk_ramp(t, Tja_, Tca_, Ja_, Xi_, Vi_, yAccel_, Vr_);
     } else if (t < Ta_) {  // Accelerating
         trajStep.Y   = Xi_ + Vi_*t + 0.5f*Ar_*SQ(t);
         trajStep.Yd  = Vi_ + Ar_*t;
@@ -75,6 +188,9 @@ TrapezoidalTrajectory::Step_t TrapezoidalTrajectory::eval(float t) {
         trajStep.Y   = yAccel_ + Vr_*(t - Ta_);
         trajStep.Yd  = Vr_;
         trajStep.Ydd = 0.0f;
+    } else if (t < Tf_ && jerk_limited_) {  // Deceleration (S-curve)
+        float Xd     = Xf_ - 0.5f*Vr_*Td_; // pos at start of decel phase
+        trajStep = eval_jerk_ramp(t - Ta_ - Tv_, Tjd_, Tcd_, Jd_, Xd, Vr_, Xf_, 0.0f);
     } else if (t < Tf_) {  // Deceleration
         float td     = t - Tf_;
         trajStep.Y   = Xf_ + 0.5f*Dr_*SQ(td);
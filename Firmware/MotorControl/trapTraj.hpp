@@ -7,6 +7,7 @@ public:
         float vel_limit = 2.0f;   // [turn/s]
         float accel_limit = 0.5f; // [turn/s^2]
         float decel_limit = 0.5f; // [turn/s^2]
+        float jerk_limit = 5.0f;  // [turn/s^3] (S-curve only)
     };
     
     struct Step_t {
@@ -17,6 +18,8 @@ public:
 
     bool planTrapezoidal(float Xf, float Xi, float Vi,
                          float Vmax, float Amax, float Dmax);
+    bool planSCurve(float Xf, float Xi, float Vi,
+                    float Vmax, float Amax, float Dmax, float Jmax);
     Step_t eval(float t);
 
     Axis* axis_ = nullptr;  // set by Axis constructor
@@ -37,6 +40,16 @@ public:
 
     float yAccel_;
 
+    // Jerk phases of the S-curve profile. Each of the accel and decel stages
+    // ramps the acceleration up, holds it and ramps it down again.
+    bool jerk_limited_ = false;
+    float Ja_;  // Jerk at the beginning of the accel stage (signed)
+    float Tja_; // Duration of each jerk phase of the accel stage
+    float Tca_; // Duration of constant acceleration in the accel stage
+    float Jd_;  // Jerk at the beginning of the decel stage (signed)
+    float Tjd_; // Duration of each jerk phase of the decel stage
+    float Tcd_; // Duration of constant deceleration in the decel stage
+
     float t_;
 };
 
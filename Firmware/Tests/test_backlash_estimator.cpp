@@ -0,0 +1,37 @@
+#include <doctest.h>
+#include <cmath>
+
+#include "MotorControl/backlash_estimator.hpp"
+
+static constexpr float fs = 8000.0f;
+
+// Deflection of a spring with play at the specified torque
+static float deflection(float torque, float offset, float compliance, float backlash) {
+    float play = (torque > 0.0f) ? 0.5f * backlash : (torque < 0.0f) ? -0.5f * backlash : 0.0f;
+    return offset + compliance * torque + play;
+}
+
+TEST_CASE("backlash estimator") {
+    BacklashEstimator estimator;
+    const float offset = 12.3f;
+    const float compliance = 0.002f;
+    const float backlash = 0.0005f;
+    for (int i = 0; i < 2 * (int)fs; ++i) {
+        // Torque that swings through zero with a load in one direction
+        float torque = 0.2f + 0.5f * sinf(2.0f * (float)M_PI * 3.0f * (float)i / fs);
+        estimator.update(torque, deflection(torque, offset, compliance, backlash), 1.0f / fs);
+    }
+    REQUIRE(estimator.valid_);
+    CHECK(estimator.compliance_ == doctest::Approx(compliance).epsilon(1e-3));
+    CHECK(estimator.backlash_ == doctest::Approx(backlash).epsilon(1e-2));
+    CHECK(estimator.offset_ == doctest::Approx(offset).epsilon(1e-6));
+}
+
+TEST_CASE("backlash estimator needs both directions") {
+    BacklashEstimator estimator;
+    for (int i = 0; i < 1000; ++i) {
+        float torque = 0.5f + 0.1f * sinf((float)i);
+        estimator.update(torque, deflection(torque, 1.0f, 0.01f, 0.001f), 1.0f / fs);
+    }
+    CHECK(!estimator.valid_);
+}
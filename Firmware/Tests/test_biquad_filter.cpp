@@ -0,0 +1,88 @@
+#include <doctest.h>
+#include <cmath>
+#include <complex>
+
+#include "MotorControl/biquad_filter.hpp"
+
+static constexpr float fs = 8000.0f;
+
+// Feeds a sine of the specified frequency through the filter and returns the
+// complex response after it settled.
+static std::complex<float> response(BiquadFilter filter, float freq) {
+    filter.reset();
+    const int periods = 20;
+    const int n = (int)std::round(periods * fs / freq);
+    std::complex<double> acc_in = 0.0;
+    std::complex<double> acc_out = 0.0;
+    for (int i = 0; i < 2 * n; ++i) {
+        double phase = 2.0 * M_PI * (double)periods * (double)i / (double)n;
+        float x = (float)std::sin(phase);
+        float y = filter.update(x);
+        if (i >= n) { // skip the transient
+            std::complex<double> rot = std::polar(1.0, -phase);
+            acc_in += (double)x * rot;
+            acc_out += (double)y * rot;
+        }
+    }
+    return std::complex<float>(acc_out / acc_in);
+}
+
+static float step_response(BiquadFilter filter, int samples) {
+    filter.reset();
+    float y = 0.0f;
+    for (int i = 0; i < samples; ++i)
+        y = filter.update(1.0f);
+    return y;
+}
+
+TEST_CASE("biquad passthrough") {
+    BiquadFilter filter;
+    CHECK(filter.update(1.5f) == 1.5f);
+    CHECK(filter.update(-2.0f) == -2.0f);
+}
+
+TEST_CASE("biquad lowpass") {
+    BiquadFilter filter;
+    REQUIRE(filter.set_lowpass(100.0f, M_SQRT1_2, fs));
+    CHECK(step_response(filter, 4000) == doctest::Approx(1.0f).epsilon(1e-4));
+    CHECK(std::abs(response(filter, 10.0f)) == doctest::Approx(1.0f).epsilon(0.01));
+    CHECK(std::abs(response(filter, 100.0f)) == doctest::Approx(M_SQRT1_2).epsilon(0.01));
+    CHECK(std::arg(response(filter, 100.0f)) == doctest::Approx(-M_PI / 2).epsilon(0.01));
+    CHECK(std::abs(response(filter, 1000.0f)) < 0.011f);
+}
+
+TEST_CASE("biquad notch") {
+    BiquadFilter filter;
+    REQUIRE(filter.set_notch(200.0f, 2.0f, 0.0f, fs));
+    CHECK(step_response(filter, 4000) == doctest::Approx(1.0f).epsilon(1e-4));
+    CHECK(std::abs(response(filter, 200.0f)) < 0.01f);
+    CHECK(std::abs(response(filter, 20.0f)) == doctest::Approx(1.0f).epsilon(0.01));
+    CHECK(std::abs(response(filter, 2000.0f)) == doctest::Approx(1.0f).epsilon(0.01));
+
+    // Partial notch
+    REQUIRE(filter.set_notch(200.0f, 2.0f, 0.25f, fs));
+    CHECK(std::abs(response(filter, 200.0f)) == doctest::Approx(0.25f).epsilon(0.01));
+}
+
+TEST_CASE("biquad lead-lag") {
+    BiquadFilter filter;
+    REQUIRE(filter.set_lead_lag(50.0f, 4.0f, fs));
+    CHECK(step_response(filter, 4000) == doctest::Approx(1.0f).epsilon(1e-4));
+
+    // Maximum phase lead asin((g-1)/(g+1)) at the specified frequency, with
+    // gain sqrt(g)
+    std::complex<float> center = response(filter, 50.0f);
+    CHECK(std::abs(center) == doctest::Approx(2.0f).epsilon(0.01));
+    CHECK(std::arg(center) == doctest::Approx(std::asin(3.0f / 5.0f)).epsilon(0.01));
+    CHECK(std::arg(response(filter, 40.0f)) < std::arg(center));
+    CHECK(std::arg(response(filter, 60.0f)) < std::arg(center));
+}
+
+TEST_CASE("biquad invalid parameters") {
+    BiquadFilter filter;
+    CHECK(!filter.set_lowpass(0.0f, 0.7f, fs));
+    CHECK(!filter.set_lowpass(4000.0f, 0.7f, fs));
+    CHECK(!filter.set_notch(100.0f, 0.0f, 0.0f, fs));
+    CHECK(!filter.set_lead_lag(100.0f, 0.0f, fs));
+    CHECK(filter.update(1.5f) == 1.5f);
+}
@@ -0,0 +1,102 @@
+#include <doctest.h>
+#include <cmath>
+
+#include "MotorControl/input_shaper.hpp"
+
+static constexpr float fs = 8000.0f;
+
+// Drives a lightly damped resonance at the specified frequency with a shaped
+// position step and returns the amplitude of the residual vibration.
+static float residual_vibration(InputShaper shaper, float freq, float damping) {
+    shaper.reset({0.0f, 0.0f, 0.0f});
+    const double omega = 2.0 * M_PI * freq;
+    const double dt = 1.0 / fs;
+    double x = 0.0, v = 0.0;
+    double max_err = 0.0;
+    for (int i = 0; i < 4 * (int)fs; ++i) {
+        double u = shaper.update({1.0f, 0.0f, 0.0f}).pos;
+        double a = omega * omega * (u - x) - 2.0 * damping * omega * v;
+        v += a * dt;
+        x += v * dt;
+        if (i > 2 * (int)fs) // after the shaper finished
+            max_err = std::max(max_err, std::abs(x - 1.0));
+    }
+    // The amplitude decays over the first 2s
+    return (float)(max_err * std::exp(2.0 * damping * omega));
+}
+
+TEST_CASE("input shaper passthrough") {
+    InputShaper shaper;
+    InputShaper::Sample_t out = shaper.update({1.5f, 2.0f, 3.0f});
+    CHECK(out.pos == 1.5f);
+    CHECK(out.vel == 2.0f);
+    CHECK(out.torque == 3.0f);
+}
+
+TEST_CASE("input shaper zv step") {
+    InputShaper shaper;
+    REQUIRE(shaper.set_zv(10.0f, 0.0f, fs));
+    shaper.reset({0.0f, 0.0f, 0.0f});
+    // Two equal impulses 50ms apart. The history is recorded every 4th
+    // sample, so the second one is spread over 4 samples.
+    for (int i = 0; i < 396; ++i)
+        CHECK(shaper.update({1.0f, 0.0f, 2.0f}).torque == doctest::Approx(1.0f));
+    InputShaper::Sample_t out;
+    for (int i = 0; i < 8; ++i)
+        out = shaper.update({1.0f, 0.0f, 2.0f});
+    CHECK(out.pos == doctest::Approx(1.0f));
+    CHECK(out.torque == doctest::Approx(2.0f));
+}
+
+TEST_CASE("input shaper delays with decimation") {
+    // A 2Hz ZVD shaper spans 0.5s, so the history is decimated
+    InputShaper shaper;
+    REQUIRE(shaper.set_zvd(2.0f, 0.1f, fs));
+    float damped_period = 0.5f / sqrtf(1.0f - 0.01f);
+    float k = expf(-0.1f * M_PI / sqrtf(1.0f - 0.01f));
+    float a[] = {1.0f, 2.0f * k, k * k};
+    float sum = a[0] + a[1] + a[2];
+
+    // The interpolation is exact for a cubic position profile
+    auto profile = [](float t) { return InputShaper::Sample_t{t * t * t, 3.0f * t * t, 6.0f * t}; };
+    shaper.reset(profile(0.0f));
+    for (int i = 1; i <= (int)fs; ++i) {
+        float t = (float)i / fs;
+        InputShaper::Sample_t out = shaper.update(profile(t));
+        if (i % 997 == 0) {
+            float pos = 0.0f, vel = 0.0f;
+            for (int j = 0; j < 3; ++j) {
+                float tj = std::max(t - 0.5f * damped_period * (float)j, 0.0f);
+                pos += a[j] / sum * profile(tj).pos;
+                vel += a[j] / sum * profile(tj).vel;
+            }
+            CHECK(out.pos == doctest::Approx(pos).epsilon(1e-4));
+            CHECK(out.vel == doctest::Approx(vel).epsilon(1e-2));
+        }
+    }
+}
+
+TEST_CASE("input shaper residual vibration") {
+    InputShaper shaper;
+    CHECK(residual_vibration(shaper, 5.0f, 0.05f) > 0.5f);
+
+    REQUIRE(shaper.set_zv(5.0f, 0.05f, fs));
+    CHECK(residual_vibration(shaper, 5.0f, 0.05f) < 0.01f);
+    float zv_off_nominal = residual_vibration(shaper, 5.5f, 0.05f);
+
+    REQUIRE(shaper.set_zvd(5.0f, 0.05f, fs));
+    CHECK(residual_vibration(shaper, 5.0f, 0.05f) < 0.01f);
+    CHECK(residual_vibration(shaper, 5.5f, 0.05f) < 0.5f * zv_off_nominal);
+
+    REQUIRE(shaper.set_ei(5.0f, 0.05f, fs));
+    CHECK(residual_vibration(shaper, 5.0f, 0.05f) < 1.5f * InputShaper::EI_TOLERANCE);
+    CHECK(residual_vibration(shaper, 6.0f, 0.05f) < InputShaper::EI_TOLERANCE * 1.5f);
+}
+
+TEST_CASE("input shaper invalid parameters") {
+    InputShaper shaper;
+    CHECK(!shaper.set_zv(0.0f, 0.0f, fs));
+    CHECK(!shaper.set_zvd(10.0f, 1.0f, fs));
+    CHECK(!shaper.set_ei(10.0f, -0.1f, fs));
+    CHECK(shaper.update({1.5f, 0.0f, 0.0f}).pos == 1.5f);
+}
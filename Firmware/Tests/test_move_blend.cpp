@@ -0,0 +1,91 @@
+#include <doctest.h>
+#include <cmath>
+
+#include "MotorControl/move_blend.hpp"
+
+struct Limits {
+    float vel_limit;
+    float accel_limit;
+    float decel_limit;
+};
+
+// Trapezoidal profile of a path parameter from 0 to 1, limited like
+// CoordinatedMoveQueue::push() does for the specified axis distances
+struct Path {
+    Path(const float* delta, const Limits* limits, size_t n_axes) {
+        float vel = INFINITY, accel = INFINITY, decel = INFINITY;
+        for (size_t i = 0; i < n_axes; ++i) {
+            float distance = std::abs(delta[i]);
+            if (distance > 0.0f) {
+                vel = std::min(vel, limits[i].vel_limit / distance);
+                accel = std::min(accel, limits[i].accel_limit / distance);
+                decel = std::min(decel, limits[i].decel_limit / distance);
+            }
+        }
+        Vr_ = std::min(vel, std::sqrt(2.0f * accel * decel / (accel + decel)));
+        Ar_ = accel;
+        Dr_ = -decel;
+        Ta_ = Vr_ / accel;
+        Td_ = Vr_ / decel;
+        Tv_ = (1.0f - 0.5f * Vr_ * (Ta_ + Td_)) / Vr_;
+        Tf_ = Ta_ + Tv_ + Td_;
+    }
+
+    float Ta_, Tv_, Td_, Tf_;
+    float Vr_, Ar_, Dr_;
+};
+
+// Returns the largest ratio of the summed velocity of an axis to its
+// vel_limit while both moves run
+static float max_vel_ratio(const Path& move, const float* move_delta,
+                           const Path& next, const float* next_delta,
+                           const Limits* limits, size_t n_axes, float start) {
+    float ratio = 0.0f;
+    for (float t = 0.0f; t < start + next.Tf_; t += 1e-3f) {
+        for (size_t i = 0; i < n_axes; ++i) {
+            float vel = move_delta[i] * blend_path_vel(move, t) + next_delta[i] * blend_path_vel(next, t - start);
+            ratio = std::max(ratio, std::abs(vel) / limits[i].vel_limit);
+        }
+    }
+    return ratio;
+}
+
+TEST_CASE("blend corner") {
+    const Limits limits[] = {{2.0f, 4.0f, 4.0f}, {2.0f, 4.0f, 4.0f}};
+    const float delta0[] = {1.0f, 0.0f};
+    const float delta1[] = {0.0f, 1.0f};
+    Path move(delta0, limits, 2), next(delta1, limits, 2);
+
+    // The axes don't interact, so the next move starts right away
+    CHECK(blend_start(move, delta0, next, delta1, limits, 2, 0.0f) == doctest::Approx(move.Ta_ + move.Tv_));
+}
+
+TEST_CASE("blend reversal") {
+    const Limits limits[] = {{2.0f, 4.0f, 4.0f}, {2.0f, 4.0f, 4.0f}};
+    const float delta0[] = {1.0f, 0.0f};
+    const float delta1[] = {-1.0f, 0.0f};
+    Path move(delta0, limits, 2), next(delta1, limits, 2);
+
+    // Overlapping the moves would sum the deceleration and the acceleration
+    CHECK(!blend_is_within_limits(move, delta0, next, delta1, limits, 2, move.Ta_ + move.Tv_));
+    CHECK(blend_start(move, delta0, next, delta1, limits, 2, 0.0f) == doctest::Approx(move.Tf_));
+}
+
+TEST_CASE("blend collinear") {
+    // Accelerating faster than decelerating would overshoot the velocity
+    // limit if the next move started at the beginning of the deceleration
+    const Limits limits[] = {{2.0f, 8.0f, 2.0f}};
+    const float delta0[] = {2.0f};
+    const float delta1[] = {2.0f};
+    Path move(delta0, limits, 1), next(delta1, limits, 1);
+    REQUIRE(move.Tv_ > 0.0f);
+    CHECK(max_vel_ratio(move, delta0, next, delta1, limits, 1, move.Ta_ + move.Tv_) > 1.1f);
+
+    float start = blend_start(move, delta0, next, delta1, limits, 1, 0.0f);
+    CHECK(start > move.Ta_ + move.Tv_);
+    CHECK(start < move.Tf_);
+    CHECK(max_vel_ratio(move, delta0, next, delta1, limits, 1, start) < 1.001f);
+
+    // A later start is respected
+    CHECK(blend_start(move, delta0, next, delta1, limits, 1, move.Tf_ - 0.01f) == doctest::Approx(move.Tf_ - 0.01f));
+}
@@ -0,0 +1,61 @@
+#include <doctest.h>
+#include <cmath>
+
+#include "MotorControl/pll.hpp"
+
+static constexpr float period = 1.0f / 8000.0f;
+
+TEST_CASE("pll gains") {
+    Pll<int64_t> pll;
+    CHECK(pll.set_bandwidth(1000.0f, period));
+    CHECK(pll.kp() == doctest::Approx(2000.0f));
+    CHECK(pll.ki() == doctest::Approx(1e6f));
+    CHECK(!pll.set_bandwidth(5000.0f, period));
+}
+
+TEST_CASE("pll wrapping phase") {
+    // Track a phase that turns at 50 cycle/s and wraps around many times
+    Pll<uint32_t> pll;
+    REQUIRE(pll.set_bandwidth(1000.0f, period));
+    const float vel = 50.0f;
+    double phase = 0.7;
+    float delta = 0.0f;
+    for (int i = 0; i < 8000; ++i) {
+        phase += (double)(vel * period);
+        uint32_t measured = (uint32_t)(int64_t)std::round((phase - std::floor(phase)) * 4294967296.0);
+        delta = pll.update(measured, period);
+    }
+    CHECK(std::abs(delta) < 1e-4f);
+    CHECK(pll.vel_ == doctest::Approx(vel).epsilon(1e-3));
+
+    // The error is taken modulo one cycle
+    pll.reset(Pll<uint32_t>::from_float(0.9f));
+    CHECK(pll.error(Pll<uint32_t>::from_float(0.1f)) == doctest::Approx(0.2f).epsilon(1e-4));
+    CHECK(pll.error(Pll<uint32_t>::from_float(-0.3f)) == doctest::Approx(-0.2f).epsilon(1e-4));
+}
+
+TEST_CASE("pll conversion saturates") {
+    const int64_t max = (int64_t)(Pll<int64_t>::MAX_CYCLES * Pll<int64_t>::ONE);
+    CHECK(Pll<int64_t>::from_float(-2.5f) == -((int64_t)5 << 31));
+    CHECK(Pll<int64_t>::from_float(1e10f) == max);
+    CHECK(Pll<int64_t>::from_float(-1e10f) == -max);
+    CHECK(Pll<int64_t>::from_float(INFINITY) == max);
+    CHECK(Pll<int64_t>::from_float(NAN) == max);
+}
+
+TEST_CASE("pll position far from zero") {
+    // At 1e8 counts a float has a resolution of 8 counts, but the estimate
+    // must still follow a slow ramp smoothly.
+    Pll<int64_t> pll;
+    REQUIRE(pll.set_bandwidth(1000.0f, period));
+    const int64_t start = (int64_t)100000000 << 32;
+    const float vel = 20.0f; // [cycle/s], 0.0025 cycle per sample
+    pll.reset(start, vel);
+    double pos = 0.0;
+    for (int i = 0; i < 8000; ++i) {
+        pos += (double)(vel * period);
+        pll.update(start + (int64_t)std::round(pos * 4294967296.0), period);
+    }
+    CHECK(pll.vel_ == doctest::Approx(vel).epsilon(1e-4));
+    CHECK(Pll<int64_t>::to_float(pll.phase_ - start) == doctest::Approx((float)pos).epsilon(1e-4));
+}
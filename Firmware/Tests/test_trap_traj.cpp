@@ -1,6 +1,7 @@
 
 #include <doctest.h>
 #include <limits.h>
+#include <float.h>
 #include <cmath>
 #include <iostream>
 #include <random>
@@ -21,6 +22,8 @@ public:
     explicit TrapezoidalTrajectory();
     bool planTrapezoidal(float Xf, float Xi, float Vi,
                          float Vmax, float Amax, float Dmax);
+    bool planSCurve(float Xf, float Xi, float Vi,
+                    float Vmax, float Amax, float Dmax, float Jmax);
     Step_t eval(float t);
 
     float Xi_;
@@ -38,6 +41,16 @@ public:
 
     float yAccel_;
 
+    // Jerk phases of the S-curve profile. Each of the accel and decel stages
+    // ramps the acceleration up, holds it and ramps it down again.
+    bool jerk_limited_ = false;
+    float Ja_;  // Jerk at the beginning of the accel stage (signed)
+    float Tja_; // Duration of each jerk phase of the accel stage
+    float Tca_; // Duration of constant acceleration in the accel stage
+    float Jd_;  // Jerk at the beginning of the decel stage (signed)
+    float Tjd_; // Duration of each jerk phase of the decel stage
+    float Tcd_; // Duration of constant deceleration in the decel stage
+
     float t_;
 };
 
@@ -101,6 +114,117 @@ bool TrapezoidalTrajectory::planTrapezoidal(float Xf, float Xi, float Vi,
     Xf_ = Xf;
     Vi_ = Vi;
     yAccel_ = Xi + Vi*Ta_ + 0.5f*Ar_*SQ(Ta_); // pos at end of accel phase
+    jerk_limited_ = false;
+
+    return true;
+}
+
+// Jerk limited change of velocity by dv >= 0: the acceleration ramps up to at
+// most A during Tj, stays constant during Tc and ramps down during Tj.
+static void plan_jerk_ramp(float dv, float A, float J, float* Tj, float* Tc) {
+    if (dv * J > SQ(A)) {
+        *Tj = A / J;
+        *Tc = dv / A - *Tj;
+    } else {
+        *Tj = sqrtf(dv / J);
+        *Tc = 0.0f;
+    }
+}
+
+// Evaluates a jerk ramp that starts at (X0, V0) and ends at (X1, V1) with
+// zero acceleration at both ends. J is the (signed) jerk of the first phase.
+static TrapezoidalTrajectory::Step_t eval_jerk_ramp(float t, float Tj, float Tc, float J,
+                                                    float X0, float V0, float X1, float V1) {
+    TrapezoidalTrajectory::Step_t trajStep;
+    if (t < Tj) {  // Acceleration ramping up
+        trajStep.Y   = X0 + V0*t + J*t*t*t / 6.0f;
+        trajStep.Yd  = V0 + 0.5f*J*SQ(t);
+        trajStep.Ydd = J*t;
+    } else if (t < Tj + Tc) {  // Constant acceleration
+        float A      = J*Tj;
+        float tc     = t - Tj;
+        float Vj     = V0 + 0.5f*A*Tj;
+        trajStep.Y   = X0 + V0*Tj + A*SQ(Tj) / 6.0f + Vj*tc + 0.5f*A*SQ(tc);
+        trajStep.Yd  = Vj + A*tc;
+        trajStep.Ydd = A;
+    } else {  // Acceleration ramping down
+        float td     = 2.0f*Tj + Tc - t;
+        trajStep.Y   = X1 - V1*td + J*td*td*td / 6.0f;
+        trajStep.Yd  = V1 - 0.5f*J*SQ(td);
+        trajStep.Ydd = J*td;
+    }
+    return trajStep;
+}
+
+// Plans a seven segment S-curve profile: a jerk limited accel stage from Vi
+// to the peak velocity Vr, a coasting stage and a jerk limited decel stage to
+// standstill at Xf. The initial acceleration is assumed to be zero.
+//
+// The peak velocity of short moves is found by bisection on the total
+// displacement.
+//
+// Returns false if the jerk limit is not positive.
+bool TrapezoidalTrajectory::planSCurve(float Xf, float Xi, float Vi,
+                                       float Vmax, float Amax, float Dmax, float Jmax) {
+    if (!(Jmax > 0.0f))
+        return false;
+
+    float Tj_stop, Tc_stop;
+    plan_jerk_ramp(std::abs(Vi), Dmax, Jmax, &Tj_stop, &Tc_stop);
+    float dX = Xf - Xi;  // Distance to travel
+    float stop_dist = 0.5f * std::abs(Vi) * (2.0f*Tj_stop + Tc_stop); // Minimum stopping distance
+    float dXstop = std::copysign(stop_dist, Vi); // Minimum stopping displacement
+    float s = sign_hard(dX - dXstop); // Sign of coast velocity (if any)
+
+    // Work with positive values in the direction of travel.
+    // Braking from the opposite direction and slowing down from over-speed
+    // are limited by Dmax.
+    float vi = s * Vi;
+    float dx = s * dX;
+    auto displacement = [&](float vp) {
+        float Tj, Tc;
+        plan_jerk_ramp(std::abs(vp - vi), (vi < 0.0f || vp < vi) ? Dmax : Amax, Jmax, &Tj, &Tc);
+        float dx_accel = 0.5f * (vi + vp) * (2.0f*Tj + Tc);
+        plan_jerk_ramp(vp, Dmax, Jmax, &Tj, &Tc);
+        return dx_accel + 0.5f * vp * (2.0f*Tj + Tc);
+    };
+
+    float vp = Vmax;
+    if (displacement(vp) > dx) {
+        // Short move: the peak velocity lies between Vmax, which overshoots,
+        // and the lowest possible peak velocity, which doesn't.
+        float v_over = Vmax;
+        float v_fit = (vi > Vmax) ? vi : std::max(vi, 0.0f);
+        for (int i = 0; i < 24; ++i) {
+            float mid = 0.5f * (v_over + v_fit);
+            if (displacement(mid) > dx) {
+                v_over = mid;
+            } else {
+                v_fit = mid;
+            }
+        }
+        vp = v_fit;
+    }
+
+    float ja = (vi < 0.0f || vp < vi) ? Dmax : Amax;
+    plan_jerk_ramp(std::abs(vp - vi), ja, Jmax, &Tja_, &Tca_);
+    plan_jerk_ramp(vp, Dmax, Jmax, &Tjd_, &Tcd_);
+    Ja_ = (vp < vi) ? -s * Jmax : s * Jmax;
+    Jd_ = -s * Jmax;
+    Ta_ = 2.0f*Tja_ + Tca_;
+    Td_ = 2.0f*Tjd_ + Tcd_;
+    Tv_ = (vp > 0.0f) ? std::max(0.0f, (dx - displacement(vp)) / vp) : 0.0f;
+
+    // Fill in the rest of the values used at evaluation-time
+    Vr_ = s * vp;
+    Ar_ = Ja_ * Tja_; // Peak acceleration
+    Dr_ = Jd_ * Tjd_; // Peak deceleration
+    Tf_ = Ta_ + Tv_ + Td_;
+    Xi_ = Xi;
+    Xf_ = Xf;
+    Vi_ = Vi;
+    yAccel_ = Xi + 0.5f*(Vi + Vr_)*Ta_; // pos at end of accel phase
+    jerk_limited_ = true;
 
     return true;
 }
@@ -111,6 +235,8 @@ TrapezoidalTrajectory::Step_t TrapezoidalTrajectory::eval(float t) {
         trajStep.Y   = Xi_;
         trajStep.Yd  = Vi_;
         trajStep.Ydd = 0.0f;
+    } else if (t < Ta_ && jerk_limited_) {  // Accelerating (S-curve)
+        trajStep = eval_jerk_ramp(t, Tja_, Tca_, Ja_, Xi_, Vi_, yAccel_, Vr_);
     } else if (t < Ta_) {  // Accelerating
         trajStep.Y   = Xi_ + Vi_*t + 0.5f*Ar_*SQ(t);
         trajStep.Yd  = Vi_ + Ar_*t;
@@ -119,6 +245,9 @@ TrapezoidalTrajectory::Step_t TrapezoidalTrajectory::eval(float t) {
         trajStep.Y   = yAccel_ + Vr_*(t - Ta_);
         trajStep.Yd  = Vr_;
         trajStep.Ydd = 0.0f;
+    } else if (t < Tf_ && jerk_limited_) {  // Deceleration (S-curve)
+        float Xd     = Xf_ - 0.5f*Vr_*Td_; // pos at start of decel phase
+        trajStep = eval_jerk_ramp(t - Ta_ - Tv_, Tjd_, Tcd_, Jd_, Xd, Vr_, Xf_, 0.0f);
     } else if (t < Tf_) {  // Deceleration
         float td     = t - Tf_;
         trajStep.Y   = Xf_ + 0.5f*Dr_*SQ(td);
@@ -200,6 +329,54 @@ void run_trajectory_test(float goal, float position, float velocity, float Vmax,
     CHECK(velocity <= Dmax * dt);
 }
 
+void run_scurve_test(float goal, float position, float velocity, float Vmax, float Amax, float Dmax, float Jmax) {
+    float dt = 0.000125f;
+    float t = dt; // t = 0 is the initial state
+    float Vmax_test = std::max(Vmax, std::abs(velocity));
+    float Amax_test = std::max(Amax, Dmax);
+    float accel = 0.0f;
+    float pos_range = std::max(std::abs(goal), std::abs(position));
+
+    TrapezoidalTrajectory traj{};
+    REQUIRE(traj.planSCurve(goal, position, velocity, Vmax, Amax, Dmax, Jmax));
+
+    do {
+        TrapezoidalTrajectory::Step_t step = traj.eval(t);
+        t += dt;
+
+        // Check if jerk within bounds
+        CHECK(std::abs(step.Ydd - accel) / dt <= Jmax * 1.002f);
+        accel = step.Ydd;
+
+        // Check if acceleration within bounds
+        // (the finite difference is limited by the float resolution at high velocities)
+        CHECK(std::abs(step.Ydd) <= Amax_test * 1.002f);
+        CHECK(std::abs(step.Yd - velocity) / dt <= Amax_test * 1.005f);
+
+        // Check if velocity within bounds
+        CHECK(std::abs(step.Yd) <= Vmax_test * 1.002f);
+        CHECK(std::abs(step.Y - position) / dt <= Vmax_test * 1.002f);
+
+        // Check if position is consistent with velocity (up to float resolution)
+        pos_range = std::max(pos_range, std::abs(step.Y));
+        float pos_resolution = 8.0f * FLT_EPSILON * pos_range;
+        CHECK(std::abs((step.Y - position) / dt - 0.5f * (step.Yd + velocity)) <= 1.0f + pos_resolution / dt);
+        velocity = step.Yd;
+        position = step.Y;
+
+    } while (t <= traj.Tf_);
+
+    // The profile must end at the goal with zero velocity and acceleration
+    CHECK(std::abs(position - goal) <= 1.0f);
+    CHECK(std::abs(velocity) <= Jmax * SQ(dt));
+    CHECK(std::abs(accel) <= Jmax * dt);
+
+    TrapezoidalTrajectory::Step_t end = traj.eval(traj.Tf_ + dt);
+    CHECK(end.Y == goal);
+    CHECK(end.Yd == 0.0f);
+    CHECK(end.Ydd == 0.0f);
+}
+
 
 TEST_SUITE("Trajectory Planner") {
     // these form a triangle trajectory because 2*v^2/(2*a) = 2 * 27712^2 / (2*22288) = 34456 > 16384
@@ -232,4 +409,44 @@ TEST_SUITE("Trajectory Planner") {
     TEST_CASE("pos-dir-over-speed") {
         run_trajectory_test(8192.0f, -8192.0f, 40000.0f, 27712.0f, 22288.0f, 22288.0f);
     }
+
+    // Jerk limited (S-curve) profiles. With a jerk of 200000 it takes
+    // 22288 / 200000 = 0.11s to reach the acceleration limit.
+    TEST_CASE("scurve-neg-dir-triangle") {
+        run_scurve_test(-8192.0f, 8192.0f, 0.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-pos-dir-triangle") {
+        run_scurve_test(8192.0f, -8192.0f, 0.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-pos-dir-trapezoid") {
+        run_scurve_test(25000.0f, -25000.0f, 0.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-neg-dir-trapezoid") {
+        run_scurve_test(-25000.0f, 25000.0f, 0.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-accel-limit-not-reached") {
+        run_scurve_test(100.0f, 0.0f, 0.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-asymmetric-limits") {
+        run_scurve_test(25000.0f, -25000.0f, 0.0f, 27712.0f, 30000.0f, 10000.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-initial-velocity") {
+        run_scurve_test(25000.0f, -25000.0f, 10000.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-neg-dir-not-enough-braking-distance") {
+        run_scurve_test(-8192.0f, 8192.0f, -27712.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-pos-dir-not-enough-braking-distance") {
+        run_scurve_test(8192.0f, -8192.0f, 27712.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-pos-dir-over-speed") {
+        run_scurve_test(8192.0f, -8192.0f, 40000.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-pos-dir-over-speed-long") {
+        run_scurve_test(80000.0f, -8192.0f, 40000.0f, 27712.0f, 22288.0f, 22288.0f, 200000.0f);
+    }
+    TEST_CASE("scurve-invalid-jerk") {
+        TrapezoidalTrajectory traj{};
+        CHECK(!traj.planSCurve(1.0f, 0.0f, 0.0f, 2.0f, 0.5f, 0.5f, 0.0f));
+    }
 }
@@ -34,9 +34,24 @@ tup.frule{
 
 board_v3 = {
     dir = 'Board/v3',
-    sources = {'Drivers/DRV8301/drv8301.cpp', 'Board/v3/board.cpp'},
-    flags = {'-DSTM32F405xx', '-DARM_MATH_CM4', '-mcpu=cortex-m4', '-mfpu=fpv4-sp-d16'},
-    ldflags = {'-TBoard/v3/STM32F405RGTx_FLASH.ld', '-LBoard/v3/Drivers/CMSIS/Lib', '-larm_cortexM4lf_math', '-mcpu=cortex-m4', '-mfpu=fpv4-sp-d16'}
+    toolchain_prefix = 'arm-none-eabi-',
+    sources = {'Drivers/DRV8301/drv8301.cpp', 'Board/v3/board.cpp', 'syscalls.c', 'Drivers/STM32/stm32_nvm.c', 'Drivers/STM32/stm32_table_storage.c', 'FreeRTOS-openocd.c'},
+    flags = {'-DSTM32F405xx', '-DARM_MATH_CM4', '-mcpu=cortex-m4', '-mfpu=fpv4-sp-d16', '-mthumb', '-mfloat-abi=hard'},
+    ldflags = {'-TBoard/v3/STM32F405RGTx_FLASH.ld', '-LBoard/v3/Drivers/CMSIS/Lib', '-larm_cortexM4lf_math', '-mcpu=cortex-m4', '-mfpu=fpv4-sp-d16',
+               '-lnosys -mthumb -mfloat-abi=hard -specs=nosys.specs -specs=nano.specs -u _printf_float -u _scanf_float',
+               '-Wl,--undefined=uxTopUsedPriority'}
+}
+
+-- Runs the firmware as a Linux process against a simulated motor. The
+-- platform code is replaced by the HAL and CMSIS-RTOS shims in Board/sim.
+board_sim = {
+    dir = 'Board/sim',
+    toolchain_prefix = '',
+    platform_sources = {'Board/sim/cmsis_os_sim.cpp', 'Board/sim/sim_nvm.c', 'Board/sim/sim_table_storage.c'},
+    platform_includes = {'Board/sim/Inc'},
+    sources = {'Board/sim/board.cpp', 'Board/sim/stm32_sim.cpp', 'Board/sim/sim_engine.cpp', 'Board/sim/sim_plant.cpp', 'Board/sim/sim_tcp.cpp'},
+    flags = {'-DSTM32F405xx'},
+    ldflags = {'-lpthread'}
 }
 
 -- Switch between board versions
@@ -77,6 +92,10 @@ elseif boardversion == "v3.6-56V" then
     board = board_v3
     board.flags += "-DHW_VERSION_MAJOR=3 -DHW_VERSION_MINOR=6"
     board.flags += "-DHW_VERSION_VOLTAGE=56"
+elseif boardversion == "sim" then
+    board = board_sim
+    board.flags += "-DHW_VERSION_MAJOR=3 -DHW_VERSION_MINOR=6"
+    board.flags += "-DHW_VERSION_VOLTAGE=56"
 elseif boardversion == "" then
     error("board version not specified - take a look at tup.config.default")
 else
@@ -130,15 +149,12 @@ FLAGS += '-D__weak="__attribute__((weak))"'
 FLAGS += '-D__packed="__attribute__((__packed__))"'
 FLAGS += '-DUSE_HAL_DRIVER'
 
-FLAGS += '-mthumb'
-FLAGS += '-mfloat-abi=hard'
 FLAGS += { '-Wall', '-Wdouble-promotion', '-Wfloat-conversion', '-fdata-sections', '-ffunction-sections'}
 
 -- linker flags
 LDFLAGS += board.ldflags
-LDFLAGS += '-lc -lm -lnosys' -- libs
-LDFLAGS += '-mthumb -mfloat-abi=hard -specs=nosys.specs -specs=nano.specs -u _printf_float -u _scanf_float -Wl,--cref -Wl,--gc-sections'
-LDFLAGS += '-Wl,--undefined=uxTopUsedPriority'
+LDFLAGS += '-lc -lm' -- libs
+LDFLAGS += '-Wl,--cref -Wl,--gc-sections'
 
 -- debug build
 if tup.getconfig("DEBUG") == "true" then
@@ -153,17 +169,26 @@ OPT += '-ffast-math -fno-finite-math-only'
 tup.append_table(FLAGS, OPT)
 tup.append_table(LDFLAGS, OPT)
 
-toolchain = GCCToolchain('arm-none-eabi-', 'build', FLAGS, LDFLAGS)
+toolchain = GCCToolchain(board.toolchain_prefix, 'build', FLAGS, LDFLAGS)
 
 
--- Load list of source files Makefile that was autogenerated by CubeMX
-vars = parse_makefile_vars(board.dir..'/Makefile')
-all_stm_sources = (vars['C_SOURCES'] or '')..' '..(vars['CPP_SOURCES'] or '')..' '..(vars['ASM_SOURCES'] or '')
-for src in string.gmatch(all_stm_sources, "%S+") do
-    stm_sources += board.dir..'/'..src
-end
-for src in string.gmatch(vars['C_INCLUDES'] or '', "%S+") do
-    stm_includes += board.dir..'/'..string.sub(src, 3, -1) -- remove "-I" from each include path
+if board.platform_sources then
+    for _,src in pairs(board.platform_sources) do
+        stm_sources += src
+    end
+    for _,inc in pairs(board.platform_includes) do
+        stm_includes += inc
+    end
+else
+    -- Load list of source files Makefile that was autogenerated by CubeMX
+    vars = parse_makefile_vars(board.dir..'/Makefile')
+    all_stm_sources = (vars['C_SOURCES'] or '')..' '..(vars['CPP_SOURCES'] or '')..' '..(vars['ASM_SOURCES'] or '')
+    for src in string.gmatch(all_stm_sources, "%S+") do
+        stm_sources += board.dir..'/'..src
+    end
+    for src in string.gmatch(vars['C_INCLUDES'] or '', "%S+") do
+        stm_includes += board.dir..'/'..string.sub(src, 3, -1) -- remove "-I" from each include path
+    end
 end
 
 -- TODO: cleaner separation of the platform code and the rest
@@ -179,7 +204,6 @@ build{
 }
 
 sources = {
-    'syscalls.c',
     'MotorControl/utils.cpp',
     'MotorControl/arm_sin_f32.c',
     'MotorControl/arm_cos_f32.c',
@@ -193,11 +217,12 @@ sources = {
     'MotorControl/controller.cpp',
     'MotorControl/sensorless_estimator.cpp',
     'MotorControl/trapTraj.cpp',
+    'MotorControl/coordinated_move.cpp',
+    'MotorControl/autotuner.cpp',
     'MotorControl/pwm_input.cpp',
     'MotorControl/main.cpp',
     'Drivers/STM32/stm32_system.cpp',
     'Drivers/STM32/stm32_gpio.cpp',
-    'Drivers/STM32/stm32_nvm.c',
     'Drivers/STM32/stm32_spi_arbiter.cpp',
     'communication/can_simple.cpp',
     'communication/communication.cpp',
@@ -207,7 +232,6 @@ sources = {
     'communication/interface_can.cpp',
     'communication/interface_i2c.cpp',
     'fibre/cpp/protocol.cpp',
-    'FreeRTOS-openocd.c',
     'autogen/version.c'
 }
 tup.append_table(sources, board.sources)
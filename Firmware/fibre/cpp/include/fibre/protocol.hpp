@@ -9,6 +9,7 @@ see protocol.md for the protocol specification
 #define assert(expr)
 
 #include <functional>
+#include <optional>
 #include <limits>
 #include <cmath>
 //#include <stdint.h>
@@ -451,23 +452,27 @@ struct format_traits_t;
 //     static constexpr const char * fmt = "%f";
 //     static constexpr const char * fmtp = "%f";
 // };
-template<> struct format_traits_t<int64_t> { using type = void;
+template<> struct format_traits_t<long long> { using type = void;
     static constexpr const char * fmt = "%lld";
     static constexpr const char * fmtp = "%lld";
 };
-template<> struct format_traits_t<uint64_t> { using type = void;
+template<> struct format_traits_t<unsigned long long> { using type = void;
     static constexpr const char * fmt = "%llu";
     static constexpr const char * fmtp = "%llu";
 };
-template<> struct format_traits_t<int32_t> { using type = void;
+template<> struct format_traits_t<long> { using type = void;
     static constexpr const char * fmt = "%ld";
     static constexpr const char * fmtp = "%ld";
 };
-template<> struct format_traits_t<uint32_t> { using type = void;
+template<> struct format_traits_t<unsigned long> { using type = void;
     static constexpr const char * fmt = "%lu";
     static constexpr const char * fmtp = "%lu";
 };
 // TODO: change all overloads to fundamental int type space
+template<> struct format_traits_t<int> { using type = void;
+    static constexpr const char * fmt = "%d";
+    static constexpr const char * fmtp = "%d";
+};
 template<> struct format_traits_t<unsigned int> { using type = void;
     static constexpr const char * fmt = "%ud";
     static constexpr const char * fmtp = "%ud";
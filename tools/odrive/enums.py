@@ -36,6 +36,8 @@ AXIS_STATE_CLOSED_LOOP_CONTROL           = 8
 AXIS_STATE_LOCKIN_SPIN                   = 9
 AXIS_STATE_ENCODER_DIR_FIND              = 10
 AXIS_STATE_HOMING                        = 11
+AXIS_STATE_INERTIA_IDENTIFICATION        = 12
+AXIS_STATE_AUTOTUNING                    = 13
 
 # ODrive.ThermistorCurrentLimiter.Error
 THERMISTOR_CURRENT_LIMITER_ERROR_NONE    = 0x00000000
@@ -56,6 +58,18 @@ CONTROL_MODE_TORQUE_CONTROL              = 1
 CONTROL_MODE_VELOCITY_CONTROL            = 2
 CONTROL_MODE_POSITION_CONTROL            = 3
 
+# ODrive.Controller.TorqueFilterType
+TORQUE_FILTER_TYPE_NONE                  = 0
+TORQUE_FILTER_TYPE_LOW_PASS              = 1
+TORQUE_FILTER_TYPE_NOTCH                 = 2
+TORQUE_FILTER_TYPE_LEAD_LAG              = 3
+
+# ODrive.Controller.InputShaperType
+INPUT_SHAPER_TYPE_NONE                   = 0
+INPUT_SHAPER_TYPE_ZV                     = 1
+INPUT_SHAPER_TYPE_ZVD                    = 2
+INPUT_SHAPER_TYPE_EI                     = 3
+
 # ODrive.Controller.InputMode
 INPUT_MODE_INACTIVE                      = 0
 INPUT_MODE_PASSTHROUGH                   = 1
@@ -65,6 +79,13 @@ INPUT_MODE_MIX_CHANNELS                  = 4
 INPUT_MODE_TRAP_TRAJ                     = 5
 INPUT_MODE_TORQUE_RAMP                   = 6
 INPUT_MODE_MIRROR                        = 7
+INPUT_MODE_SCURVE_TRAJ                   = 8
+INPUT_MODE_PVT                           = 9
+INPUT_MODE_COORDINATED_TRAJ              = 10
+
+# ODrive.Motor.PwmMode
+PWM_MODE_CONTINUOUS                      = 0
+PWM_MODE_DISCONTINUOUS                   = 1
 
 # ODrive.Motor.MotorType
 MOTOR_TYPE_HIGH_CURRENT                  = 0
@@ -94,6 +115,8 @@ AXIS_ERROR_MAX_ENDSTOP_PRESSED           = 0x00002000
 AXIS_ERROR_ESTOP_REQUESTED               = 0x00004000
 AXIS_ERROR_HOMING_WITHOUT_ENDSTOP        = 0x00020000
 AXIS_ERROR_OVER_TEMP                     = 0x00040000
+AXIS_ERROR_INERTIA_ID_FAILED             = 0x00080000
+AXIS_ERROR_AUTOTUNE_FAILED               = 0x00100000
 
 # ODrive.Axis.LockinState
 LOCKIN_STATE_INACTIVE                    = 0
@@ -119,6 +142,7 @@ MOTOR_ERROR_BRAKE_DUTY_CYCLE_NAN         = 0x00002000
 MOTOR_ERROR_DC_BUS_OVER_REGEN_CURRENT    = 0x00004000
 MOTOR_ERROR_DC_BUS_OVER_CURRENT          = 0x00008000
 MOTOR_ERROR_MODULATION_IS_NAN            = 0x00010000
+MOTOR_ERROR_FLUX_LINKAGE_OUT_OF_RANGE    = 0x00020000
 
 # ODrive.Motor.ArmedState
 ARMED_STATE_DISARMED                     = 0
@@ -134,6 +158,7 @@ CONTROLLER_ERROR_UNSTABLE_GAIN           = 0x00000004
 CONTROLLER_ERROR_INVALID_MIRROR_AXIS     = 0x00000008
 CONTROLLER_ERROR_INVALID_LOAD_ENCODER    = 0x00000010
 CONTROLLER_ERROR_INVALID_ESTIMATE        = 0x00000020
+CONTROLLER_ERROR_PVT_QUEUE_UNDERRUN      = 0x00000040
 
 # ODrive.Encoder.Error
 ENCODER_ERROR_NONE                       = 0x00000000
@@ -150,3 +175,5 @@ ENCODER_ERROR_ABS_SPI_NOT_READY          = 0x00000100
 # ODrive.SensorlessEstimator.Error
 SENSORLESS_ESTIMATOR_ERROR_NONE          = 0x00000000
 SENSORLESS_ESTIMATOR_ERROR_UNSTABLE_GAIN = 0x00000001
+SENSORLESS_ESTIMATOR_ERROR_LOW_SALIENCY  = 0x00000002
+SENSORLESS_ESTIMATOR_ERROR_UNKNOWN_POLARITY = 0x00000004
@@ -276,6 +276,29 @@ def step_and_plot(  axis,
     capture.plot()
 
 
+def plot_autotune_response(axis):
+    """
+    Plots the frequency response that was measured by the last
+    AXIS_STATE_AUTOTUNING of the specified axis.
+    """
+    tuner = axis.autotuner
+    freq = [tuner.get_response_freq(i) for i in range(tuner.num_points)]
+    gain = [tuner.get_response_gain(i) for i in range(tuner.num_points)]
+    phase = [tuner.get_response_phase(i) for i in range(tuner.num_points)]
+
+    import matplotlib.pyplot as plt
+    fig, (ax_gain, ax_phase) = plt.subplots(2, 1, sharex=True)
+    ax_gain.loglog(freq, gain)
+    ax_gain.set_ylabel("Gain [(turn/s)/Nm]")
+    ax_phase.semilogx(freq, phase)
+    ax_phase.set_ylabel("Phase [deg]")
+    ax_phase.set_xlabel("Frequency [Hz]")
+    if tuner.crossover_freq > 0:
+        for ax in (ax_gain, ax_phase):
+            ax.axvline(tuner.crossover_freq, color='gray', linestyle='--')
+    ax_gain.set_title("crossover {:.1f} Hz, phase margin {:.1f} deg".format(tuner.crossover_freq, tuner.phase_margin))
+    plt.show()
+
 def print_drv_regs(name, motor):
     """
     Dumps the current gate driver regisers for the specified motor